@@ -22,10 +22,18 @@ CONF_MIN_CHANNELS = "min_channels"
 CONF_MAX_CHANNELS = "max_channels"
 CONF_MIN_SAMPLE_RATE = "min_sample_rate"
 CONF_MAX_SAMPLE_RATE = "max_sample_rate"
+CONF_FILE_CACHE_SIZE = "file_cache_size"
 
 
 CONFIG_SCHEMA = cv.All(
-    cv.Schema({}),
+    cv.Schema(
+        {
+            # Bytes of external RAM used to cache recently played http files, 0 disables the cache
+            cv.Optional(CONF_FILE_CACHE_SIZE, default=0): cv.int_range(
+                min=0, max=4000000
+            ),
+        }
+    ),
 )
 
 AUDIO_COMPONENT_SCHEMA = cv.Schema(
@@ -166,3 +174,7 @@ def final_validate_audio_schema(
 
 async def to_code(config):
     cg.add_library("esphome/esp-audio-libs", "1.1.4")
+
+    if file_cache_size := config.get(CONF_FILE_CACHE_SIZE):
+        cg.add_define("USE_AUDIO_FILE_CACHE")
+        cg.add_define("AUDIO_FILE_CACHE_SIZE", file_cache_size)
@@ -54,14 +54,110 @@ const char *audio_file_type_to_string(AudioFileType file_type) {
   }
 }
 
+#if defined(USE_ESP32_VARIANT_ESP32S3)
+// Scales 8 samples per iteration with the ESP32-S3's 128-bit PIE instructions. EE.VMUL.S16 multiplies each lane and
+// arithmetically shifts the 32-bit product right by SAR, which matches the portable implementation bit for bit. Both
+// buffers must be 16 byte aligned and blocks must be at least 1. Loads each block before storing it, so it can scale
+// in place.
+//
+// GCC has no register name for SAR, so it can't be listed as a clobber. The caller's SAR is saved in a9 and restored
+// before returning instead.
+//
+// q0-q2 aren't listed either, GCC never allocates the PIE registers. They are part of the task's coprocessor context:
+// on IDF 5.x the Xtensa FreeRTOS port disables the coprocessors on every context switch, and the first PIE instruction
+// of a task then traps and saves the previous owner's q registers to that task's save area before restoring this
+// task's. The port pins the task to its core on that first use, so the context can't be left behind on the other core.
+// Interrupt handlers don't get this lazy save, so this must never be called from an ISR.
+static void scale_audio_samples_pie(const int16_t *audio_samples, int16_t *output_buffer, int16_t scale_factor,
+                                    size_t blocks) {
+  asm volatile(
+      "rsr.sar a9 \n"
+      "movi.n a8, 15 \n"
+      "wsr.sar a8 \n"
+      "ee.vldbc.16 q1, %[factor] \n"
+      "1: \n"
+      "ee.vld.128.ip q0, %[input], 16 \n"
+      "ee.vmul.s16 q2, q0, q1 \n"
+      "addi.n %[blocks], %[blocks], -1 \n"
+      "ee.vst.128.ip q2, %[output], 16 \n"
+      "bnez %[blocks], 1b \n"
+      "wsr.sar a9 \n"
+      : [input] "+r"(audio_samples), [output] "+r"(output_buffer), [blocks] "+r"(blocks)
+      : [factor] "r"(&scale_factor)
+      : "a8", "a9", "memory");
+}
+#endif
+
+/// Based on `dsps_mulc_s16_ansi` from the esp-dsp library:
+/// https://github.com/espressif/esp-dsp/blob/master/modules/math/mulc/fixed/dsps_mulc_s16_ansi.c
+/// (accessed on 2024-09-30).
 void scale_audio_samples(const int16_t *audio_samples, int16_t *output_buffer, int16_t scale_factor,
                          size_t samples_to_scale) {
+  size_t i = 0;
+
+#if defined(USE_ESP32_VARIANT_ESP32S3)
+  // The vector loads/stores require both buffers to share the same 16 byte alignment. Scale the leading samples until
+  // the buffers are aligned, then scale 8 samples at a time.
+  if ((((uintptr_t) audio_samples ^ (uintptr_t) output_buffer) & 15) == 0) {
+    for (; (i < samples_to_scale) && ((uintptr_t) (audio_samples + i) & 15); ++i) {
+      output_buffer[i] = (int16_t) (((int32_t) audio_samples[i] * (int32_t) scale_factor) >> 15);
+    }
+    const size_t blocks = (samples_to_scale - i) / 8;
+    if (blocks > 0) {
+      scale_audio_samples_pie(audio_samples + i, output_buffer + i, scale_factor, blocks);
+      i += blocks * 8;
+    }
+  }
+#endif
+
   // Note the assembly dsps_mulc function has audio glitches if the input and output buffers are the same.
-  for (int i = 0; i < samples_to_scale; i++) {
+  for (; i < samples_to_scale; ++i) {
     int32_t acc = (int32_t) audio_samples[i] * (int32_t) scale_factor;
     output_buffer[i] = (int16_t) (acc >> 15);
   }
 }
 
+void scale_audio_samples(const int32_t *audio_samples, int32_t *output_buffer, int16_t scale_factor,
+                         size_t samples_to_scale) {
+  for (size_t i = 0; i < samples_to_scale; ++i) {
+    int64_t acc = (int64_t) audio_samples[i] * (int64_t) scale_factor;
+    output_buffer[i] = (int32_t) (acc >> 15);
+  }
+}
+
+void scale_packed_24_bit_audio_samples(const uint8_t *audio_samples, uint8_t *output_buffer, int16_t scale_factor,
+                                       size_t samples_to_scale) {
+  for (size_t i = 0; i < samples_to_scale; ++i) {
+    // Place the sample in the upper 24 bits so the sign is preserved, then scale it like a 32 bit sample
+    const uint8_t *in = audio_samples + 3 * i;
+    int32_t sample = (int32_t) (((uint32_t) in[0] << 8) | ((uint32_t) in[1] << 16) | ((uint32_t) in[2] << 24));
+    sample = (int32_t) (((int64_t) sample * (int64_t) scale_factor) >> 15);
+
+    uint8_t *out = output_buffer + 3 * i;
+    out[0] = (uint8_t) (sample >> 8);
+    out[1] = (uint8_t) (sample >> 16);
+    out[2] = (uint8_t) (sample >> 24);
+  }
+}
+
+bool scale_audio_data(const uint8_t *audio_data, uint8_t *output_buffer, int16_t scale_factor, size_t bytes_to_scale,
+                      size_t bytes_per_sample) {
+  switch (bytes_per_sample) {
+    case 2:
+      scale_audio_samples(reinterpret_cast<const int16_t *>(audio_data), reinterpret_cast<int16_t *>(output_buffer),
+                          scale_factor, bytes_to_scale / 2);
+      return true;
+    case 3:
+      scale_packed_24_bit_audio_samples(audio_data, output_buffer, scale_factor, bytes_to_scale / 3);
+      return true;
+    case 4:
+      scale_audio_samples(reinterpret_cast<const int32_t *>(audio_data), reinterpret_cast<int32_t *>(output_buffer),
+                          scale_factor, bytes_to_scale / 4);
+      return true;
+    default:
+      return false;
+  }
+}
+
 }  // namespace audio
 }  // namespace esphome
@@ -122,12 +122,45 @@ struct AudioFile {
   AudioFileType file_type;
 };
 
+struct AudioProcessingStats {
+  /* Counters collected by the audio processing classes while they run. They make it possible to compare the cost of
+   * changes to the decode/resample pipeline with repeatable numbers instead of measuring on the bus.
+   *
+   *  - processing_us only includes time spent in the decoder/resampler itself, not time blocked on a source or sink.
+   *  - bytes_copied includes every copy done while staging data: ring buffer reads/writes, shifts, and pass-throughs.
+   *  - peak_system_heap_drop_bytes is the largest drop in the system's free heap seen since the processing class was
+   *    constructed. The codecs allocate internally, so their own allocations can't be tracked; allocations by any
+   *    other task are included as well. Benchmark with nothing else streaming to keep it meaningful.
+   */
+  uint32_t frames_processed{0};
+  uint64_t bytes_copied{0};
+  uint64_t processing_us{0};
+  size_t peak_system_heap_drop_bytes{0};
+
+  /// @brief Processing throughput, ignoring time spent waiting on the source or sink
+  uint32_t frames_per_second() const {
+    if (this->processing_us == 0) {
+      return 0;
+    }
+    return (uint64_t) this->frames_processed * 1000000 / this->processing_us;
+  }
+
+  /// @brief Average number of bytes copied for every frame sent to the sink
+  float bytes_copied_per_frame() const {
+    if (this->frames_processed == 0) {
+      return 0.0f;
+    }
+    return (float) this->bytes_copied / this->frames_processed;
+  }
+};
+
 /// @brief Helper function to convert file type to a const char string
 /// @param file_type
 /// @return const char pointer to the readable file type
 const char *audio_file_type_to_string(AudioFileType file_type);
 
-/// @brief Scales Q15 fixed point audio samples. Scales in place if audio_samples == output_buffer.
+/// @brief Scales Q15 fixed point audio samples. Scales in place if audio_samples == output_buffer. Uses the PIE SIMD
+/// instructions on the ESP32-S3 when both buffers share the same 16 byte alignment.
 /// @param audio_samples PCM int16 audio samples
 /// @param output_buffer Buffer to store the scaled samples
 /// @param scale_factor Q15 fixed point scaling factor
@@ -135,6 +168,33 @@ const char *audio_file_type_to_string(AudioFileType file_type);
 void scale_audio_samples(const int16_t *audio_samples, int16_t *output_buffer, int16_t scale_factor,
                          size_t samples_to_scale);
 
+/// @brief Scales Q31 fixed point audio samples by a Q15 factor. Scales in place if audio_samples == output_buffer.
+/// @param audio_samples PCM int32 audio samples
+/// @param output_buffer Buffer to store the scaled samples
+/// @param scale_factor Q15 fixed point scaling factor
+/// @param samples_to_scale Number of samples to scale
+void scale_audio_samples(const int32_t *audio_samples, int32_t *output_buffer, int16_t scale_factor,
+                         size_t samples_to_scale);
+
+/// @brief Scales packed little endian 24 bit audio samples by a Q15 factor. Scales in place if
+/// audio_samples == output_buffer.
+/// @param audio_samples PCM 24 bit audio samples, 3 bytes each
+/// @param output_buffer Buffer to store the scaled samples
+/// @param scale_factor Q15 fixed point scaling factor
+/// @param samples_to_scale Number of samples to scale
+void scale_packed_24_bit_audio_samples(const uint8_t *audio_samples, uint8_t *output_buffer, int16_t scale_factor,
+                                       size_t samples_to_scale);
+
+/// @brief Scales 16, 24, or 32 bit audio data by a Q15 factor. Scales in place if audio_data == output_buffer.
+/// @param audio_data PCM audio data
+/// @param output_buffer Buffer to store the scaled data
+/// @param scale_factor Q15 fixed point scaling factor
+/// @param bytes_to_scale Number of bytes to scale
+/// @param bytes_per_sample The audio data's bytes per sample
+/// @return True if scaled, false if the sample size isn't supported
+bool scale_audio_data(const uint8_t *audio_data, uint8_t *output_buffer, int16_t scale_factor, size_t bytes_to_scale,
+                      size_t bytes_per_sample);
+
 /// @brief Unpacks a quantized audio sample into a Q31 fixed-point number.
 /// @param data Pointer to uint8_t array containing the audio sample
 /// @param bytes_per_sample The number of bytes per sample
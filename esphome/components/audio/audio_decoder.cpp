@@ -3,21 +3,39 @@
 #ifdef USE_ESP32
 
 #include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+#include <esp_heap_caps.h>
+
+#include <algorithm>
 
 namespace esphome {
 namespace audio {
 
+static const char *const TAG = "audio_decoder";
+
 static const uint32_t DECODING_TIMEOUT_MS = 50;    // The decode function will yield after this duration
 static const uint32_t READ_WRITE_TIMEOUT_MS = 20;  // Timeout for transferring audio data
 
 static const uint32_t MAX_POTENTIALLY_FAILED_COUNT = 10;
 
 AudioDecoder::AudioDecoder(size_t input_buffer_size, size_t output_buffer_size) {
+  this->free_heap_at_construction_ = heap_caps_get_free_size(MALLOC_CAP_8BIT);
   this->input_transfer_buffer_ = AudioSourceTransferBuffer::create(input_buffer_size);
   this->output_transfer_buffer_ = AudioSinkTransferBuffer::create(output_buffer_size);
 }
 
 AudioDecoder::~AudioDecoder() {
+  const AudioProcessingStats stats = this->get_stats();
+  if ((stats.frames_processed > 0) && this->audio_stream_info_.has_value()) {
+    ESP_LOGD(TAG,
+             "%s @ %" PRIu32 " Hz: %" PRIu32 " frames, %" PRIu32
+             " frames/s, %.2f bytes copied per frame, peak system heap drop %zu bytes",
+             audio_file_type_to_string(this->audio_file_type_), this->audio_stream_info_.value().get_sample_rate(),
+             stats.frames_processed, stats.frames_per_second(), stats.bytes_copied_per_frame(),
+             stats.peak_system_heap_drop_bytes);
+  }
+
 #ifdef USE_AUDIO_MP3_SUPPORT
   if (this->audio_file_type_ == AudioFileType::MP3) {
     esp_audio_libs::helix_decoder::MP3FreeDecoder(this->mp3_decoder_);
@@ -59,6 +77,7 @@ esp_err_t AudioDecoder::start(AudioFileType audio_file_type) {
   this->audio_file_type_ = audio_file_type;
 
   this->potentially_failed_count_ = 0;
+  this->decode_came_back_short_ = false;
   this->end_of_file_ = false;
 
   switch (this->audio_file_type_) {
@@ -140,6 +159,7 @@ AudioDecoderState AudioDecoder::decode(bool stop_gracefully) {
           this->output_transfer_buffer_->transfer_data_to_sink(pdMS_TO_TICKS(READ_WRITE_TIMEOUT_MS), false);
 
       if (this->audio_stream_info_.has_value()) {
+        this->stats_.frames_processed += this->audio_stream_info_.value().bytes_to_frames(bytes_written);
         this->accumulated_frames_written_ += this->audio_stream_info_.value().bytes_to_frames(bytes_written);
         this->playback_ms_ +=
             this->audio_stream_info_.value().frames_to_milliseconds_with_remainder(&this->accumulated_frames_written_);
@@ -157,15 +177,21 @@ AudioDecoderState AudioDecoder::decode(bool stop_gracefully) {
 
     // Decode more audio
 
-    // Only shift data on the first loop iteration to avoid unnecessary, slow moves
+    // Only shift data on the first loop iteration to avoid unnecessary, slow moves. If the last decode came back short,
+    // always shift, so a frame larger than the free space after the data fits in the buffer.
+    const bool force_shift = first_loop_iteration && this->decode_came_back_short_;
     size_t bytes_read = this->input_transfer_buffer_->transfer_data_from_source(pdMS_TO_TICKS(READ_WRITE_TIMEOUT_MS),
-                                                                                first_loop_iteration);
+                                                                                first_loop_iteration, force_shift);
+    if (first_loop_iteration) {
+      this->decode_came_back_short_ = false;
+    }
 
     if (!first_loop_iteration && (this->input_transfer_buffer_->available() < bytes_processed)) {
       // Less data is available than what was processed in last iteration, so don't attempt to decode.
-      // This attempts to avoid the decoder from consistently trying to decode an incomplete frame. The transfer buffer
-      // will shift the remaining data to the start and copy more from the source the next time the decode function is
-      // called
+      // This attempts to avoid the decoder from consistently trying to decode an incomplete frame. The next time the
+      // decode function is called, the transfer buffer shifts the remaining data to the start and copies more from
+      // the source.
+      this->decode_came_back_short_ = true;
       break;
     }
 
@@ -185,6 +211,7 @@ AudioDecoderState AudioDecoder::decode(bool stop_gracefully) {
       // No data to decode, attempt to get more data next time
       state = FileDecoderState::IDLE;
     } else {
+      const uint32_t processing_start_us = micros();
       switch (this->audio_file_type_) {
 #ifdef USE_AUDIO_FLAC_SUPPORT
         case AudioFileType::FLAC:
@@ -204,6 +231,8 @@ AudioDecoderState AudioDecoder::decode(bool stop_gracefully) {
           state = FileDecoderState::IDLE;
           break;
       }
+      this->stats_.processing_us += micros() - processing_start_us;
+      this->update_peak_system_heap_drop_();
     }
 
     first_loop_iteration = false;
@@ -211,6 +240,7 @@ AudioDecoderState AudioDecoder::decode(bool stop_gracefully) {
 
     if (state == FileDecoderState::POTENTIALLY_FAILED) {
       ++this->potentially_failed_count_;
+      this->decode_came_back_short_ = true;
     } else if (state == FileDecoderState::END_OF_FILE) {
       this->end_of_file_ = true;
     } else if (state == FileDecoderState::FAILED) {
@@ -222,6 +252,25 @@ AudioDecoderState AudioDecoder::decode(bool stop_gracefully) {
   return AudioDecoderState::DECODING;
 }
 
+AudioProcessingStats AudioDecoder::get_stats() const {
+  AudioProcessingStats stats = this->stats_;
+  if (this->input_transfer_buffer_ != nullptr) {
+    stats.bytes_copied += this->input_transfer_buffer_->get_bytes_copied();
+  }
+  if (this->output_transfer_buffer_ != nullptr) {
+    stats.bytes_copied += this->output_transfer_buffer_->get_bytes_copied();
+  }
+  return stats;
+}
+
+void AudioDecoder::update_peak_system_heap_drop_() {
+  const size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  if (free_heap < this->free_heap_at_construction_) {
+    this->stats_.peak_system_heap_drop_bytes =
+        std::max(this->stats_.peak_system_heap_drop_bytes, this->free_heap_at_construction_ - free_heap);
+  }
+}
+
 #ifdef USE_AUDIO_FLAC_SUPPORT
 FileDecoderState AudioDecoder::decode_flac_() {
   if (!this->audio_stream_info_.has_value()) {
@@ -374,6 +423,7 @@ FileDecoderState AudioDecoder::decode_wav_() {
       if (bytes_to_copy > 0) {
         std::memcpy(this->output_transfer_buffer_->get_buffer_end(), this->input_transfer_buffer_->get_buffer_start(),
                     bytes_to_copy);
+        this->stats_.bytes_copied += bytes_to_copy;
         this->input_transfer_buffer_->decrease_buffer_length(bytes_to_copy);
         this->output_transfer_buffer_->increase_buffer_length(bytes_to_copy);
         if (this->wav_has_known_end_) {
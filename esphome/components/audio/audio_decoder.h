@@ -99,7 +99,14 @@ class AudioDecoder {
   /// @param pause_state If true, audio data is not sent to the sink.
   void set_pause_output_state(bool pause_state) { this->pause_output_ = pause_state; }
 
+  /// @brief Returns the benchmark counters collected since the decoder was constructed
+  /// @return AudioProcessingStats with the decoded frames, bytes copied, decoding time, and peak system heap drop
+  AudioProcessingStats get_stats() const;
+
  protected:
+  /// @brief Updates the peak system heap drop with the current free heap size
+  void update_peak_system_heap_drop_();
+
   std::unique_ptr<esp_audio_libs::wav_decoder::WAVDecoder> wav_decoder_;
 #ifdef USE_AUDIO_FLAC_SUPPORT
   FileDecoderState decode_flac_();
@@ -121,6 +128,7 @@ class AudioDecoder {
   size_t wav_bytes_left_{0};
 
   uint32_t potentially_failed_count_{0};
+  bool decode_came_back_short_{false};  // The last decode stopped on an incomplete frame
   bool end_of_file_{false};
   bool wav_has_known_end_{false};
 
@@ -128,6 +136,9 @@ class AudioDecoder {
 
   uint32_t accumulated_frames_written_{0};
   uint32_t playback_ms_{0};
+
+  AudioProcessingStats stats_;
+  size_t free_heap_at_construction_{0};
 };
 }  // namespace audio
 }  // namespace esphome
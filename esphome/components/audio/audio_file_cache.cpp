@@ -0,0 +1,119 @@
+#include "audio_file_cache.h"
+
+#ifdef USE_AUDIO_FILE_CACHE
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+#include <algorithm>
+
+namespace esphome {
+namespace audio {
+
+static const char *const TAG = "audio_file_cache";
+
+// How long files without a max-age or an ETag are served from the cache
+static const uint32_t AUDIO_FILE_CACHE_HEURISTIC_FRESHNESS_MS = 60 * 60 * 1000;
+
+CachedAudioFile::~CachedAudioFile() {
+  if (this->file.data != nullptr) {
+    RAMAllocator<uint8_t> allocator(ExternalRAMAllocator<uint8_t>::ALLOW_FAILURE);
+    allocator.deallocate((uint8_t *) this->file.data, this->file.length);
+  }
+}
+
+AudioFileCache &AudioFileCache::get_instance() {
+  static AudioFileCache cache;
+  return cache;
+}
+
+uint8_t *AudioFileCache::allocate_file(size_t length) {
+  if ((length == 0) || (length > this->get_max_file_size())) {
+    return nullptr;
+  }
+
+  RAMAllocator<uint8_t> allocator(ExternalRAMAllocator<uint8_t>::ALLOW_FAILURE);
+  return allocator.allocate(length);
+}
+
+void AudioFileCache::deallocate_file(uint8_t *data, size_t length) {
+  if (data != nullptr) {
+    RAMAllocator<uint8_t> allocator(ExternalRAMAllocator<uint8_t>::ALLOW_FAILURE);
+    allocator.deallocate(data, length);
+  }
+}
+
+std::shared_ptr<CachedAudioFile> AudioFileCache::lookup(const std::string &url) {
+  LockGuard lock(this->lock_);
+  for (auto it = this->files_.begin(); it != this->files_.end(); ++it) {
+    if ((*it)->url == url) {
+      std::shared_ptr<CachedAudioFile> file = *it;
+      this->files_.splice(this->files_.begin(), this->files_, it);
+      ++this->hits_;
+      return file;
+    }
+  }
+  ++this->misses_;
+  return nullptr;
+}
+
+void AudioFileCache::insert(std::shared_ptr<CachedAudioFile> file) {
+  LockGuard lock(this->lock_);
+  for (auto it = this->files_.begin(); it != this->files_.end(); ++it) {
+    if ((*it)->url == file->url) {
+      this->size_ -= (*it)->file.length;
+      this->files_.erase(it);
+      break;
+    }
+  }
+
+  this->evict_to_size_(this->max_size_ - std::min(file->file.length, this->max_size_));
+  this->size_ += file->file.length;
+  this->files_.push_front(std::move(file));
+
+  ESP_LOGD(TAG, "Cached %u bytes, %u files using %u of %u bytes", this->files_.front()->file.length,
+           this->files_.size(), this->size_, this->max_size_);
+}
+
+bool AudioFileCache::is_fresh(const std::shared_ptr<CachedAudioFile> &file) {
+  LockGuard lock(this->lock_);
+  const uint32_t age_ms = millis() - file->stored_ms;
+  if (file->max_age_s >= 0) {
+    // Compared in 64 bits, a max-age of a year in milliseconds doesn't fit in 32 bits
+    return age_ms < (uint64_t) file->max_age_s * 1000;
+  }
+  if (!file->etag.empty()) {
+    return false;
+  }
+  return age_ms < AUDIO_FILE_CACHE_HEURISTIC_FRESHNESS_MS;
+}
+
+void AudioFileCache::refresh(const std::shared_ptr<CachedAudioFile> &file, int32_t max_age_s) {
+  LockGuard lock(this->lock_);
+  file->stored_ms = millis();
+  file->max_age_s = max_age_s;
+}
+
+void AudioFileCache::clear() {
+  LockGuard lock(this->lock_);
+  this->evict_to_size_(0);
+}
+
+void AudioFileCache::set_max_size(size_t max_size) {
+  LockGuard lock(this->lock_);
+  this->max_size_ = max_size;
+  this->evict_to_size_(max_size);
+}
+
+void AudioFileCache::evict_to_size_(size_t max_size) {
+  while (!this->files_.empty() && (this->size_ > max_size)) {
+    // A reader still playing the evicted file keeps its data until it finishes
+    this->size_ -= this->files_.back()->file.length;
+    this->files_.pop_back();
+  }
+}
+
+}  // namespace audio
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_AUDIO_FILE_CACHE
+
+#include "audio.h"
+
+#include "esphome/core/helpers.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+
+namespace esphome {
+namespace audio {
+
+struct CachedAudioFile {
+  /* An http file kept by the AudioFileCache. The data is owned by the entry and deallocated with it, so a reader
+   * playing the file keeps it alive with its shared_ptr even if the cache evicts it meanwhile.
+   *
+   *  - Files with a Cache-Control max-age are served without contacting the server until they expire.
+   *  - Files with an ETag and no max-age are revalidated with a conditional request before every use.
+   *  - Files with neither are served for AUDIO_FILE_CACHE_HEURISTIC_FRESHNESS_MS; TTS and media urls are usually
+   *    unique per content.
+   */
+  ~CachedAudioFile();
+
+  std::string url;
+  std::string etag;
+  // Changed by AudioFileCache::refresh once the file is cached, so only read them with AudioFileCache::is_fresh
+  uint32_t stored_ms{0};
+  int32_t max_age_s{-1};  // -1 if the server didn't send a max-age
+  AudioFile file{nullptr, 0, AudioFileType::NONE};
+};
+
+class AudioFileCache {
+  /*
+   * @brief Bounded least recently used cache of audio files downloaded from http sources, stored in external RAM.
+   * AudioReader records files while it plays them and serves later requests for the same url as an AudioFile, so
+   * repeated chimes and TTS phrases start without waiting on the network.
+   */
+ public:
+  /// @brief Returns the cache shared by all AudioReaders
+  static AudioFileCache &get_instance();
+
+  /// @brief Allocates a buffer for recording a file of the given size. Doesn't evict any files, as the recording may
+  /// still be abandoned; if external RAM is short, the file just isn't recorded.
+  /// @return Pointer to the buffer, or nullptr if the file is too large for the cache or the allocation failed
+  uint8_t *allocate_file(size_t length);
+
+  /// @brief Deallocates a recording buffer that won't be inserted into the cache
+  void deallocate_file(uint8_t *data, size_t length);
+
+  /// @brief Returns the cached file for the url and marks it as the most recently used, or nullptr if there is none
+  std::shared_ptr<CachedAudioFile> lookup(const std::string &url);
+
+  /// @brief Adds a file, replacing any file with the same url, and evicts the least recently used files until the
+  /// cache fits in its maximum size
+  void insert(std::shared_ptr<CachedAudioFile> file);
+
+  /// @brief Returns true if the file can be served without revalidating it with the server
+  bool is_fresh(const std::shared_ptr<CachedAudioFile> &file);
+
+  /// @brief Restarts the freshness lifetime of a file after the server confirmed it is unchanged
+  void refresh(const std::shared_ptr<CachedAudioFile> &file, int32_t max_age_s);
+
+  /// @brief Removes every file
+  void clear();
+
+  size_t get_max_size() const { return this->max_size_; }
+  void set_max_size(size_t max_size);
+
+  /// @brief Files larger than a quarter of the cache aren't recorded, so one long stream can't evict everything
+  size_t get_max_file_size() const { return this->max_size_ / 4; }
+
+  uint32_t get_hits() const { return this->hits_; }
+  uint32_t get_misses() const { return this->misses_; }
+
+ protected:
+  void evict_to_size_(size_t max_size);
+
+  Mutex lock_;
+  std::list<std::shared_ptr<CachedAudioFile>> files_;  // Most recently used first
+  size_t size_{0};
+  size_t max_size_{AUDIO_FILE_CACHE_SIZE};
+  uint32_t hits_{0};
+  uint32_t misses_{0};
+};
+
+}  // namespace audio
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,265 @@
+#include "audio_pipeline_scheduler.h"
+
+#ifdef USE_ESP32
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace audio {
+
+static const char *const TAG = "audio_pipeline";
+
+static const uint32_t STOP_POLL_MS = 10;
+
+AudioPipelineStage::~AudioPipelineStage() { this->stop(); }
+
+esp_err_t AudioPipelineStage::start() {
+  if (this->task_handle_ != nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  this->stop_requested_ = false;
+  this->state_ = AudioPipelineStageState::RUNNING;
+
+  if (this->config_.stack_in_psram) {
+    RAMAllocator<StackType_t> stack_allocator(RAMAllocator<StackType_t>::ALLOC_EXTERNAL);
+    this->task_stack_ = stack_allocator.allocate(this->config_.stack_size);
+    if (this->task_stack_ == nullptr) {
+      this->state_ = AudioPipelineStageState::IDLE;
+      return ESP_ERR_NO_MEM;
+    }
+    this->task_handle_ =
+        xTaskCreateStaticPinnedToCore(AudioPipelineStage::stage_task, this->config_.name, this->config_.stack_size,
+                                      (void *) this, this->config_.priority, this->task_stack_,
+                                      &this->task_stack_buffer_, this->config_.core);
+  } else {
+    xTaskCreatePinnedToCore(AudioPipelineStage::stage_task, this->config_.name, this->config_.stack_size,
+                            (void *) this, this->config_.priority, &this->task_handle_, this->config_.core);
+  }
+
+  if (this->task_handle_ == nullptr) {
+    this->delete_task_();
+    this->state_ = AudioPipelineStageState::IDLE;
+    return ESP_ERR_NO_MEM;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t AudioPipelineStage::stop(TickType_t ticks_to_wait) {
+  if (this->task_handle_ == nullptr) {
+    return ESP_OK;
+  }
+
+  this->stop_requested_ = true;
+
+  // The task suspends itself once it leaves the RUNNING state
+  const TickType_t start_ticks = xTaskGetTickCount();
+  while ((this->state_.load() == AudioPipelineStageState::RUNNING) ||
+         (eTaskGetState(this->task_handle_) != eSuspended)) {
+    if ((ticks_to_wait != portMAX_DELAY) && (xTaskGetTickCount() - start_ticks > ticks_to_wait)) {
+      return ESP_ERR_TIMEOUT;
+    }
+    delay(STOP_POLL_MS);
+  }
+
+  this->delete_task_();
+  return ESP_OK;
+}
+
+void AudioPipelineStage::delete_task_() {
+  if (this->task_handle_ != nullptr) {
+    vTaskDelete(this->task_handle_);
+    this->task_handle_ = nullptr;
+  }
+
+  if (this->task_stack_ != nullptr) {
+    RAMAllocator<StackType_t> stack_allocator(RAMAllocator<StackType_t>::ALLOC_EXTERNAL);
+    stack_allocator.deallocate(this->task_stack_, this->config_.stack_size);
+    this->task_stack_ = nullptr;
+  }
+}
+
+AudioPipelineStageCounters AudioPipelineStage::get_counters() const {
+  LockGuard lock(this->counters_lock_);
+  return this->counters_;
+}
+
+void AudioPipelineStage::stage_task(void *params) {
+  AudioPipelineStage *this_stage = (AudioPipelineStage *) params;
+
+  AudioPipelineStageState state = AudioPipelineStageState::RUNNING;
+  while (state == AudioPipelineStageState::RUNNING) {
+    if (this_stage->stop_requested_.load()) {
+      state = AudioPipelineStageState::STOPPED;
+      break;
+    }
+
+    bool stop_gracefully = false;
+    if (this_stage->upstream_ != nullptr) {
+      const AudioPipelineStageState upstream_state = this_stage->upstream_->get_state();
+      if (upstream_state == AudioPipelineStageState::FAILED) {
+        state = AudioPipelineStageState::STOPPED;
+        break;
+      }
+      stop_gracefully = (upstream_state == AudioPipelineStageState::FINISHED);
+    }
+
+    std::shared_ptr<RingBuffer> source = this_stage->source_.lock();
+    const bool input_starved = (source != nullptr) && (source->available() == 0);
+    source.reset();
+
+    const uint32_t step_start_us = micros();
+    state = this_stage->step_(stop_gracefully);
+    const uint32_t step_duration_us = micros() - step_start_us;
+
+    std::shared_ptr<RingBuffer> sink = this_stage->sink_.lock();
+    const bool output_backpressure = (sink != nullptr) && (sink->free() == 0);
+    sink.reset();
+
+    LockGuard lock(this_stage->counters_lock_);
+    ++this_stage->counters_.steps;
+    this_stage->counters_.active_us += step_duration_us;
+    if (input_starved) {
+      ++this_stage->counters_.input_starved;
+    }
+    if (output_backpressure) {
+      ++this_stage->counters_.output_backpressure;
+    }
+    if (this_stage->stats_ != nullptr) {
+      this_stage->counters_.cpu_us = this_stage->stats_().processing_us;
+    }
+  }
+
+  this_stage->state_ = state;
+
+  // Wait for the owner to delete the task, so it can safely deallocate a static stack
+  vTaskSuspend(nullptr);
+}
+
+AudioPipelineStage *AudioPipelineScheduler::add_stage(const AudioPipelineStageConfig &config,
+                                                      AudioPipelineStage::StepFunction step) {
+  std::unique_ptr<AudioPipelineStage> stage = make_unique<AudioPipelineStage>(config, step);
+  if (!this->stages_.empty()) {
+    stage->set_upstream(this->stages_.back().get());
+  }
+  this->stages_.push_back(std::move(stage));
+  return this->stages_.back().get();
+}
+
+#ifdef USE_ESP_IDF
+AudioPipelineStage *AudioPipelineScheduler::add_reader_stage(const AudioPipelineStageConfig &config,
+                                                             AudioReader *reader,
+                                                             const std::weak_ptr<RingBuffer> &sink) {
+  AudioPipelineStage *stage = this->add_stage(config, [reader](bool stop_gracefully) {
+    switch (reader->read()) {
+      case AudioReaderState::FINISHED:
+        return AudioPipelineStageState::FINISHED;
+      case AudioReaderState::FAILED:
+        return AudioPipelineStageState::FAILED;
+      default:
+        return AudioPipelineStageState::RUNNING;
+    }
+  });
+  stage->set_sink(sink);
+  return stage;
+}
+#endif
+
+AudioPipelineStage *AudioPipelineScheduler::add_decoder_stage(const AudioPipelineStageConfig &config,
+                                                              AudioDecoder *decoder,
+                                                              const std::weak_ptr<RingBuffer> &source,
+                                                              const std::weak_ptr<RingBuffer> &sink) {
+  AudioPipelineStage *stage = this->add_stage(config, [decoder](bool stop_gracefully) {
+    switch (decoder->decode(stop_gracefully)) {
+      case AudioDecoderState::FINISHED:
+        return AudioPipelineStageState::FINISHED;
+      case AudioDecoderState::FAILED:
+        return AudioPipelineStageState::FAILED;
+      default:
+        return AudioPipelineStageState::RUNNING;
+    }
+  });
+  stage->set_source(source);
+  stage->set_sink(sink);
+  stage->set_stats_function([decoder]() { return decoder->get_stats(); });
+  return stage;
+}
+
+AudioPipelineStage *AudioPipelineScheduler::add_resampler_stage(const AudioPipelineStageConfig &config,
+                                                                AudioResampler *resampler,
+                                                                const std::weak_ptr<RingBuffer> &source,
+                                                                const std::weak_ptr<RingBuffer> &sink) {
+  AudioPipelineStage *stage = this->add_stage(config, [resampler](bool stop_gracefully) {
+    int32_t ms_differential = 0;
+    switch (resampler->resample(stop_gracefully, &ms_differential)) {
+      case AudioResamplerState::FINISHED:
+        return AudioPipelineStageState::FINISHED;
+      case AudioResamplerState::FAILED:
+        return AudioPipelineStageState::FAILED;
+      default:
+        return AudioPipelineStageState::RUNNING;
+    }
+  });
+  stage->set_source(source);
+  stage->set_sink(sink);
+  stage->set_stats_function([resampler]() { return resampler->get_stats(); });
+  return stage;
+}
+
+esp_err_t AudioPipelineScheduler::start() {
+  for (auto &stage : this->stages_) {
+    esp_err_t err = stage->start();
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Failed to start the %s stage", stage->get_name());
+      this->stop();
+      return err;
+    }
+  }
+  return ESP_OK;
+}
+
+void AudioPipelineScheduler::stop() {
+  // Stop downstream stages first, so they don't wait on a stage that is already gone
+  for (auto it = this->stages_.rbegin(); it != this->stages_.rend(); ++it) {
+    (*it)->stop();
+  }
+}
+
+void AudioPipelineScheduler::clear() {
+  this->stop();
+  this->stages_.clear();
+}
+
+AudioPipelineStageState AudioPipelineScheduler::get_state() const {
+  if (this->stages_.empty()) {
+    return AudioPipelineStageState::IDLE;
+  }
+  for (const auto &stage : this->stages_) {
+    if (stage->get_state() == AudioPipelineStageState::FAILED) {
+      return AudioPipelineStageState::FAILED;
+    }
+  }
+  const AudioPipelineStageState last_state = this->stages_.back()->get_state();
+  if ((last_state == AudioPipelineStageState::FINISHED) || (last_state == AudioPipelineStageState::STOPPED)) {
+    return last_state;
+  }
+  return AudioPipelineStageState::RUNNING;
+}
+
+void AudioPipelineScheduler::dump_counters() const {
+  for (const auto &stage : this->stages_) {
+    const AudioPipelineStageCounters counters = stage->get_counters();
+    ESP_LOGD(TAG,
+             "%s: %" PRIu32 " steps, active %" PRIu32 " ms, cpu %" PRIu32 " ms, input starved %" PRIu32
+             ", output backpressure %" PRIu32,
+             stage->get_name(), counters.steps, (uint32_t) (counters.active_us / 1000),
+             (uint32_t) (counters.cpu_us / 1000), counters.input_starved, counters.output_backpressure);
+  }
+}
+
+}  // namespace audio
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,193 @@
+#pragma once
+
+#ifdef USE_ESP32
+
+#include "audio.h"
+#include "audio_decoder.h"
+#include "audio_resampler.h"
+
+#ifdef USE_ESP_IDF
+#include "audio_reader.h"
+#endif
+
+#include "esphome/core/defines.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/ring_buffer.h"
+
+#include "esp_err.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace esphome {
+namespace audio {
+
+enum class AudioPipelineStageState : uint8_t {
+  IDLE = 0,  // The stage's task is not running
+  RUNNING,   // The stage is processing audio
+  FINISHED,  // The stage processed all of its audio
+  FAILED,    // The stage encountered an error
+  STOPPED,   // The stage was stopped before it finished
+};
+
+struct AudioPipelineStageConfig {
+  const char *name;
+  BaseType_t core{tskNO_AFFINITY};  // Core the stage's task is pinned to, or tskNO_AFFINITY to let FreeRTOS choose
+  UBaseType_t priority{2};
+  uint32_t stack_size{4096};
+  bool stack_in_psram{false};  // Requires CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+};
+
+struct AudioPipelineStageCounters {
+  /* Counters collected by every pipeline stage.
+   *
+   *  - active_us is the wall time spent in the stage's step function, including time blocked on the source or sink.
+   *  - cpu_us is the time spent processing audio, if the stage's processing class reports it (decoder/resampler).
+   *  - input_starved counts steps that started without any data in the source ring buffer.
+   *  - output_backpressure counts steps that ended with the sink ring buffer full.
+   */
+  uint32_t steps{0};
+  uint64_t active_us{0};
+  uint64_t cpu_us{0};
+  uint32_t input_starved{0};
+  uint32_t output_backpressure{0};
+};
+
+class AudioPipelineStage {
+  /*
+   * @brief Runs a single stage of an audio pipeline (reading, decoding, resampling, ...) in its own FreeRTOS task.
+   * The stage repeatedly calls its step function until it finishes, fails, or is stopped. Stages pass audio to each
+   * other through the ring buffers already shared between the audio processing classes.
+   */
+ public:
+  /// @brief Function called repeatedly by the stage's task.
+  /// @param stop_gracefully True if the upstream stage finished, so no new data will arrive in the source
+  /// @return RUNNING if there is more to process, FINISHED or FAILED to end the stage's task
+  using StepFunction = std::function<AudioPipelineStageState(bool stop_gracefully)>;
+
+  /// @brief Function that returns the processing counters of the stage's processing class
+  using StatsFunction = std::function<AudioProcessingStats()>;
+
+  AudioPipelineStage(const AudioPipelineStageConfig &config, StepFunction step) : config_(config), step_(step) {}
+
+  /// @brief Stops the stage's task, if running, and deallocates its stack
+  ~AudioPipelineStage();
+
+  /// @brief Sets the source ring buffer used to count input starvation. Does not take ownership.
+  void set_source(const std::weak_ptr<RingBuffer> &source) { this->source_ = source; }
+
+  /// @brief Sets the sink ring buffer used to count output backpressure. Does not take ownership.
+  void set_sink(const std::weak_ptr<RingBuffer> &sink) { this->sink_ = sink; }
+
+  /// @brief Sets the function used to collect the CPU time of the stage's processing class.
+  void set_stats_function(StatsFunction stats) { this->stats_ = stats; }
+
+  /// @brief Sets the stage that provides this stage's data. Once it finishes, this stage stops gracefully.
+  void set_upstream(AudioPipelineStage *upstream) { this->upstream_ = upstream; }
+
+  /// @brief Creates and starts the stage's task.
+  /// @return ESP_OK if successful, ESP_ERR_INVALID_STATE if it is already running, ESP_ERR_NO_MEM if the task or its
+  ///         stack couldn't be allocated
+  esp_err_t start();
+
+  /// @brief Stops the stage's task and waits for it to exit.
+  /// @param ticks_to_wait FreeRTOS ticks to wait for the task to exit
+  /// @return ESP_OK if the task exited, ESP_ERR_TIMEOUT otherwise
+  esp_err_t stop(TickType_t ticks_to_wait = portMAX_DELAY);
+
+  AudioPipelineStageState get_state() const { return this->state_.load(); }
+  const char *get_name() const { return this->config_.name; }
+
+  /// @brief Returns a copy of the stage's counters. Safe to call while the stage is running.
+  AudioPipelineStageCounters get_counters() const;
+
+ protected:
+  static void stage_task(void *params);
+
+  /// @brief Deletes the suspended task and deallocates its stack
+  void delete_task_();
+
+  AudioPipelineStageConfig config_;
+  StepFunction step_;
+  StatsFunction stats_;
+
+  std::weak_ptr<RingBuffer> source_;
+  std::weak_ptr<RingBuffer> sink_;
+  AudioPipelineStage *upstream_{nullptr};
+
+  TaskHandle_t task_handle_{nullptr};
+  StaticTask_t task_stack_buffer_;
+  StackType_t *task_stack_{nullptr};
+
+  std::atomic<AudioPipelineStageState> state_{AudioPipelineStageState::IDLE};
+  std::atomic<bool> stop_requested_{false};
+
+  AudioPipelineStageCounters counters_;
+  mutable Mutex counters_lock_;
+};
+
+class AudioPipelineScheduler {
+  /*
+   * @brief Runs the stages of an audio pipeline concurrently, each in its own task with its own core affinity and
+   * priority. Stages are chained in the order they are added; each stage stops gracefully once the previous one
+   * finished. Pinning the reader and decoder to one core and the resampler to the other keeps FLAC/MP3 decoding from
+   * competing with the I2S speaker task for CPU time.
+   *
+   * Nothing calls the scheduler yet; ESPHome's speaker media player still runs its reader, decoder, and resampler in
+   * their own tasks. It is scaffolding for moving those pipelines onto pinned stages.
+   */
+ public:
+  /// @brief Adds a stage with a custom step function.
+  /// @return Pointer to the stage to configure its source, sink, and stats function
+  AudioPipelineStage *add_stage(const AudioPipelineStageConfig &config, AudioPipelineStage::StepFunction step);
+
+#ifdef USE_ESP_IDF
+  /// @brief Adds a stage that runs AudioReader::read. The reader must be started and outlive the scheduler's stages.
+  AudioPipelineStage *add_reader_stage(const AudioPipelineStageConfig &config, AudioReader *reader,
+                                       const std::weak_ptr<RingBuffer> &sink);
+#endif
+
+  /// @brief Adds a stage that runs AudioDecoder::decode. The decoder must be started and outlive the scheduler's
+  /// stages.
+  AudioPipelineStage *add_decoder_stage(const AudioPipelineStageConfig &config, AudioDecoder *decoder,
+                                        const std::weak_ptr<RingBuffer> &source, const std::weak_ptr<RingBuffer> &sink);
+
+  /// @brief Adds a stage that runs AudioResampler::resample. The resampler must be started and outlive the scheduler's
+  /// stages.
+  /// @param sink The resampler's sink ring buffer. Pass an empty weak_ptr if the resampler writes to a speaker, which
+  ///             doesn't expose its buffer, so output backpressure isn't counted.
+  AudioPipelineStage *add_resampler_stage(const AudioPipelineStageConfig &config, AudioResampler *resampler,
+                                          const std::weak_ptr<RingBuffer> &source,
+                                          const std::weak_ptr<RingBuffer> &sink);
+
+  /// @brief Starts every stage's task. If any fails to start, the already started stages are stopped.
+  /// @return ESP_OK if successful, the failing stage's esp_err_t otherwise
+  esp_err_t start();
+
+  /// @brief Stops every stage's task and waits for them to exit.
+  void stop();
+
+  /// @brief Removes all stages. Stops them first, if necessary.
+  void clear();
+
+  /// @brief Returns FINISHED once the last stage finished, FAILED if any stage failed, and RUNNING otherwise
+  AudioPipelineStageState get_state() const;
+
+  /// @brief Logs every stage's counters
+  void dump_counters() const;
+
+  const std::vector<std::unique_ptr<AudioPipelineStage>> &get_stages() const { return this->stages_; }
+
+ protected:
+  std::vector<std::unique_ptr<AudioPipelineStage>> stages_;
+};
+
+}  // namespace audio
+}  // namespace esphome
+
+#endif
@@ -5,14 +5,24 @@
 #include "esphome/core/defines.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
 
 #if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
 #include "esp_crt_bundle.h"
 #endif
 
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
 namespace esphome {
 namespace audio {
 
+static const char *const TAG = "audio_reader";
+
 static const uint32_t READ_WRITE_TIMEOUT_MS = 20;
 
 static const uint32_t CONNECTION_TIMEOUT_MS = 5000;
@@ -24,6 +34,31 @@ static const size_t HTTP_STREAM_BUFFER_SIZE = 2048;
 
 static const uint8_t MAX_REDIRECTION = 5;
 
+// Socket timeout while the read-ahead task downloads, so it notices stop requests quickly
+static const uint32_t HTTP_READ_TIMEOUT_MS = 250;
+
+static const size_t HTTP_READ_CHUNK_SIZE = 4096;
+
+// The read-ahead buffer is allocated in external RAM. Halves the size until the allocation succeeds.
+static const size_t READ_AHEAD_BUFFER_SIZE = 256 * 1024;
+static const size_t MIN_READ_AHEAD_BUFFER_SIZE = 16 * 1024;
+
+static const uint32_t READ_AHEAD_TASK_STACK_SIZE = 5120;  // esp_http_client_read needs stack for TLS decryption
+static const UBaseType_t READ_AHEAD_TASK_PRIORITY = 3;
+static const uint32_t READ_AHEAD_PAUSE_MS = 10;  // Polling interval while the target is buffered
+static const uint32_t STOP_POLL_MS = 5;
+
+// Read-ahead target: bitrate * (BASE + JITTER_FACTOR * jitter + underrun margin), clamped to [MIN, MAX]
+static const uint32_t READ_AHEAD_BASE_MS = 1000;
+static const uint32_t READ_AHEAD_JITTER_FACTOR = 4;
+static const uint32_t READ_AHEAD_MIN_MS = 500;
+static const uint32_t READ_AHEAD_MAX_MS = 10000;
+static const uint32_t UNDERRUN_MARGIN_STEP_MS = 1000;
+static const uint32_t BITRATE_WINDOW_MS = 1000;
+
+// Finished connections stay open this long for the next reader from the same server
+static const uint32_t IDLE_CONNECTION_TIMEOUT_MS = 15000;
+
 // Some common HTTP status codes - borrowed from http_request component accessed 20241224
 enum HttpStatus {
   HTTP_STATUS_OK = 200,
@@ -52,6 +87,116 @@ enum HttpStatus {
   HTTP_STATUS_INTERNAL_ERROR = 500
 };
 
+/* A single finished connection is kept open for reuse. Announcements and TTS responses usually come from the same Home
+ * Assistant instance, so one slot avoids most handshakes without holding several TLS sessions in memory. An esp_timer
+ * marks the connection expired once it has been idle for IDLE_CONNECTION_TIMEOUT_MS. Closing it can block on the
+ * network, so it isn't done on the esp_timer task; the next reader closes an expired connection instead of reusing it.
+ */
+struct IdleConnection {
+  esp_http_client_handle_t client{nullptr};
+  std::string origin;
+  std::atomic<bool> expired{false};  // Set by the timer without taking the lock
+  esp_timer_handle_t expiry_timer{nullptr};
+};
+
+static IdleConnection &idle_connection() {
+  static IdleConnection connection;
+  return connection;
+}
+
+static Mutex &idle_connection_lock() {
+  static Mutex lock;
+  return lock;
+}
+
+static void close_client(esp_http_client_handle_t client) {
+  if (client != nullptr) {
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+  }
+}
+
+/// @brief Returns the lower case scheme, host, and port of a url; e.g., "https://example.com:8123"
+static std::string get_origin(const std::string &url) {
+  size_t host_start = url.find("://");
+  if (host_start == std::string::npos) {
+    return "";
+  }
+  host_start += 3;
+  const size_t host_end = url.find_first_of("/?#", host_start);
+  return str_lower_case(url.substr(0, host_end));
+}
+
+/// @brief Takes the idle connection if it was opened to the same origin and hasn't expired. Closes it otherwise.
+static esp_http_client_handle_t acquire_idle_connection(const std::string &origin) {
+  esp_http_client_handle_t client = nullptr;
+  esp_http_client_handle_t stale_client = nullptr;
+  {
+    LockGuard lock(idle_connection_lock());
+    IdleConnection &idle = idle_connection();
+    if (idle.client != nullptr) {
+      if ((idle.origin == origin) && !idle.expired) {
+        client = idle.client;
+      } else {
+        stale_client = idle.client;
+      }
+      idle.client = nullptr;
+      esp_timer_stop(idle.expiry_timer);
+    }
+  }
+  close_client(stale_client);
+  return client;
+}
+
+static void expire_idle_connection(void *arg) { idle_connection().expired = true; }
+
+/// @brief Keeps a finished connection open for the next reader, replacing any previously kept connection
+static void release_idle_connection(esp_http_client_handle_t client) {
+  char url[500];
+  if (esp_http_client_get_url(client, url, sizeof(url)) != ESP_OK) {
+    close_client(client);
+    return;
+  }
+
+  esp_http_client_handle_t replaced_client = nullptr;
+  {
+    LockGuard lock(idle_connection_lock());
+    IdleConnection &idle = idle_connection();
+    if (idle.expiry_timer == nullptr) {
+      esp_timer_create_args_t timer_args = {};
+      timer_args.callback = expire_idle_connection;
+      timer_args.name = "audio_idle_conn";
+      if (esp_timer_create(&timer_args, &idle.expiry_timer) != ESP_OK) {
+        idle.expiry_timer = nullptr;
+      }
+    }
+
+    if (idle.expiry_timer == nullptr) {
+      // Without the timer, the connection could be held open indefinitely
+      replaced_client = client;
+    } else {
+      replaced_client = idle.client;
+      idle.client = client;
+      idle.origin = get_origin(url);
+      idle.expired = false;
+      esp_timer_stop(idle.expiry_timer);
+      esp_timer_start_once(idle.expiry_timer, (uint64_t) IDLE_CONNECTION_TIMEOUT_MS * 1000);
+    }
+  }
+  close_client(replaced_client);
+}
+
+void AudioReader::close_idle_connection() {
+  esp_http_client_handle_t client = nullptr;
+  {
+    LockGuard lock(idle_connection_lock());
+    IdleConnection &idle = idle_connection();
+    client = idle.client;
+    idle.client = nullptr;
+  }
+  close_client(client);
+}
+
 AudioReader::~AudioReader() { this->cleanup_connection_(); }
 
 esp_err_t AudioReader::add_sink(const std::weak_ptr<RingBuffer> &output_ring_buffer) {
@@ -84,79 +229,80 @@ esp_err_t AudioReader::start(const std::string &uri, AudioFileType &file_type) {
   file_type = AudioFileType::NONE;
 
   this->cleanup_connection_();
+  this->current_audio_file_ = nullptr;
 
   if (uri.empty()) {
     return ESP_ERR_INVALID_ARG;
   }
 
-  esp_http_client_config_t client_config = {};
-
-  client_config.url = uri.c_str();
-  client_config.cert_pem = nullptr;
-  client_config.disable_auto_redirect = false;
-  client_config.max_redirection_count = 10;
-  client_config.event_handler = http_event_handler;
-  client_config.user_data = this;
-  client_config.buffer_size = HTTP_STREAM_BUFFER_SIZE;
-  client_config.keep_alive_enable = true;
-  client_config.timeout_ms = CONNECTION_TIMEOUT_MS;  // Shouldn't trigger watchdog resets if caller runs in a task
-
-#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-  if (uri.find("https:") != std::string::npos) {
-    client_config.crt_bundle_attach = esp_crt_bundle_attach;
+#ifdef USE_AUDIO_FILE_CACHE
+  this->uri_ = uri;
+  this->cached_file_ = AudioFileCache::get_instance().lookup(uri);
+  if ((this->cached_file_ != nullptr) && AudioFileCache::get_instance().is_fresh(this->cached_file_)) {
+    return this->start_cached_file_(file_type);
   }
 #endif
 
-  this->client_ = esp_http_client_init(&client_config);
-
-  if (this->client_ == nullptr) {
-    return ESP_FAIL;
-  }
-
-  esp_err_t err = esp_http_client_open(this->client_, 0);
+  this->client_ = acquire_idle_connection(get_origin(uri));
+  this->connection_reused_ = (this->client_ != nullptr);
 
-  if (err != ESP_OK) {
-    this->cleanup_connection_();
-    return err;
-  }
-
-  int64_t header_length = esp_http_client_fetch_headers(this->client_);
-  if (header_length < 0) {
-    this->cleanup_connection_();
-    return ESP_FAIL;
+  esp_err_t err = ESP_FAIL;
+  if (this->client_ != nullptr) {
+    esp_http_client_set_url(this->client_, uri.c_str());
+    esp_http_client_set_user_data(this->client_, this);
+    err = this->open_connection_();
+    if (err != ESP_OK) {
+      // The server may have closed the idle connection in the meantime, so retry with a new connection
+      ESP_LOGD(TAG, "Reusing the idle connection failed, reconnecting");
+      this->cleanup_connection_();
+      this->connection_reused_ = false;
+    }
   }
 
-  int status_code = esp_http_client_get_status_code(this->client_);
+  if (this->client_ == nullptr) {
+    esp_http_client_config_t client_config = {};
+
+    client_config.url = uri.c_str();
+    client_config.cert_pem = nullptr;
+    client_config.disable_auto_redirect = false;
+    client_config.max_redirection_count = 10;
+    client_config.event_handler = http_event_handler;
+    client_config.user_data = this;
+    client_config.buffer_size = HTTP_STREAM_BUFFER_SIZE;
+    client_config.keep_alive_enable = true;
+    client_config.timeout_ms = CONNECTION_TIMEOUT_MS;  // Shouldn't trigger watchdog resets if caller runs in a task
 
-  if ((status_code < HTTP_STATUS_OK) || (status_code > HTTP_STATUS_PERMANENT_REDIRECT)) {
-    this->cleanup_connection_();
-    return ESP_FAIL;
-  }
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    if (uri.find("https:") != std::string::npos) {
+      client_config.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+#endif
 
-  ssize_t redirect_count = 0;
+    this->client_ = esp_http_client_init(&client_config);
 
-  while ((esp_http_client_set_redirection(this->client_) == ESP_OK) && (redirect_count < MAX_REDIRECTION)) {
-    err = esp_http_client_open(this->client_, 0);
-    if (err != ESP_OK) {
-      this->cleanup_connection_();
+    if (this->client_ == nullptr) {
       return ESP_FAIL;
     }
 
-    header_length = esp_http_client_fetch_headers(this->client_);
-    if (header_length < 0) {
+    err = this->open_connection_();
+    if (err != ESP_OK) {
       this->cleanup_connection_();
-      return ESP_FAIL;
+      return err;
     }
+  }
 
-    status_code = esp_http_client_get_status_code(this->client_);
-
-    if ((status_code < HTTP_STATUS_OK) || (status_code > HTTP_STATUS_PERMANENT_REDIRECT)) {
+#ifdef USE_AUDIO_FILE_CACHE
+  if (this->cached_file_ != nullptr) {
+    if (esp_http_client_get_status_code(this->client_) == HTTP_STATUS_NOT_MODIFIED) {
+      AudioFileCache::get_instance().refresh(this->cached_file_, this->max_age_s_);
+      this->response_read_ = true;
       this->cleanup_connection_();
-      return ESP_FAIL;
+      return this->start_cached_file_(file_type);
     }
-
-    ++redirect_count;
+    // The file changed on the server, the new download replaces it
+    this->cached_file_.reset();
   }
+#endif
 
   if (this->audio_file_type_ == AudioFileType::NONE) {
     // Failed to determine the file type from the header, fallback to using the url
@@ -195,12 +341,285 @@ esp_err_t AudioReader::start(const std::string &uri, AudioFileType &file_type) {
 
   this->output_transfer_buffer_ = AudioSinkTransferBuffer::create(this->buffer_size_);
   if (this->output_transfer_buffer_ == nullptr) {
+    this->cleanup_connection_();
     return ESP_ERR_NO_MEM;
   }
 
+#ifdef USE_AUDIO_FILE_CACHE
+  const int64_t content_length = esp_http_client_get_content_length(this->client_);
+  if (!this->no_store_ && (content_length > 0)) {
+    this->record_buffer_ = AudioFileCache::get_instance().allocate_file(content_length);
+    this->record_capacity_ = content_length;
+    this->record_length_ = 0;
+    this->record_file_type_ = file_type;
+  }
+#endif
+
+  err = this->start_read_ahead_();
+  if (err != ESP_OK) {
+    this->cleanup_connection_();
+    return err;
+  }
+
   return ESP_OK;
 }
 
+esp_err_t AudioReader::open_connection_() {
+  this->audio_file_type_ = AudioFileType::NONE;
+  this->response_read_ = false;
+  esp_http_client_set_timeout_ms(this->client_, CONNECTION_TIMEOUT_MS);
+
+#ifdef USE_AUDIO_FILE_CACHE
+  this->etag_.clear();
+  this->max_age_s_ = -1;
+  this->no_store_ = false;
+
+  // Revalidate a stale cached file; the server answers 304 Not Modified without a body if it is unchanged
+  if ((this->cached_file_ != nullptr) && !this->cached_file_->etag.empty()) {
+    esp_http_client_set_header(this->client_, "If-None-Match", this->cached_file_->etag.c_str());
+  } else {
+    esp_http_client_delete_header(this->client_, "If-None-Match");
+  }
+#endif
+
+  esp_err_t err = esp_http_client_open(this->client_, 0);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  int64_t header_length = esp_http_client_fetch_headers(this->client_);
+  if (header_length < 0) {
+    return ESP_FAIL;
+  }
+
+  int status_code = esp_http_client_get_status_code(this->client_);
+
+  if ((status_code < HTTP_STATUS_OK) || (status_code > HTTP_STATUS_PERMANENT_REDIRECT)) {
+    return ESP_FAIL;
+  }
+
+  ssize_t redirect_count = 0;
+
+  while ((esp_http_client_set_redirection(this->client_) == ESP_OK) && (redirect_count < MAX_REDIRECTION)) {
+#ifdef USE_AUDIO_FILE_CACHE
+    // Only the final response's headers describe the file
+    this->etag_.clear();
+    this->max_age_s_ = -1;
+    this->no_store_ = false;
+#endif
+    err = esp_http_client_open(this->client_, 0);
+    if (err != ESP_OK) {
+      return ESP_FAIL;
+    }
+
+    header_length = esp_http_client_fetch_headers(this->client_);
+    if (header_length < 0) {
+      return ESP_FAIL;
+    }
+
+    status_code = esp_http_client_get_status_code(this->client_);
+
+    if ((status_code < HTTP_STATUS_OK) || (status_code > HTTP_STATUS_PERMANENT_REDIRECT)) {
+      return ESP_FAIL;
+    }
+
+    ++redirect_count;
+  }
+
+  return ESP_OK;
+}
+
+#ifdef USE_AUDIO_FILE_CACHE
+esp_err_t AudioReader::start_cached_file_(AudioFileType &file_type) {
+  ESP_LOGD(TAG, "Playing %s from the cache", this->uri_.c_str());
+  this->current_audio_file_ = &this->cached_file_->file;
+  this->file_current_ = this->current_audio_file_->data;
+  file_type = this->current_audio_file_->file_type;
+  return ESP_OK;
+}
+
+void AudioReader::finish_recording_(bool download_complete) {
+  if (this->record_buffer_ == nullptr) {
+    return;
+  }
+
+  if (download_complete && (this->record_length_ == this->record_capacity_)) {
+    std::shared_ptr<CachedAudioFile> file = std::make_shared<CachedAudioFile>();
+    file->url = this->uri_;
+    file->etag = this->etag_;
+    file->stored_ms = millis();
+    file->max_age_s = this->max_age_s_;
+    file->file.data = this->record_buffer_;
+    file->file.length = this->record_capacity_;
+    file->file.file_type = this->record_file_type_;
+    AudioFileCache::get_instance().insert(std::move(file));
+  } else {
+    AudioFileCache::get_instance().deallocate_file(this->record_buffer_, this->record_capacity_);
+  }
+  this->record_buffer_ = nullptr;
+}
+#endif
+
+esp_err_t AudioReader::start_read_ahead_() {
+  for (size_t capacity = READ_AHEAD_BUFFER_SIZE; capacity >= MIN_READ_AHEAD_BUFFER_SIZE; capacity /= 2) {
+    this->read_ahead_ring_buffer_ = RingBuffer::create(capacity);
+    if (this->read_ahead_ring_buffer_ != nullptr) {
+      this->read_ahead_capacity_ = capacity;
+      break;
+    }
+  }
+  if (this->read_ahead_ring_buffer_ == nullptr) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  RAMAllocator<uint8_t> allocator;
+  this->read_chunk_ = allocator.allocate(HTTP_READ_CHUNK_SIZE);
+  if (this->read_chunk_ == nullptr) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  this->bitrate_ = 0;
+  this->jitter_ms_ = 0;
+  this->underrun_margin_ms_ = 0;
+  this->bitrate_window_start_ms_ = millis();
+  this->bitrate_window_bytes_ = 0;
+  this->underruns_ = 0;
+  this->rebuffering_ = false;
+
+  this->stop_requested_ = false;
+  this->download_failed_ = false;
+  this->read_ahead_running_ = true;
+
+  // Short socket timeouts let the task check for stop requests while the server stalls
+  esp_http_client_set_timeout_ms(this->client_, HTTP_READ_TIMEOUT_MS);
+
+  xTaskCreate(AudioReader::read_ahead_task, "read_ahead", READ_AHEAD_TASK_STACK_SIZE, (void *) this,
+              READ_AHEAD_TASK_PRIORITY, &this->read_ahead_task_handle_);
+  if (this->read_ahead_task_handle_ == nullptr) {
+    this->read_ahead_running_ = false;
+    return ESP_ERR_NO_MEM;
+  }
+
+  return ESP_OK;
+}
+
+void AudioReader::stop_read_ahead_() {
+  if (this->read_ahead_task_handle_ == nullptr) {
+    return;
+  }
+
+  // The task deletes itself after clearing read_ahead_running_
+  this->stop_requested_ = true;
+  while (this->read_ahead_running_.load()) {
+    delay(STOP_POLL_MS);
+  }
+  this->read_ahead_task_handle_ = nullptr;
+}
+
+size_t AudioReader::get_read_ahead_target() const {
+  const uint32_t bitrate = this->bitrate_.load();
+  if (bitrate == 0) {
+    // Read ahead as much as possible until the bitrate is known
+    return this->read_ahead_capacity_;
+  }
+
+  uint32_t target_ms = READ_AHEAD_BASE_MS + READ_AHEAD_JITTER_FACTOR * this->jitter_ms_.load() +
+                       this->underrun_margin_ms_.load();
+  target_ms = std::min(std::max(target_ms, READ_AHEAD_MIN_MS), READ_AHEAD_MAX_MS);
+
+  const size_t target_bytes = (uint64_t) bitrate * target_ms / 1000;
+  return std::min(std::max(target_bytes, HTTP_READ_CHUNK_SIZE), this->read_ahead_capacity_);
+}
+
+void AudioReader::read_ahead_task(void *params) {
+  AudioReader *this_reader = (AudioReader *) params;
+  RingBuffer *ring_buffer = this_reader->read_ahead_ring_buffer_.get();
+
+  uint32_t last_data_ms = millis();
+  uint32_t last_arrival_ms = 0;  // 0 if the previous read didn't directly follow another read
+  uint32_t last_gap_ms = 0;
+  float jitter_ms = 0.0f;
+
+  while (!this_reader->stop_requested_.load()) {
+    if (esp_http_client_is_complete_data_received(this_reader->client_)) {
+      break;
+    }
+
+    if ((ring_buffer->available() >= this_reader->get_read_ahead_target()) || (ring_buffer->free() == 0)) {
+      // Pauses don't count towards the jitter, as they aren't caused by the network
+      last_arrival_ms = 0;
+      last_data_ms = millis();
+      delay(READ_AHEAD_PAUSE_MS);
+      continue;
+    }
+
+    const size_t bytes_to_read = std::min(HTTP_READ_CHUNK_SIZE, ring_buffer->free());
+    int received_len = esp_http_client_read(this_reader->client_, (char *) this_reader->read_chunk_, bytes_to_read);
+#ifdef ESP_ERR_HTTP_EAGAIN
+    if (received_len == -ESP_ERR_HTTP_EAGAIN) {
+      received_len = 0;  // Socket timeout
+    }
+#endif
+
+    if (received_len > 0) {
+      const uint32_t now = millis();
+      if (last_arrival_ms != 0) {
+        // Smoothed variation between consecutive arrival gaps, as in RFC 3550
+        const uint32_t gap_ms = now - last_arrival_ms;
+        const float variation = std::abs((float) gap_ms - (float) last_gap_ms);
+        jitter_ms += (variation - jitter_ms) / 16.0f;
+        this_reader->jitter_ms_ = (uint32_t) jitter_ms;
+        last_gap_ms = gap_ms;
+      }
+      last_arrival_ms = now;
+      last_data_ms = now;
+
+#ifdef USE_AUDIO_FILE_CACHE
+      if (this_reader->record_buffer_ != nullptr) {
+        // Counts every byte, so a response longer than its Content-Length isn't cached
+        if (this_reader->record_length_ + received_len <= this_reader->record_capacity_) {
+          std::memcpy(this_reader->record_buffer_ + this_reader->record_length_, this_reader->read_chunk_,
+                      received_len);
+        }
+        this_reader->record_length_ += received_len;
+      }
+#endif
+
+      size_t bytes_written = 0;
+      while ((bytes_written < (size_t) received_len) && !this_reader->stop_requested_.load()) {
+        bytes_written += ring_buffer->write_without_replacement(this_reader->read_chunk_ + bytes_written,
+                                                                received_len - bytes_written,
+                                                                pdMS_TO_TICKS(READ_WRITE_TIMEOUT_MS));
+      }
+    } else if (received_len < 0) {
+      this_reader->download_failed_ = true;
+      break;
+    } else if (!esp_http_client_is_complete_data_received(this_reader->client_) &&
+               ((millis() - last_data_ms) > CONNECTION_TIMEOUT_MS)) {
+      this_reader->download_failed_ = true;
+      break;
+    }
+  }
+
+  this_reader->read_ahead_running_ = false;
+  vTaskDelete(nullptr);
+}
+
+void AudioReader::update_bitrate_(size_t bytes_forwarded) {
+  this->bitrate_window_bytes_ += bytes_forwarded;
+
+  const uint32_t now = millis();
+  const uint32_t elapsed_ms = now - this->bitrate_window_start_ms_;
+  if (elapsed_ms >= BITRATE_WINDOW_MS) {
+    const uint32_t window_bitrate = (uint64_t) this->bitrate_window_bytes_ * 1000 / elapsed_ms;
+    const uint32_t bitrate = this->bitrate_.load();
+    this->bitrate_ = (bitrate == 0) ? window_bitrate : (3 * bitrate + window_bitrate) / 4;
+
+    this->bitrate_window_start_ms_ = now;
+    this->bitrate_window_bytes_ = 0;
+  }
+}
+
 AudioReaderState AudioReader::read() {
   if (this->client_ != nullptr) {
     return this->http_read_();
@@ -238,6 +657,20 @@ esp_err_t AudioReader::http_event_handler(esp_http_client_event_t *evt) {
       if (strcasecmp(evt->header_key, "Content-Type") == 0) {
         this_reader->audio_file_type_ = get_audio_type(evt->header_value);
       }
+#ifdef USE_AUDIO_FILE_CACHE
+      else if (strcasecmp(evt->header_key, "ETag") == 0) {
+        this_reader->etag_ = evt->header_value;
+      } else if (strcasecmp(evt->header_key, "Cache-Control") == 0) {
+        const std::string cache_control = str_lower_case(evt->header_value);
+        this_reader->no_store_ = (cache_control.find("no-store") != std::string::npos);
+        const size_t max_age = cache_control.find("max-age=");
+        if (cache_control.find("no-cache") != std::string::npos) {
+          this_reader->max_age_s_ = 0;  // May be stored, but must be revalidated before every use
+        } else if (max_age != std::string::npos) {
+          this_reader->max_age_s_ = atoi(cache_control.c_str() + max_age + 8);
+        }
+      }
+#endif
       break;
     default:
       break;
@@ -261,33 +694,45 @@ AudioReaderState AudioReader::file_read_() {
 AudioReaderState AudioReader::http_read_() {
   this->output_transfer_buffer_->transfer_data_to_sink(pdMS_TO_TICKS(READ_WRITE_TIMEOUT_MS), false);
 
-  if (esp_http_client_is_complete_data_received(this->client_)) {
+  const bool download_finished = !this->read_ahead_running_.load();
+  const size_t buffered = this->read_ahead_ring_buffer_->available();
+
+  if (download_finished && (buffered == 0)) {
     if (this->output_transfer_buffer_->available() == 0) {
+      const bool failed = this->download_failed_.load();
       this->cleanup_connection_();
-      return AudioReaderState::FINISHED;
+      return failed ? AudioReaderState::FAILED : AudioReaderState::FINISHED;
     }
-  } else if (this->output_transfer_buffer_->free() > 0) {
-    size_t bytes_to_read = this->output_transfer_buffer_->free();
-    int received_len =
-        esp_http_client_read(this->client_, (char *) this->output_transfer_buffer_->get_buffer_end(), bytes_to_read);
+    return AudioReaderState::READING;
+  }
 
-    if (received_len > 0) {
-      this->output_transfer_buffer_->increase_buffer_length(received_len);
-      this->last_data_read_ms_ = millis();
-    } else if (received_len < 0) {
-      // HTTP read error
-      this->cleanup_connection_();
-      return AudioReaderState::FAILED;
-    } else {
-      if (bytes_to_read > 0) {
-        // Read timed out
-        if ((millis() - this->last_data_read_ms_) > CONNECTION_TIMEOUT_MS) {
-          this->cleanup_connection_();
-          return AudioReaderState::FAILED;
-        }
+  if (this->rebuffering_) {
+    if (!download_finished && (buffered < this->get_read_ahead_target())) {
+      delay(READ_WRITE_TIMEOUT_MS);
+      return AudioReaderState::READING;
+    }
+    this->rebuffering_ = false;
+    this->bitrate_window_start_ms_ = millis();
+    this->bitrate_window_bytes_ = 0;
+  }
 
-        delay(READ_WRITE_TIMEOUT_MS);
-      }
+  const size_t bytes_to_read = this->output_transfer_buffer_->free();
+  if (bytes_to_read > 0) {
+    // Blocks until the read-ahead task writes data, instead of sleeping a fixed time when the buffer is empty
+    const size_t bytes_read = this->read_ahead_ring_buffer_->read(
+        this->output_transfer_buffer_->get_buffer_end(), bytes_to_read, pdMS_TO_TICKS(READ_WRITE_TIMEOUT_MS));
+
+    if (bytes_read > 0) {
+      this->output_transfer_buffer_->increase_buffer_length(bytes_read);
+      this->last_data_read_ms_ = millis();
+      this->update_bitrate_(bytes_read);
+    } else if (!download_finished && (this->bitrate_.load() > 0)) {
+      // Ran dry mid-stream: increase the margin and wait until the target is buffered again
+      ++this->underruns_;
+      this->underrun_margin_ms_ =
+          std::min(this->underrun_margin_ms_.load() + UNDERRUN_MARGIN_STEP_MS, READ_AHEAD_MAX_MS);
+      this->rebuffering_ = true;
+      ESP_LOGD(TAG, "Read-ahead buffer underrun, rebuffering %u bytes", this->get_read_ahead_target());
     }
   }
 
@@ -295,11 +740,37 @@ AudioReaderState AudioReader::http_read_() {
 }
 
 void AudioReader::cleanup_connection_() {
+  this->stop_read_ahead_();
+
   if (this->client_ != nullptr) {
-    esp_http_client_close(this->client_);
-    esp_http_client_cleanup(this->client_);
+    if (this->read_ahead_ring_buffer_ != nullptr) {
+      ESP_LOGD(TAG, "Read-ahead target %u bytes at %u B/s with %u ms jitter, %u underruns, %s connection",
+               this->get_read_ahead_target(), this->bitrate_.load(), this->jitter_ms_.load(), this->underruns_,
+               this->connection_reused_ ? "reused" : "new");
+    }
+
+    const bool download_complete = (this->read_ahead_ring_buffer_ != nullptr) &&
+                                   esp_http_client_is_complete_data_received(this->client_) &&
+                                   !this->download_failed_.load();
+#ifdef USE_AUDIO_FILE_CACHE
+    this->finish_recording_(download_complete);
+#endif
+
+    // Only a connection whose response was read completely can carry the next request
+    if (download_complete || this->response_read_) {
+      release_idle_connection(this->client_);
+    } else {
+      close_client(this->client_);
+    }
     this->client_ = nullptr;
   }
+
+  this->read_ahead_ring_buffer_.reset();
+  if (this->read_chunk_ != nullptr) {
+    RAMAllocator<uint8_t> allocator;
+    allocator.deallocate(this->read_chunk_, HTTP_READ_CHUNK_SIZE);
+    this->read_chunk_ = nullptr;
+  }
 }
 
 }  // namespace audio
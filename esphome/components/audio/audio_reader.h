@@ -3,6 +3,7 @@
 #ifdef USE_ESP_IDF
 
 #include "audio.h"
+#include "audio_file_cache.h"
 #include "audio_transfer_buffer.h"
 
 #include "esphome/core/ring_buffer.h"
@@ -10,6 +11,12 @@
 #include "esp_err.h"
 
 #include <esp_http_client.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
 
 namespace esphome {
 namespace audio {
@@ -25,6 +32,16 @@ class AudioReader {
    * @brief Class that facilitates reading a raw audio file.
    * Files can be read from flash (stored in a AudioFile struct) or from an http source.
    * The file data is sent to a ring buffer sink.
+   *
+   * Http sources are downloaded by a read-ahead task into a ring buffer in external RAM, so network stalls don't reach
+   * the sink until the read-ahead is used up.
+   *  - The read-ahead target adapts to the stream: it covers a base duration plus a multiple of the measured arrival
+   *    jitter at the measured bitrate, and grows after every underrun. After an underrun, no data is sent to the sink
+   *    until the target is buffered again.
+   *  - Finished connections are kept open for a few seconds, so the next file from the same server reuses the
+   *    connection and skips the TCP and TLS handshakes.
+   *  - With the file cache enabled, files with a known length are recorded while they download. Later requests for
+   *    the same url are served from the AudioFileCache as a local file, after revalidating the ETag if necessary.
    */
  public:
   /// @brief Constructs an AudioReader object.
@@ -54,6 +71,18 @@ class AudioReader {
   /// @return AudioReaderState
   AudioReaderState read();
 
+  /// @brief Returns the number of times the read-ahead buffer ran empty while streaming from an http source
+  uint32_t get_underruns() const { return this->underruns_; }
+
+  /// @brief Returns the number of bytes the read-ahead task currently tries to keep buffered
+  size_t get_read_ahead_target() const;
+
+  /// @brief Returns true if the http source reused a connection left open by a previous reader
+  bool is_connection_reused() const { return this->connection_reused_; }
+
+  /// @brief Closes the connection kept open for reuse, if any
+  static void close_idle_connection();
+
  protected:
   /// @brief Monitors the http client events to attempt determining the file type from the Content-Type header
   static esp_err_t http_event_handler(esp_http_client_event_t *evt);
@@ -63,6 +92,22 @@ class AudioReader {
   /// @return AudioFileType of the url, if it can be determined. If not, return AudioFileType::NONE.
   static AudioFileType get_audio_type(const char *content_type);
 
+  /// @brief Sends the request on the client and follows any redirects
+  /// @return ESP_OK if the server responded with a successful status code, an ESP_ERR* code otherwise.
+  esp_err_t open_connection_();
+
+  /// @brief Allocates the read-ahead buffer and starts the read-ahead task
+  esp_err_t start_read_ahead_();
+
+  /// @brief Stops the read-ahead task and waits for it to exit
+  void stop_read_ahead_();
+
+  /// @brief Downloads the response body into the read-ahead buffer until the target is reached
+  static void read_ahead_task(void *params);
+
+  /// @brief Updates the measured bitrate with the bytes sent to the sink
+  void update_bitrate_(size_t bytes_forwarded);
+
   AudioReaderState file_read_();
   AudioReaderState http_read_();
 
@@ -74,6 +119,48 @@ class AudioReader {
   uint32_t last_data_read_ms_;
 
   esp_http_client_handle_t client_{nullptr};
+  bool connection_reused_{false};
+  bool response_read_{false};  // The response had no body, so the connection is ready for another request
+
+  std::unique_ptr<RingBuffer> read_ahead_ring_buffer_;
+  size_t read_ahead_capacity_{0};
+  uint8_t *read_chunk_{nullptr};
+  TaskHandle_t read_ahead_task_handle_{nullptr};
+  std::atomic<bool> stop_requested_{false};
+  std::atomic<bool> read_ahead_running_{false};
+  std::atomic<bool> download_failed_{false};
+
+  // Shared with the read-ahead task to compute the target
+  std::atomic<uint32_t> bitrate_{0};  // Bytes per second sent to the sink, 0 until measured
+  std::atomic<uint32_t> jitter_ms_{0};
+  std::atomic<uint32_t> underrun_margin_ms_{0};
+
+#ifdef USE_AUDIO_FILE_CACHE
+  /// @brief Starts reading the cached file as a local file
+  esp_err_t start_cached_file_(AudioFileType &file_type);
+
+  /// @brief Adds the recorded file to the cache if it was downloaded completely, deallocates it otherwise
+  void finish_recording_(bool download_complete);
+
+  std::string uri_;
+  std::shared_ptr<CachedAudioFile> cached_file_;
+
+  // Response headers of the last request
+  std::string etag_;
+  int32_t max_age_s_{-1};
+  bool no_store_{false};
+
+  // Written by the read-ahead task while it runs
+  uint8_t *record_buffer_{nullptr};
+  size_t record_capacity_{0};
+  size_t record_length_{0};
+  AudioFileType record_file_type_{AudioFileType::NONE};
+#endif
+
+  uint32_t bitrate_window_start_ms_{0};
+  size_t bitrate_window_bytes_{0};
+  uint32_t underruns_{0};
+  bool rebuffering_{false};
 
   AudioFile *current_audio_file_{nullptr};
   AudioFileType audio_file_type_{AudioFileType::NONE};
@@ -1,22 +1,70 @@
 #include "audio_resampler.h"
+#include "audio_sample_conversion.h"
 
 #ifdef USE_ESP32
 
 #include "esphome/core/hal.h"
+#include "esphome/core/log.h"
 
+#include <esp_heap_caps.h>
+
+#include <algorithm>
 #include <cstring>
 
 namespace esphome {
 namespace audio {
 
+static const char *const TAG = "audio_resampler";
+
 static const uint32_t READ_WRITE_TIMEOUT_MS = 20;
 
+AudioDriftCorrection &AudioDriftCorrection::get_instance() {
+  static AudioDriftCorrection correction;
+  return correction;
+}
+
 AudioResampler::AudioResampler(size_t input_buffer_size, size_t output_buffer_size)
     : input_buffer_size_(input_buffer_size), output_buffer_size_(output_buffer_size) {
+  this->free_heap_at_construction_ = heap_caps_get_free_size(MALLOC_CAP_8BIT);
   this->input_transfer_buffer_ = AudioSourceTransferBuffer::create(input_buffer_size);
   this->output_transfer_buffer_ = AudioSinkTransferBuffer::create(output_buffer_size);
 }
 
+AudioResampler::~AudioResampler() {
+  const AudioProcessingStats stats = this->get_stats();
+  if (stats.frames_processed > 0) {
+    ESP_LOGD(TAG,
+             "%" PRIu32 " Hz -> %" PRIu32 " Hz: %" PRIu32 " frames, %" PRIu32
+             " frames/s, %.2f bytes copied per frame, peak system heap drop %zu bytes",
+             this->input_stream_info_.get_sample_rate(), this->output_stream_info_.get_sample_rate(),
+             stats.frames_processed, stats.frames_per_second(), stats.bytes_copied_per_frame(),
+             stats.peak_system_heap_drop_bytes);
+  }
+  if ((this->frames_dropped_ > 0) || (this->frames_inserted_ > 0)) {
+    ESP_LOGD(TAG, "Drift correction dropped %" PRIu32 " and inserted %" PRIu32 " frames", this->frames_dropped_,
+             this->frames_inserted_);
+  }
+}
+
+AudioProcessingStats AudioResampler::get_stats() const {
+  AudioProcessingStats stats = this->stats_;
+  if (this->input_transfer_buffer_ != nullptr) {
+    stats.bytes_copied += this->input_transfer_buffer_->get_bytes_copied();
+  }
+  if (this->output_transfer_buffer_ != nullptr) {
+    stats.bytes_copied += this->output_transfer_buffer_->get_bytes_copied();
+  }
+  return stats;
+}
+
+void AudioResampler::update_peak_system_heap_drop_() {
+  const size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  if (free_heap < this->free_heap_at_construction_) {
+    this->stats_.peak_system_heap_drop_bytes =
+        std::max(this->stats_.peak_system_heap_drop_bytes, this->free_heap_at_construction_ - free_heap);
+  }
+}
+
 esp_err_t AudioResampler::add_source(std::weak_ptr<RingBuffer> &input_ring_buffer) {
   if (this->input_transfer_buffer_ != nullptr) {
     this->input_transfer_buffer_->set_source(input_ring_buffer);
@@ -57,8 +105,18 @@ esp_err_t AudioResampler::start(AudioStreamInfo &input_stream_info, AudioStreamI
     return ESP_ERR_NOT_SUPPORTED;
   }
 
-  if ((input_stream_info.get_sample_rate() != output_stream_info.get_sample_rate()) ||
-      (input_stream_info.get_bits_per_sample() != output_stream_info.get_bits_per_sample())) {
+  // Process the transfer buffers in place as rings so the unprocessed data never needs to be shifted. Both buffers hold
+  // whole frames, so a frame is never split at the point where the rings wrap around.
+  if (!this->input_transfer_buffer_->enable_ring_mode(input_stream_info.frames_to_bytes(1)) ||
+      !this->output_transfer_buffer_->enable_ring_mode(output_stream_info.frames_to_bytes(1))) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  // Only steps requested while this stream plays apply to it
+  this->step_generation_ = AudioDriftCorrection::get_instance().get_step_generation();
+  this->last_output_frame_.assign(output_stream_info.frames_to_bytes(1), 0);
+
+  if (input_stream_info.get_sample_rate() != output_stream_info.get_sample_rate()) {
     this->resampler_ = make_unique<esp_audio_libs::resampler::Resampler>(
         input_stream_info.bytes_to_samples(this->input_buffer_size_),
         output_stream_info.bytes_to_samples(this->output_buffer_size_));
@@ -97,7 +155,9 @@ AudioResamplerState AudioResampler::resample(bool stop_gracefully, int32_t *ms_d
   if (!this->pause_output_) {
     // Move audio data to the sink without shifting the data in the output transfer buffer to avoid unnecessary, slow
     // data moves
-    this->output_transfer_buffer_->transfer_data_to_sink(pdMS_TO_TICKS(READ_WRITE_TIMEOUT_MS), false);
+    size_t bytes_written =
+        this->output_transfer_buffer_->transfer_data_to_sink(pdMS_TO_TICKS(READ_WRITE_TIMEOUT_MS), false);
+    this->stats_.frames_processed += this->output_stream_info_.bytes_to_frames(bytes_written);
   } else {
     // If paused, block to avoid wasting CPU resources
     delay(READ_WRITE_TIMEOUT_MS);
@@ -110,53 +170,160 @@ AudioResamplerState AudioResampler::resample(bool stop_gracefully, int32_t *ms_d
     return AudioResamplerState::RESAMPLING;
   }
 
-  const size_t bytes_free = this->output_transfer_buffer_->free();
-  const uint32_t frames_free = this->output_stream_info_.bytes_to_frames(bytes_free);
+  const uint32_t processing_start_us = micros();
 
-  const size_t bytes_available = this->input_transfer_buffer_->available();
-  const uint32_t frames_available = this->input_stream_info_.bytes_to_frames(bytes_available);
+  // Frames taken from the input and frames added to the output, including the drift correction's drops and inserts
+  uint32_t frames_used = 0;
+  uint32_t frames_generated = 0;
 
-  if ((this->input_stream_info_.get_sample_rate() != this->output_stream_info_.get_sample_rate()) ||
-      (this->input_stream_info_.get_bits_per_sample() != this->output_stream_info_.get_bits_per_sample())) {
-    // Adjust gain by -3 dB to avoid clipping due to the resampling process
-    esp_audio_libs::resampler::ResamplerResults results =
-        this->resampler_->resample(this->input_transfer_buffer_->get_buffer_start(),
-                                   this->output_transfer_buffer_->get_buffer_end(), frames_available, frames_free, -3);
+  if (this->input_stream_info_.get_sample_rate() != this->output_stream_info_.get_sample_rate()) {
+    // The transfer buffers are rings, so the input and output may each be split into two spans. Resample span by span
+    // until either runs out.
+    while (true) {
+      size_t bytes_available = 0;
+      uint8_t *input_span = this->input_transfer_buffer_->peek_read_span(&bytes_available);
+      const uint32_t frames_available = this->input_stream_info_.bytes_to_frames(bytes_available);
 
-    this->input_transfer_buffer_->decrease_buffer_length(this->input_stream_info_.frames_to_bytes(results.frames_used));
-    this->output_transfer_buffer_->increase_buffer_length(
-        this->output_stream_info_.frames_to_bytes(results.frames_generated));
+      size_t bytes_free = 0;
+      uint8_t *output_span = this->output_transfer_buffer_->acquire_write_span(&bytes_free);
+      const uint32_t frames_free = this->output_stream_info_.bytes_to_frames(bytes_free);
 
-    // Resampling causes slight differences in the durations used versus generated. Computes the difference in
-    // millisconds. The callback function passing the played audio duration uses the difference to convert from output
-    // duration to input duration.
-    this->accumulated_frames_used_ += results.frames_used;
-    this->accumulated_frames_generated_ += results.frames_generated;
+      if ((frames_available == 0) || (frames_free == 0)) {
+        break;
+      }
 
-    const int32_t used_ms =
-        this->input_stream_info_.frames_to_milliseconds_with_remainder(&this->accumulated_frames_used_);
-    const int32_t generated_ms =
-        this->output_stream_info_.frames_to_milliseconds_with_remainder(&this->accumulated_frames_generated_);
+      // Adjust gain by -3 dB to avoid clipping due to the resampling process
+      esp_audio_libs::resampler::ResamplerResults results =
+          this->resampler_->resample(input_span, output_span, frames_available, frames_free, -3);
 
-    *ms_differential = used_ms - generated_ms;
+      this->input_transfer_buffer_->decrease_buffer_length(
+          this->input_stream_info_.frames_to_bytes(results.frames_used));
+      frames_generated += this->commit_output_frames_(output_span, results.frames_generated);
+      frames_used += results.frames_used;
 
+      if ((results.frames_used == 0) && (results.frames_generated == 0)) {
+        break;
+      }
+    }
   } else {
-    // No resampling required, copy samples directly to the output transfer buffer
-    *ms_differential = 0;
+    // No resampling required, copy samples directly to the output transfer buffer, converting the bits per sample if
+    // necessary
+    const size_t input_bytes_per_sample = this->input_stream_info_.samples_to_bytes(1);
+    const size_t output_bytes_per_sample = this->output_stream_info_.samples_to_bytes(1);
+
+    while (true) {
+      size_t bytes_available = 0;
+      uint8_t *input_span = this->input_transfer_buffer_->peek_read_span(&bytes_available);
+
+      size_t bytes_free = 0;
+      uint8_t *output_span = this->output_transfer_buffer_->acquire_write_span(&bytes_free);
+
+      const uint32_t frames_to_transfer = std::min(this->output_stream_info_.bytes_to_frames(bytes_free),
+                                                   this->input_stream_info_.bytes_to_frames(bytes_available));
+      if (frames_to_transfer == 0) {
+        break;
+      }
+
+      const uint32_t samples_to_transfer = frames_to_transfer * this->input_stream_info_.get_channels();
+      convert_audio_samples(input_span, input_bytes_per_sample, output_span, output_bytes_per_sample,
+                            samples_to_transfer);
+
+      this->input_transfer_buffer_->decrease_buffer_length(this->input_stream_info_.frames_to_bytes(frames_to_transfer));
+      frames_generated += this->commit_output_frames_(output_span, frames_to_transfer);
+      frames_used += frames_to_transfer;
+      this->stats_.bytes_copied += this->output_stream_info_.frames_to_bytes(frames_to_transfer);
+    }
+  }
 
-    const size_t bytes_to_transfer = std::min(this->output_stream_info_.frames_to_bytes(frames_free),
-                                              this->input_stream_info_.frames_to_bytes(frames_available));
+  // Resampling and drift correction cause differences in the durations used versus generated. Computes the difference
+  // in millisconds. The callback function passing the played audio duration uses the difference to convert from output
+  // duration to input duration.
+  this->accumulated_frames_used_ += frames_used;
+  this->accumulated_frames_generated_ += frames_generated;
 
-    std::memcpy((void *) this->output_transfer_buffer_->get_buffer_end(),
-                (void *) this->input_transfer_buffer_->get_buffer_start(), bytes_to_transfer);
+  const int32_t used_ms =
+      this->input_stream_info_.frames_to_milliseconds_with_remainder(&this->accumulated_frames_used_);
+  const int32_t generated_ms =
+      this->output_stream_info_.frames_to_milliseconds_with_remainder(&this->accumulated_frames_generated_);
 
-    this->input_transfer_buffer_->decrease_buffer_length(bytes_to_transfer);
-    this->output_transfer_buffer_->increase_buffer_length(bytes_to_transfer);
-  }
+  *ms_differential = used_ms - generated_ms;
+
+  this->stats_.processing_us += micros() - processing_start_us;
+  this->update_peak_system_heap_drop_();
 
   return AudioResamplerState::RESAMPLING;
 }
 
+uint32_t AudioResampler::commit_output_frames_(const uint8_t *output_span, uint32_t frames) {
+  AudioDriftCorrection &correction = AudioDriftCorrection::get_instance();
+  const size_t frame_bytes = this->output_stream_info_.frames_to_bytes(1);
+
+  const uint32_t step_generation = correction.get_step_generation();
+  if (step_generation != this->step_generation_) {
+    this->step_generation_ = step_generation;
+    const int64_t step_frames =
+        (int64_t) correction.get_step_us() * this->output_stream_info_.get_sample_rate() / 1000000;
+    this->pending_step_frames_ += step_frames;
+    correction.report_step_applied(step_generation);
+  }
+
+  // Whole frames to correct at the current rate; the remainder carries over to the next call
+  this->drift_accumulator_ += (int64_t) frames * correction.get_rate_ppm();
+  const int64_t rate_frames = this->drift_accumulator_ / 1000000;
+  this->drift_accumulator_ -= rate_frames * 1000000;
+
+  uint32_t rate_drops = 0;
+  if (rate_frames > 0) {
+    rate_drops = std::min<uint32_t>(rate_frames, frames);
+    // Frames that can't be dropped from this call are dropped from the next one
+    this->drift_accumulator_ += (rate_frames - rate_drops) * 1000000;
+  } else {
+    this->pending_repeat_frames_ += -rate_frames;
+  }
+  uint32_t step_drops = 0;
+  if (this->pending_step_frames_ > 0) {
+    step_drops = std::min<uint32_t>(this->pending_step_frames_, frames - rate_drops);
+    this->pending_step_frames_ -= step_drops;
+  }
+  const uint32_t frames_to_drop = rate_drops + step_drops;
+
+  const uint32_t frames_to_commit = frames - frames_to_drop;
+  uint32_t frames_added = frames_to_commit;
+  this->frames_dropped_ += frames_to_drop;
+  if (frames_to_commit > 0) {
+    std::memcpy(this->last_output_frame_.data(), output_span + (frames_to_commit - 1) * frame_bytes, frame_bytes);
+    this->has_last_output_frame_ = true;
+    this->output_transfer_buffer_->increase_buffer_length(this->output_stream_info_.frames_to_bytes(frames_to_commit));
+  }
+
+  // Inserted frames go after the committed frames, if there is room; otherwise they wait for the next call
+  while ((this->pending_step_frames_ < 0) || ((this->pending_repeat_frames_ > 0) && this->has_last_output_frame_)) {
+    size_t bytes_free = 0;
+    uint8_t *span = this->output_transfer_buffer_->acquire_write_span(&bytes_free);
+    uint32_t frames_free = this->output_stream_info_.bytes_to_frames(bytes_free);
+    if (frames_free == 0) {
+      break;
+    }
+
+    if (this->pending_step_frames_ < 0) {
+      const uint32_t silence_frames = std::min<uint32_t>(-this->pending_step_frames_, frames_free);
+      std::memset(span, 0, this->output_stream_info_.frames_to_bytes(silence_frames));
+      this->output_transfer_buffer_->increase_buffer_length(this->output_stream_info_.frames_to_bytes(silence_frames));
+      this->pending_step_frames_ += silence_frames;
+      this->frames_inserted_ += silence_frames;
+      frames_added += silence_frames;
+    } else {
+      std::memcpy(span, this->last_output_frame_.data(), frame_bytes);
+      this->output_transfer_buffer_->increase_buffer_length(frame_bytes);
+      --this->pending_repeat_frames_;
+      ++this->frames_inserted_;
+      ++frames_added;
+    }
+  }
+
+  return frames_added;
+}
+
 }  // namespace audio
 }  // namespace esphome
 
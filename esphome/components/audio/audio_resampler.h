@@ -17,9 +17,59 @@
 
 #include <resampler.h>  // esp-audio-libs
 
+#include <atomic>
+#include <vector>
+
 namespace esphome {
 namespace audio {
 
+class AudioDriftCorrection {
+  /*
+   * @brief Clock drift correction shared by every AudioResampler, set by a playback sync engine. All streams end up on
+   * the same I2S clock, so they all need the same correction. Corrections are applied to the resampled output, in output
+   * frames, so they work whether or not the sample rate is converted.
+   *
+   *  - The rate drops (positive) or repeats (negative) single frames at the given parts per million of frames.
+   *  - A step drops (positive) or inserts silence (negative) for a duration once in every running stream, to quickly
+   *    jump to the right phase. Resamplers started after the step don't apply it, so a step only takes effect once a
+   *    resampler reported applying it.
+   */
+ public:
+  static AudioDriftCorrection &get_instance();
+
+  void set_rate_ppm(int32_t ppm) { this->rate_ppm_ = ppm; }
+  int32_t get_rate_ppm() const { return this->rate_ppm_.load(std::memory_order_relaxed); }
+
+  /// @brief Requests a phase step. A later step replaces it in resamplers that haven't applied it yet.
+  /// @param duration_us Duration to drop if positive, or of silence to insert if negative
+  /// @return Generation of the step, to compare with get_applied_step_generation
+  uint32_t step(int32_t duration_us) {
+    this->step_us_ = duration_us;
+    return this->step_generation_.fetch_add(1, std::memory_order_release) + 1;
+  }
+  uint32_t get_step_generation() const { return this->step_generation_.load(std::memory_order_acquire); }
+  int32_t get_step_us() const { return this->step_us_.load(std::memory_order_relaxed); }
+
+  /// @brief Called by a resampler that started applying the step of the given generation
+  void report_step_applied(uint32_t generation) {
+    uint32_t applied = this->applied_step_generation_.load(std::memory_order_relaxed);
+    // Another resampler may have reported a newer step in the meantime
+    while (((int32_t) (generation - applied) > 0) &&
+           !this->applied_step_generation_.compare_exchange_weak(applied, generation, std::memory_order_relaxed)) {
+    }
+  }
+  /// @brief Returns the generation of the newest step that a resampler applied
+  uint32_t get_applied_step_generation() const {
+    return this->applied_step_generation_.load(std::memory_order_relaxed);
+  }
+
+ protected:
+  std::atomic<int32_t> rate_ppm_{0};
+  std::atomic<int32_t> step_us_{0};
+  std::atomic<uint32_t> step_generation_{0};
+  std::atomic<uint32_t> applied_step_generation_{0};
+};
+
 enum class AudioResamplerState : uint8_t {
   RESAMPLING,  // More data is available to resample
   FINISHED,    // All file data has been resampled and transferred
@@ -38,6 +88,9 @@ class AudioResampler {
   /// @param output_buffer_size Size of the output transfer buffer in bytes.
   AudioResampler(size_t input_buffer_size, size_t output_buffer_size);
 
+  /// @brief Logs the collected benchmark counters
+  ~AudioResampler();
+
   /// @brief Adds a source ring buffer for audio data. Takes ownership of the ring buffer in a shared_ptr.
   /// @param input_ring_buffer weak_ptr of a shared_ptr of the sink ring buffer to transfer ownership
   /// @return ESP_OK if successsful, ESP_ERR_NO_MEM if the transfer buffer wasn't allocated
@@ -70,7 +123,8 @@ class AudioResampler {
   /// @param stop_gracefully If true, it indicates the file decoder is finished. The resampler will resample all the
   ///                        remaining audio and then finish.
   /// @param ms_differential Pointer to a (int32_t) variable that will store the difference, in milliseconds, between
-  ///                        the duration of input audio used and the duration of output audio generated.
+  ///                        the duration of input audio used and the duration of output audio generated, including
+  ///                        the frames dropped or inserted for drift correction.
   /// @return AudioResamplerState
   AudioResamplerState resample(bool stop_gracefully, int32_t *ms_differential);
 
@@ -78,7 +132,35 @@ class AudioResampler {
   /// @param pause_state If true, audio data is not sent to the sink.
   void set_pause_output_state(bool pause_state) { this->pause_output_ = pause_state; }
 
+  /// @brief Returns the number of frames dropped and inserted to follow the AudioDriftCorrection
+  uint32_t get_frames_dropped() const { return this->frames_dropped_; }
+  uint32_t get_frames_inserted() const { return this->frames_inserted_; }
+
+  /// @brief Returns the benchmark counters collected since the resampler was constructed
+  /// @return AudioProcessingStats with the generated frames, bytes copied, resampling time, and peak system heap drop
+  AudioProcessingStats get_stats() const;
+
  protected:
+  /// @brief Updates the peak system heap drop with the current free heap size
+  void update_peak_system_heap_drop_();
+
+  /// @brief Commits frames written to the output span, dropping frames from the end as the AudioDriftCorrection
+  /// requests, then inserts any pending frames after them.
+  /// @param output_span Span the frames were written to
+  /// @param frames Number of frames written to the span
+  /// @return Number of frames added to the output transfer buffer, the committed frames plus any inserted ones
+  uint32_t commit_output_frames_(const uint8_t *output_span, uint32_t frames);
+
+  // Drift correction state
+  int64_t drift_accumulator_{0};  // Frames times ppm not yet corrected
+  uint32_t step_generation_{0};
+  int32_t pending_step_frames_{0};    // Positive frames to drop, negative frames of silence to insert
+  uint32_t pending_repeat_frames_{0};
+  std::vector<uint8_t> last_output_frame_;
+  bool has_last_output_frame_{false};
+  uint32_t frames_dropped_{0};
+  uint32_t frames_inserted_{0};
+
   std::unique_ptr<AudioSourceTransferBuffer> input_transfer_buffer_;
   std::unique_ptr<AudioSinkTransferBuffer> output_transfer_buffer_;
 
@@ -94,6 +176,9 @@ class AudioResampler {
   AudioStreamInfo output_stream_info_;
 
   std::unique_ptr<esp_audio_libs::resampler::Resampler> resampler_;
+
+  AudioProcessingStats stats_;
+  size_t free_heap_at_construction_{0};
 };
 
 }  // namespace audio
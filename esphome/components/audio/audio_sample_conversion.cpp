@@ -0,0 +1,131 @@
+#include "audio_sample_conversion.h"
+
+#include "esphome/core/defines.h"
+
+namespace esphome {
+namespace audio {
+
+#if defined(USE_ESP32_VARIANT_ESP32S3)
+// Widens and scales 8 16 bit samples per iteration with the ESP32-S3's PIE instructions. Each output sample is
+// (sample * factor) << 1, built from two EE.VMUL.S16 products that both keep the lower 16 bits of the shifted product:
+// the upper half is (sample * factor) >> 15, the lower half is sample * (factor << 1) with the factor wrapped to 16
+// bits, which has the same lower 16 bits as the full product. EE.VZIP.16 interleaves the halves into 32 bit samples.
+// This matches convert_audio_samples_to_q31_scaled<2> bit for bit.
+//
+// The input may be unaligned: EE.LD.128.USAR.IP loads the aligned block holding the address and records the offset,
+// which EE.SRC.Q then uses to shift two consecutive blocks into place. The loop reads the aligned block after the last
+// converted sample, so the caller must leave at least one sample unconverted behind the blocks. The output must be 16
+// byte aligned and blocks must be at least 1.
+//
+// Like scale_audio_samples_pie, the caller's SAR is restored before returning and the q registers are saved with the
+// task's coprocessor context, so this must never be called from an ISR.
+static void convert_16_bit_samples_to_q31_scaled_pie(const int16_t *input, int32_t *output, int16_t q15_scale_factor,
+                                                     size_t blocks) {
+  const int16_t low_factor = (int16_t) ((uint16_t) q15_scale_factor << 1);
+  asm volatile(
+      "rsr.sar a9 \n"
+      "ee.vldbc.16 q4, %[factor] \n"
+      "ee.vldbc.16 q5, %[low_factor] \n"
+      "ee.ld.128.usar.ip q0, %[input], 16 \n"
+      "1: \n"
+      "ee.ld.128.usar.ip q1, %[input], 16 \n"
+      "ee.src.q q2, q0, q1 \n"
+      "ee.orq q0, q1, q1 \n"
+      "ssai 15 \n"
+      "ee.vmul.s16 q3, q2, q4 \n"
+      "ssai 0 \n"
+      "ee.vmul.s16 q2, q2, q5 \n"
+      "ee.vzip.16 q2, q3 \n"
+      "ee.vst.128.ip q2, %[output], 16 \n"
+      "addi.n %[blocks], %[blocks], -1 \n"
+      "ee.vst.128.ip q3, %[output], 16 \n"
+      "bnez %[blocks], 1b \n"
+      "wsr.sar a9 \n"
+      : [input] "+r"(input), [output] "+r"(output), [blocks] "+r"(blocks)
+      : [factor] "r"(&q15_scale_factor), [low_factor] "r"(&low_factor)
+      : "a9", "memory");
+}
+
+static void convert_16_bit_samples_to_q31_scaled(const uint8_t *input, int32_t *output, int16_t q15_scale_factor,
+                                                 size_t samples) {
+  // Convert the leading samples until the output is 16 byte aligned
+  size_t i = std::min<size_t>(((16 - ((uintptr_t) output & 15)) & 15) / sizeof(int32_t), samples);
+  convert_audio_samples_to_q31_scaled<2>(input, output, q15_scale_factor, i);
+
+  // Leaves at least one sample behind the blocks, see convert_16_bit_samples_to_q31_scaled_pie
+  const size_t blocks = (samples > i) ? (samples - i - 1) / 8 : 0;
+  if (blocks > 0) {
+    convert_16_bit_samples_to_q31_scaled_pie(reinterpret_cast<const int16_t *>(input + i * 2), output + i,
+                                             q15_scale_factor, blocks);
+    i += blocks * 8;
+  }
+
+  convert_audio_samples_to_q31_scaled<2>(input + i * 2, output + i, q15_scale_factor, samples - i);
+}
+#endif
+
+template<size_t INPUT_BYTES>
+static bool convert_audio_samples_from(const uint8_t *input, uint8_t *output, size_t output_bytes_per_sample,
+                                       size_t samples) {
+  switch (output_bytes_per_sample) {
+    case 1:
+      convert_audio_samples<INPUT_BYTES, 1>(input, output, samples);
+      return true;
+    case 2:
+      convert_audio_samples<INPUT_BYTES, 2>(input, output, samples);
+      return true;
+    case 3:
+      convert_audio_samples<INPUT_BYTES, 3>(input, output, samples);
+      return true;
+    case 4:
+      convert_audio_samples<INPUT_BYTES, 4>(input, output, samples);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool convert_audio_samples(const uint8_t *input, size_t input_bytes_per_sample, uint8_t *output,
+                           size_t output_bytes_per_sample, size_t samples) {
+  switch (input_bytes_per_sample) {
+    case 1:
+      return convert_audio_samples_from<1>(input, output, output_bytes_per_sample, samples);
+    case 2:
+      return convert_audio_samples_from<2>(input, output, output_bytes_per_sample, samples);
+    case 3:
+      return convert_audio_samples_from<3>(input, output, output_bytes_per_sample, samples);
+    case 4:
+      return convert_audio_samples_from<4>(input, output, output_bytes_per_sample, samples);
+    default:
+      return false;
+  }
+}
+
+bool convert_audio_samples_to_q31_scaled(const uint8_t *input, size_t input_bytes_per_sample, int32_t *output,
+                                         int16_t q15_scale_factor, size_t samples) {
+  switch (input_bytes_per_sample) {
+    case 1:
+      convert_audio_samples_to_q31_scaled<1>(input, output, q15_scale_factor, samples);
+      return true;
+    case 2:
+#if defined(USE_ESP32_VARIANT_ESP32S3)
+      if (q15_scale_factor != INT16_MAX) {
+        convert_16_bit_samples_to_q31_scaled(input, output, q15_scale_factor, samples);
+        return true;
+      }
+#endif
+      convert_audio_samples_to_q31_scaled<2>(input, output, q15_scale_factor, samples);
+      return true;
+    case 3:
+      convert_audio_samples_to_q31_scaled<3>(input, output, q15_scale_factor, samples);
+      return true;
+    case 4:
+      convert_audio_samples_to_q31_scaled<4>(input, output, q15_scale_factor, samples);
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace audio
+}  // namespace esphome
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace audio {
+
+/*
+ * Bulk sample format conversion. Each conversion is a template specialized for the input and output sample sizes, so
+ * the inner loops have no per-sample branches on the sample size. Samples are little endian, signed, and aligned to
+ * the byte. Like unpack_audio_sample_to_q31 and pack_q31_as_audio_sample, converting to fewer bits keeps the most
+ * significant bits without dithering.
+ */
+
+/// @brief Loads and stores a packed little endian sample as a Q31 fixed-point number.
+/// @tparam BYTES_PER_SAMPLE Size of the packed sample in bytes, from 1 to 4
+template<size_t BYTES_PER_SAMPLE> struct PackedSample;
+
+template<> struct PackedSample<1> {
+  static inline int32_t load(const uint8_t *data) { return (int32_t) ((uint32_t) data[0] << 24); }
+  static inline void store(int32_t sample, uint8_t *data) { data[0] = (uint8_t) (sample >> 24); }
+};
+
+template<> struct PackedSample<2> {
+  static inline int32_t load(const uint8_t *data) {
+    return (int32_t) (((uint32_t) data[0] << 16) | ((uint32_t) data[1] << 24));
+  }
+  static inline void store(int32_t sample, uint8_t *data) {
+    data[0] = (uint8_t) (sample >> 16);
+    data[1] = (uint8_t) (sample >> 24);
+  }
+};
+
+template<> struct PackedSample<3> {
+  static inline int32_t load(const uint8_t *data) {
+    return (int32_t) (((uint32_t) data[0] << 8) | ((uint32_t) data[1] << 16) | ((uint32_t) data[2] << 24));
+  }
+  static inline void store(int32_t sample, uint8_t *data) {
+    data[0] = (uint8_t) (sample >> 8);
+    data[1] = (uint8_t) (sample >> 16);
+    data[2] = (uint8_t) (sample >> 24);
+  }
+};
+
+template<> struct PackedSample<4> {
+  static inline int32_t load(const uint8_t *data) {
+    return (int32_t) ((uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) |
+                      ((uint32_t) data[3] << 24));
+  }
+  static inline void store(int32_t sample, uint8_t *data) {
+    data[0] = (uint8_t) sample;
+    data[1] = (uint8_t) (sample >> 8);
+    data[2] = (uint8_t) (sample >> 16);
+    data[3] = (uint8_t) (sample >> 24);
+  }
+};
+
+/// @brief Converts samples from one sample size to another. Converts in place if input == output.
+/// @tparam INPUT_BYTES Bytes per input sample
+/// @tparam OUTPUT_BYTES Bytes per output sample
+/// @param input Pointer to the input samples
+/// @param output Pointer to the output buffer, with space for `samples` samples
+/// @param samples Number of samples to convert
+template<size_t INPUT_BYTES, size_t OUTPUT_BYTES>
+void convert_audio_samples(const uint8_t *input, uint8_t *output, size_t samples) {
+  if (INPUT_BYTES == OUTPUT_BYTES) {
+    if (input != output) {
+      std::memmove(output, input, samples * INPUT_BYTES);
+    }
+  } else if (OUTPUT_BYTES < INPUT_BYTES) {
+    // Narrowing: each output sample ends before the next input sample starts, so converting forwards is safe in place
+    for (size_t i = 0; i < samples; ++i) {
+      PackedSample<OUTPUT_BYTES>::store(PackedSample<INPUT_BYTES>::load(input + i * INPUT_BYTES),
+                                        output + i * OUTPUT_BYTES);
+    }
+  } else {
+    // Widening: convert backwards so in place conversion doesn't overwrite unconverted input samples
+    for (size_t i = samples; i > 0; --i) {
+      PackedSample<OUTPUT_BYTES>::store(PackedSample<INPUT_BYTES>::load(input + (i - 1) * INPUT_BYTES),
+                                        output + (i - 1) * OUTPUT_BYTES);
+    }
+  }
+}
+
+/// @brief Converts samples from one sample size to another, selecting the specialized conversion at runtime. Converts in
+/// place if input == output.
+/// @param input Pointer to the input samples
+/// @param input_bytes_per_sample Bytes per input sample, from 1 to 4
+/// @param output Pointer to the output buffer, with space for `samples` samples
+/// @param output_bytes_per_sample Bytes per output sample, from 1 to 4
+/// @param samples Number of samples to convert
+/// @return True if converted, false if a sample size isn't supported
+bool convert_audio_samples(const uint8_t *input, size_t input_bytes_per_sample, uint8_t *output,
+                           size_t output_bytes_per_sample, size_t samples);
+
+/// @brief Widens samples to Q31 and scales them by a Q15 factor in a single pass, e.g., to stage audio for an I2S bus
+/// with 32 bit slots without a separate volume pass over the input.
+/// @tparam INPUT_BYTES Bytes per input sample, from 1 to 4
+/// @param input Pointer to the input samples
+/// @param output Pointer to the output buffer, with space for `samples` samples
+/// @param q15_scale_factor Q15 fixed-point scaling factor; INT16_MAX passes the samples through unscaled
+/// @param samples Number of samples to convert
+template<size_t INPUT_BYTES>
+void convert_audio_samples_to_q31_scaled(const uint8_t *input, int32_t *output, int16_t q15_scale_factor,
+                                         size_t samples) {
+  if (q15_scale_factor == INT16_MAX) {
+    for (size_t i = 0; i < samples; ++i) {
+      output[i] = PackedSample<INPUT_BYTES>::load(input + i * INPUT_BYTES);
+    }
+  } else if (INPUT_BYTES <= 2) {
+    // The product of two Q15 numbers fits in 31 bits, so no 64 bit multiplication is needed
+    for (size_t i = 0; i < samples; ++i) {
+      output[i] = (PackedSample<INPUT_BYTES>::load(input + i * INPUT_BYTES) >> 16) * q15_scale_factor * 2;
+    }
+  } else {
+    for (size_t i = 0; i < samples; ++i) {
+      output[i] =
+          (int32_t) (((int64_t) PackedSample<INPUT_BYTES>::load(input + i * INPUT_BYTES) * q15_scale_factor) >> 15);
+    }
+  }
+}
+
+/// @brief Widens samples to Q31 and scales them by a Q15 factor, selecting the specialized conversion at runtime.
+/// @param input Pointer to the input samples
+/// @param input_bytes_per_sample Bytes per input sample, from 1 to 4
+/// @param output Pointer to the output buffer, with space for `samples` samples
+/// @param q15_scale_factor Q15 fixed-point scaling factor; INT16_MAX passes the samples through unscaled
+/// @param samples Number of samples to convert
+/// @return True if converted, false if the input sample size isn't supported
+bool convert_audio_samples_to_q31_scaled(const uint8_t *input, size_t input_bytes_per_sample, int32_t *output,
+                                         int16_t q15_scale_factor, size_t samples);
+
+/// @brief Interleaves separate channel buffers into frames.
+/// @tparam BYTES_PER_SAMPLE Bytes per sample
+/// @param channels Array of `channel_count` pointers to each channel's samples
+/// @param output Pointer to the output buffer, with space for `frames` frames
+/// @param channel_count Number of channels
+/// @param frames Number of frames to interleave
+template<size_t BYTES_PER_SAMPLE>
+void interleave_audio_samples(const uint8_t *const *channels, uint8_t *output, size_t channel_count, size_t frames) {
+  for (size_t channel = 0; channel < channel_count; ++channel) {
+    const uint8_t *input = channels[channel];
+    uint8_t *out = output + channel * BYTES_PER_SAMPLE;
+    for (size_t i = 0; i < frames; ++i) {
+      std::memcpy(out, input, BYTES_PER_SAMPLE);
+      input += BYTES_PER_SAMPLE;
+      out += channel_count * BYTES_PER_SAMPLE;
+    }
+  }
+}
+
+/// @brief Splits interleaved frames into separate channel buffers.
+/// @tparam BYTES_PER_SAMPLE Bytes per sample
+/// @param input Pointer to the interleaved frames
+/// @param channels Array of `channel_count` pointers to each channel's output buffer, with space for `frames` samples
+/// @param channel_count Number of channels
+/// @param frames Number of frames to deinterleave
+template<size_t BYTES_PER_SAMPLE>
+void deinterleave_audio_samples(const uint8_t *input, uint8_t *const *channels, size_t channel_count, size_t frames) {
+  for (size_t channel = 0; channel < channel_count; ++channel) {
+    const uint8_t *in = input + channel * BYTES_PER_SAMPLE;
+    uint8_t *out = channels[channel];
+    for (size_t i = 0; i < frames; ++i) {
+      std::memcpy(out, in, BYTES_PER_SAMPLE);
+      in += channel_count * BYTES_PER_SAMPLE;
+      out += BYTES_PER_SAMPLE;
+    }
+  }
+}
+
+/// @brief Converts frames of interleaved Q31 slots (e.g., a TDM frame) to Q15 frames in a single pass, amplifying
+/// every slot by its own gain and saturating instead of wrapping. The number of slots is a template parameter, so the
+/// slot loop is unrolled and the inner loop has no per-sample branches.
+/// @tparam SLOTS Number of slots in a frame
+/// @param input Pointer to the Q31 frames
+/// @param output Pointer to the output buffer, with space for `frames` frames of Q15 samples
+/// @param frames Number of frames to convert
+/// @param gain_shifts Amplifies each slot by 2^gain_shift before saturating; each at most 16
+template<size_t SLOTS>
+void convert_q31_frames_to_q15(const int32_t *input, int16_t *output, size_t frames,
+                               const std::array<uint8_t, SLOTS> &gain_shifts) {
+  std::array<uint8_t, SLOTS> shifts;
+  for (size_t slot = 0; slot < SLOTS; ++slot) {
+    shifts[slot] = 16 - gain_shifts[slot];
+  }
+
+  for (size_t i = 0; i < frames; ++i) {
+    for (size_t slot = 0; slot < SLOTS; ++slot) {
+      const int32_t sample = input[slot] >> shifts[slot];
+      output[slot] = (int16_t) std::min<int32_t>(std::max<int32_t>(sample, INT16_MIN), INT16_MAX);
+    }
+    input += SLOTS;
+    output += SLOTS;
+  }
+}
+
+}  // namespace audio
+}  // namespace esphome
@@ -0,0 +1,138 @@
+#include "audio_spmc_ring_buffer.h"
+
+#ifdef USE_ESP32
+
+#include <freertos/task.h>
+
+#include <cstring>
+
+namespace esphome {
+namespace audio {
+
+std::unique_ptr<SPMCRingBuffer> SPMCRingBuffer::create(size_t capacity, size_t alignment) {
+  std::unique_ptr<SPMCRingBuffer> ring_buffer = make_unique<SPMCRingBuffer>();
+
+  ring_buffer->alignment_ = std::max(alignment, (size_t) 1);
+  ring_buffer->capacity_ = (capacity / ring_buffer->alignment_) * ring_buffer->alignment_;
+  if (ring_buffer->capacity_ == 0) {
+    return nullptr;
+  }
+  // Largest multiple of the capacity that keeps the distance between two positions unambiguous
+  ring_buffer->position_range_ = (UINT32_MAX / 2 / ring_buffer->capacity_) * ring_buffer->capacity_;
+
+  RAMAllocator<uint8_t> allocator(ExternalRAMAllocator<uint8_t>::ALLOW_FAILURE);
+  ring_buffer->buffer_ = allocator.allocate(ring_buffer->capacity_);
+  if (ring_buffer->buffer_ == nullptr) {
+    return nullptr;
+  }
+
+  ring_buffer->event_group_ = xEventGroupCreate();
+  if (ring_buffer->event_group_ == nullptr) {
+    return nullptr;
+  }
+
+  return ring_buffer;
+}
+
+SPMCRingBuffer::~SPMCRingBuffer() {
+  if (this->buffer_ != nullptr) {
+    RAMAllocator<uint8_t> allocator(ExternalRAMAllocator<uint8_t>::ALLOW_FAILURE);
+    allocator.deallocate(this->buffer_, this->capacity_);
+  }
+  if (this->event_group_ != nullptr) {
+    vEventGroupDelete(this->event_group_);
+  }
+}
+
+void SPMCRingBuffer::write(const void *data, size_t bytes) {
+  const uint8_t *source = reinterpret_cast<const uint8_t *>(data);
+  if (bytes > this->capacity_) {
+    // Only the newest data fits
+    source += bytes - this->capacity_;
+    bytes = this->capacity_;
+  }
+
+  const uint32_t commit_position = this->commit_position_.load(std::memory_order_relaxed);
+  const uint32_t new_commit_position = this->advance_(commit_position, bytes);
+
+  // Announce the overwritten range before touching the data, so readers copying it can detect the overwrite
+  this->reserve_position_.store(new_commit_position, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const size_t start = commit_position % this->capacity_;
+  const size_t first_span_bytes = std::min(bytes, this->capacity_ - start);
+  std::memcpy(this->buffer_ + start, source, first_span_bytes);
+  std::memcpy(this->buffer_, source + first_span_bytes, bytes - first_span_bytes);
+
+  this->commit_position_.store(new_commit_position, std::memory_order_release);
+
+  // Wake every reader that waits, or is about to. The bits stay set until each reader clears its own, so a reader that
+  // checked for data just before this write doesn't block.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const EventBits_t wake_bits = this->claimed_wake_bits_.load(std::memory_order_relaxed);
+  if (wake_bits != 0) {
+    xEventGroupSetBits(this->event_group_, wake_bits);
+  }
+}
+
+size_t SPMCRingBuffer::available(const Reader *reader) const {
+  const uint32_t commit_position = this->commit_position_.load(std::memory_order_acquire);
+  return std::min((size_t) this->distance_(commit_position, reader->position), this->capacity_);
+}
+
+size_t SPMCRingBuffer::read(Reader *reader, void *data, size_t max_bytes, TickType_t ticks_to_wait) {
+  uint8_t *destination = reinterpret_cast<uint8_t *>(data);
+  return this->read(reader, max_bytes, ticks_to_wait, [destination](const uint8_t *span, size_t bytes, size_t offset) {
+    std::memcpy(destination + offset, span, bytes);
+  });
+}
+
+void SPMCRingBuffer::wait_for_data_(Reader *reader, TickType_t ticks_to_wait) {
+  if (reader->wake_bit == 0) {
+    reader->wake_bit = this->claim_wake_bit_();
+  }
+
+  if (reader->wake_bit == 0) {
+    // Every wake bit is taken, so poll for data instead
+    const TickType_t start_ticks = xTaskGetTickCount();
+    while ((this->available(reader) == 0) && (xTaskGetTickCount() - start_ticks < ticks_to_wait)) {
+      vTaskDelay(1);
+    }
+    return;
+  }
+
+  // A write after this clear sets the bit again, so it is never missed between the check and the wait
+  xEventGroupClearBits(this->event_group_, reader->wake_bit);
+  if (this->available(reader) == 0) {
+    xEventGroupWaitBits(this->event_group_, reader->wake_bit, pdTRUE, pdFALSE, ticks_to_wait);
+  }
+}
+
+EventBits_t SPMCRingBuffer::claim_wake_bit_() {
+  EventBits_t claimed_bits = this->claimed_wake_bits_.load(std::memory_order_relaxed);
+  while (true) {
+    const EventBits_t free_bits = ~claimed_bits & ALL_WAKE_BITS;
+    if (free_bits == 0) {
+      return 0;
+    }
+    const EventBits_t bit = free_bits & (~free_bits + 1);  // Lowest free bit
+    if (this->claimed_wake_bits_.compare_exchange_weak(claimed_bits, claimed_bits | bit)) {
+      return bit;
+    }
+  }
+}
+
+void SPMCRingBuffer::skip_overwritten_(Reader *reader, uint32_t commit_position) const {
+  if (this->distance_(commit_position, reader->position) > this->capacity_) {
+    // The oldest unread data was overwritten. Skip ahead to the newer half of the buffer so the reader has a chance to
+    // catch up.
+    const size_t keep_bytes = (this->capacity_ / 2 / this->alignment_) * this->alignment_;
+    reader->position = (commit_position + this->position_range_ - keep_bytes) % this->position_range_;
+    ++reader->overruns;
+  }
+}
+
+}  // namespace audio
+}  // namespace esphome
+
+#endif
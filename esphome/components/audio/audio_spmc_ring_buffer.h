@@ -0,0 +1,154 @@
+#pragma once
+
+#ifdef USE_ESP32
+
+#include "esphome/core/defines.h"
+#include "esphome/core/helpers.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace esphome {
+namespace audio {
+
+class SPMCRingBuffer {
+  /*
+   * @brief Single producer, multiple consumer ring buffer that lets several readers consume the same audio without
+   * copying it once per reader and without taking a lock.
+   *
+   *  - Writing never blocks or fails; the oldest data is overwritten. Readers that fall more than a full buffer behind
+   *    count an overrun and skip ahead.
+   *  - Every reader keeps its own Reader cursor, so readers never consume each other's data.
+   *  - Writes start by announcing the range they are about to overwrite. Readers copy optimistically and check that
+   *    announcement afterwards; if the producer overwrote the data mid-copy, the reader counts an overrun and retries.
+   *  - Blocking reads wait on an event group bit of their own, which every write sets. A reader claims its bit on its
+   *    first blocking read and clears it before checking for data, so a write can't slip in between the check and the
+   *    wait. Readers that have data never touch a FreeRTOS lock.
+   *  - The capacity is a multiple of the alignment, so if the producer writes whole frames, no span passed to a reader
+   *    splits a frame.
+   */
+ public:
+  struct Reader {
+    uint32_t position{0};
+    uint32_t overruns{0};
+    EventBits_t wake_bit{0};  // Claimed on the first blocking read, kept for the ring buffer's lifetime
+  };
+
+  /// @brief Allocates a new ring buffer, in external memory if available.
+  /// @param capacity Number of bytes the ring buffer holds, rounded down to a multiple of `alignment`
+  /// @param alignment Every write is a multiple of this number of bytes; e.g., the number of bytes in a frame
+  /// @return unique_ptr if successfully allocated, nullptr otherwise
+  static std::unique_ptr<SPMCRingBuffer> create(size_t capacity, size_t alignment = 1);
+
+  ~SPMCRingBuffer();
+
+  /// @brief Writes data to the ring buffer, overwriting the oldest data if necessary. Only one task may write.
+  /// @param data Pointer to the data
+  /// @param bytes Number of bytes to write, should be a multiple of the alignment
+  void write(const void *data, size_t bytes);
+
+  /// @brief Positions a reader at the newest data, discarding anything it hadn't read yet.
+  void reset_reader(Reader *reader) const {
+    reader->position = this->commit_position_.load(std::memory_order_acquire);
+  }
+
+  /// @brief Returns the number of bytes the reader hasn't read yet, limited to the capacity.
+  size_t available(const Reader *reader) const;
+
+  /// @brief Copies data to the reader through a callback, waiting up to `ticks_to_wait` for data to be available.
+  /// @param reader The reader's cursor
+  /// @param max_bytes Maximum number of bytes to consume, rounded down to a multiple of the alignment
+  /// @param ticks_to_wait FreeRTOS ticks to wait for data if none is available
+  /// @param copy Callable with the signature `void(const uint8_t *span, size_t bytes, size_t offset)`. It is called for
+  ///             up to two contiguous spans, where `offset` is the number of bytes already passed in this call. If the
+  ///             producer overwrote the data while it was being copied, it is called again for the same offsets.
+  /// @return Number of bytes consumed
+  template<typename CopyFunction>
+  size_t read(Reader *reader, size_t max_bytes, TickType_t ticks_to_wait, CopyFunction &&copy) {
+    max_bytes -= max_bytes % this->alignment_;
+    if (max_bytes == 0) {
+      return 0;
+    }
+
+    if ((this->available(reader) == 0) && (ticks_to_wait > 0)) {
+      this->wait_for_data_(reader, ticks_to_wait);
+    }
+
+    while (true) {
+      const uint32_t commit_position = this->commit_position_.load(std::memory_order_acquire);
+      this->skip_overwritten_(reader, commit_position);
+
+      const size_t bytes_to_read = std::min(max_bytes, (size_t) this->distance_(commit_position, reader->position));
+      if (bytes_to_read == 0) {
+        return 0;
+      }
+
+      const size_t start = reader->position % this->capacity_;
+      const size_t first_span_bytes = std::min(bytes_to_read, this->capacity_ - start);
+      copy(this->buffer_ + start, first_span_bytes, (size_t) 0);
+      if (first_span_bytes < bytes_to_read) {
+        copy(this->buffer_, bytes_to_read - first_span_bytes, first_span_bytes);
+      }
+
+      // Verify the producer didn't start overwriting the data while it was copied
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint32_t reserve_position = this->reserve_position_.load(std::memory_order_relaxed);
+      if (this->distance_(reserve_position, reader->position) <= this->capacity_) {
+        reader->position = this->advance_(reader->position, bytes_to_read);
+        return bytes_to_read;
+      }
+      // The producer overwrote the start of the copied data. Restart at the oldest data the write in progress leaves
+      // intact, instead of spinning until the producer commits it.
+      reader->position = (reserve_position + this->position_range_ - this->capacity_) % this->position_range_;
+      ++reader->overruns;
+    }
+  }
+
+  /// @brief Copies data to a buffer, waiting up to `ticks_to_wait` for data to be available.
+  /// @return Number of bytes read
+  size_t read(Reader *reader, void *data, size_t max_bytes, TickType_t ticks_to_wait);
+
+  size_t capacity() const { return this->capacity_; }
+
+ protected:
+  static const EventBits_t ALL_WAKE_BITS = 0x00FFFFFF;  // All valid FreeRTOS event group bits
+
+  /// @brief Waits up to `ticks_to_wait` for a write, on the reader's own wake bit
+  void wait_for_data_(Reader *reader, TickType_t ticks_to_wait);
+
+  /// @brief Claims an unused wake bit
+  /// @return The claimed bit, or 0 if every bit is taken
+  EventBits_t claim_wake_bit_();
+
+  /// @brief Moves a reader that fell too far behind to the newer half of the buffer and counts an overrun
+  void skip_overwritten_(Reader *reader, uint32_t commit_position) const;
+
+  /// @brief Positions wrap at `position_range_`, which is a multiple of the capacity, so the position modulo the capacity
+  /// stays consistent when they wrap around
+  uint32_t advance_(uint32_t position, size_t bytes) const { return (position + bytes) % this->position_range_; }
+  uint32_t distance_(uint32_t newer, uint32_t older) const {
+    return (newer >= older) ? (newer - older) : (newer + this->position_range_ - older);
+  }
+
+  uint8_t *buffer_{nullptr};
+  size_t capacity_{0};
+  size_t alignment_{1};
+  uint32_t position_range_{0};
+
+  std::atomic<uint32_t> reserve_position_{0};  // End of the data currently being written
+  std::atomic<uint32_t> commit_position_{0};   // End of the data that is completely written
+  std::atomic<EventBits_t> claimed_wake_bits_{0};
+
+  EventGroupHandle_t event_group_{nullptr};
+};
+
+}  // namespace audio
+}  // namespace esphome
+
+#endif
@@ -4,6 +4,9 @@
 
 #include "esphome/core/helpers.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace esphome {
 namespace audio {
 
@@ -33,13 +36,55 @@ size_t AudioTransferBuffer::free() const {
   if (this->buffer_size_ == 0) {
     return 0;
   }
+  if (this->ring_mode_) {
+    return this->buffer_size_ - this->buffer_length_;
+  }
   return this->buffer_size_ - (this->buffer_length_ + (this->data_start_ - this->buffer_));
 }
 
+uint8_t *AudioTransferBuffer::get_buffer_end() const {
+  if (this->ring_mode_ && (this->buffer_size_ > 0)) {
+    return this->buffer_ + ((this->data_start_ - this->buffer_) + this->buffer_length_) % this->buffer_size_;
+  }
+  return this->data_start_ + this->buffer_length_;
+}
+
+uint8_t *AudioTransferBuffer::peek_read_span(size_t *bytes) const {
+  *bytes = this->buffer_length_;
+  if (this->ring_mode_) {
+    // Data past the end of the buffer continues at the start, which is returned in the next span
+    *bytes = std::min(*bytes, this->buffer_size_ - (this->data_start_ - this->buffer_));
+  }
+  return this->data_start_;
+}
+
+uint8_t *AudioTransferBuffer::acquire_write_span(size_t *bytes) const {
+  uint8_t *buffer_end = this->get_buffer_end();
+  if (!this->ring_mode_) {
+    *bytes = this->free();
+  } else if (this->buffer_length_ == this->buffer_size_) {
+    *bytes = 0;
+  } else if (buffer_end > this->data_start_) {
+    // Free space is after the data until the end of the buffer
+    *bytes = this->buffer_size_ - (buffer_end - this->buffer_);
+  } else if (buffer_end < this->data_start_) {
+    // Data wraps around, so the free space is between the end and the start of the data
+    *bytes = this->data_start_ - buffer_end;
+  } else {
+    // Empty buffer, where the data start is always reset to the buffer start
+    *bytes = this->buffer_size_;
+  }
+  return buffer_end;
+}
+
 void AudioTransferBuffer::decrease_buffer_length(size_t bytes) {
   this->buffer_length_ -= bytes;
   if (this->buffer_length_ > 0) {
-    this->data_start_ += bytes;
+    if (this->ring_mode_) {
+      this->data_start_ = this->buffer_ + ((this->data_start_ - this->buffer_) + bytes) % this->buffer_size_;
+    } else {
+      this->data_start_ += bytes;
+    }
   } else {
     // All the data in the buffer has been consumed, reset the start pointer
     this->data_start_ = this->buffer_;
@@ -50,6 +95,7 @@ void AudioTransferBuffer::increase_buffer_length(size_t bytes) { this->buffer_le
 
 void AudioTransferBuffer::clear_buffered_data() {
   this->buffer_length_ = 0;
+  this->data_start_ = this->buffer_;
   if (this->ring_buffer_.use_count() > 0) {
     this->ring_buffer_->reset();
   }
@@ -57,6 +103,7 @@ void AudioTransferBuffer::clear_buffered_data() {
 
 void AudioSinkTransferBuffer::clear_buffered_data() {
   this->buffer_length_ = 0;
+  this->data_start_ = this->buffer_;
   if (this->ring_buffer_.use_count() > 0) {
     this->ring_buffer_->reset();
   }
@@ -83,6 +130,25 @@ bool AudioTransferBuffer::reallocate(size_t new_buffer_size) {
   return this->allocate_buffer_(new_buffer_size);
 }
 
+bool AudioTransferBuffer::enable_ring_mode(size_t alignment) {
+  if (this->buffer_length_ > 0) {
+    return false;
+  }
+
+  alignment = std::max(alignment, (size_t) 1);
+  const size_t aligned_buffer_size = (this->buffer_size_ / alignment) * alignment;
+  if (aligned_buffer_size == 0) {
+    return false;
+  }
+  if ((aligned_buffer_size != this->buffer_size_) && !this->reallocate(aligned_buffer_size)) {
+    return false;
+  }
+
+  this->data_start_ = this->buffer_;
+  this->ring_mode_ = true;
+  return true;
+}
+
 bool AudioTransferBuffer::allocate_buffer_(size_t buffer_size) {
   this->buffer_size_ = buffer_size;
 
@@ -111,46 +177,75 @@ void AudioTransferBuffer::deallocate_buffer_() {
   this->buffer_length_ = 0;
 }
 
-size_t AudioSourceTransferBuffer::transfer_data_from_source(TickType_t ticks_to_wait, bool pre_shift) {
-  if (pre_shift) {
-    // Shift data in buffer to start
-    if (this->buffer_length_ > 0) {
+size_t AudioSourceTransferBuffer::transfer_data_from_source(TickType_t ticks_to_wait, bool pre_shift,
+                                                            bool force_shift) {
+  if ((pre_shift || force_shift) && !this->ring_mode_) {
+    // Shift data in buffer to start. Unless forced, only shift once the free space after the data gets small, as
+    // shifting on every call repeatedly moves the same unread data.
+    if ((this->buffer_length_ > 0) && (this->data_start_ != this->buffer_) &&
+        (force_shift || (this->free() < this->buffer_size_ / 2))) {
       memmove(this->buffer_, this->data_start_, this->buffer_length_);
+      this->bytes_copied_ += this->buffer_length_;
+      this->data_start_ = this->buffer_;
     }
-    this->data_start_ = this->buffer_;
   }
 
-  size_t bytes_to_read = this->free();
   size_t bytes_read = 0;
-  if (bytes_to_read > 0) {
-    if (this->ring_buffer_.use_count() > 0) {
-      bytes_read = this->ring_buffer_->read((void *) this->get_buffer_end(), bytes_to_read, ticks_to_wait);
+  if (this->ring_buffer_.use_count() > 0) {
+    // In ring mode, the free space may be split into two spans. Only block while reading into the first one.
+    size_t span_bytes = 0;
+    uint8_t *span = this->acquire_write_span(&span_bytes);
+    while (span_bytes > 0) {
+      const size_t span_bytes_read = this->ring_buffer_->read((void *) span, span_bytes, ticks_to_wait);
+      this->increase_buffer_length(span_bytes_read);
+      bytes_read += span_bytes_read;
+
+      if (!this->ring_mode_ || (span_bytes_read < span_bytes)) {
+        break;
+      }
+      ticks_to_wait = 0;
+      span = this->acquire_write_span(&span_bytes);
     }
-
-    this->increase_buffer_length(bytes_read);
   }
+
+  this->bytes_copied_ += bytes_read;
   return bytes_read;
 }
 
 size_t AudioSinkTransferBuffer::transfer_data_to_sink(TickType_t ticks_to_wait, bool post_shift) {
   size_t bytes_written = 0;
-  if (this->available()) {
+
+  // In ring mode, the data may be split into two spans. Only block while writing the first one.
+  size_t span_bytes = 0;
+  uint8_t *span = this->peek_read_span(&span_bytes);
+  while (span_bytes > 0) {
+    size_t span_bytes_written = 0;
 #ifdef USE_SPEAKER
     if (this->speaker_ != nullptr) {
-      bytes_written = this->speaker_->play(this->data_start_, this->available(), ticks_to_wait);
+      span_bytes_written = this->speaker_->play(span, span_bytes, ticks_to_wait);
     } else
 #endif
         if (this->ring_buffer_.use_count() > 0) {
-      bytes_written =
-          this->ring_buffer_->write_without_replacement((void *) this->data_start_, this->available(), ticks_to_wait);
+      span_bytes_written = this->ring_buffer_->write_without_replacement((void *) span, span_bytes, ticks_to_wait);
     }
 
-    this->decrease_buffer_length(bytes_written);
+    this->decrease_buffer_length(span_bytes_written);
+    bytes_written += span_bytes_written;
+
+    if (!this->ring_mode_ || (span_bytes_written < span_bytes)) {
+      break;
+    }
+    ticks_to_wait = 0;
+    span = this->peek_read_span(&span_bytes);
   }
+  this->bytes_copied_ += bytes_written;
 
-  if (post_shift) {
+  if (post_shift && !this->ring_mode_) {
     // Shift unwritten data to the start of the buffer
-    memmove(this->buffer_, this->data_start_, this->buffer_length_);
+    if ((this->buffer_length_ > 0) && (this->data_start_ != this->buffer_)) {
+      memmove(this->buffer_, this->data_start_, this->buffer_length_);
+      this->bytes_copied_ += this->buffer_length_;
+    }
     this->data_start_ = this->buffer_;
   }
 
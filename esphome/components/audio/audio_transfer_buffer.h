@@ -21,16 +21,34 @@ class AudioTransferBuffer {
    * The transfer buffer is a typical C array that temporarily holds data for processing in other audio components.
    * Both sink and source transfer buffers can use a ring buffer as the sink/source.
    *   - The ring buffer is stored in a shared_ptr, so destroying the transfer buffer object will release ownership.
+   *
+   * By default, the data in the transfer buffer is always contiguous. Unread data must occasionally be moved to the start
+   * of the buffer to make room for new data at the end. In ring mode, the read and write positions wrap around instead,
+   * so data is never moved. The stored data may then be split into two spans, so users in ring mode must use
+   * ``peek_read_span`` and ``acquire_write_span`` to access the data and commit the bytes they processed with
+   * ``decrease_buffer_length`` and ``increase_buffer_length``.
    */
  public:
   /// @brief Destructor that deallocates the transfer buffer
   ~AudioTransferBuffer();
 
-  /// @brief Returns a pointer to the start of the transfer buffer where available() bytes of exisiting data can be read
+  /// @brief Returns a pointer to the start of the transfer buffer where available() bytes of exisiting data can be read.
+  /// In ring mode, use peek_read_span instead, as the data may wrap around the end of the buffer.
   uint8_t *get_buffer_start() const { return this->data_start_; }
 
-  /// @brief Returns a pointer to the end of the transfer buffer where free() bytes of new data can be written
-  uint8_t *get_buffer_end() const { return this->data_start_ + this->buffer_length_; }
+  /// @brief Returns a pointer to the end of the transfer buffer where free() bytes of new data can be written.
+  /// In ring mode, use acquire_write_span instead, as the free space may wrap around the end of the buffer.
+  uint8_t *get_buffer_end() const;
+
+  /// @brief Returns the contiguous span of data that can be read without copying.
+  /// @param bytes Pointer to size_t that stores the span's length in bytes
+  /// @return Pointer to the start of the span. Commit the bytes read with decrease_buffer_length.
+  uint8_t *peek_read_span(size_t *bytes) const;
+
+  /// @brief Returns the contiguous span of free space that can be written without copying.
+  /// @param bytes Pointer to size_t that stores the span's length in bytes
+  /// @return Pointer to the start of the span. Commit the bytes written with increase_buffer_length.
+  uint8_t *acquire_write_span(size_t *bytes) const;
 
   /// @brief Updates the internal state of the transfer buffer. This should be called after reading data
   /// @param bytes The number of bytes consumed/read
@@ -40,6 +58,15 @@ class AudioTransferBuffer {
   /// @param bytes The number of bytes written
   void increase_buffer_length(size_t bytes);
 
+  /// @brief Switches the transfer buffer into ring mode, so data is never shifted. The buffer size is rounded down to a
+  /// multiple of `alignment` so spans never split an audio frame at the wrap around point.
+  /// @param alignment Number of bytes every span's length is a multiple of; e.g., the number of bytes in a frame
+  /// @return True if successful, false if the buffer has data or the reallocation failed
+  bool enable_ring_mode(size_t alignment);
+
+  /// @brief Returns true if the transfer buffer is in ring mode
+  bool is_ring_mode() const { return this->ring_mode_; }
+
   /// @brief Returns the transfer buffer's currently available bytes to read
   size_t available() const { return this->buffer_length_; }
 
@@ -58,6 +85,9 @@ class AudioTransferBuffer {
 
   bool reallocate(size_t new_buffer_size);
 
+  /// @brief Returns the total number of bytes copied into, out of, or within the transfer buffer
+  uint64_t get_bytes_copied() const { return this->bytes_copied_; }
+
  protected:
   /// @brief Allocates the transfer buffer in external memory, if available.
   /// @param buffer_size The number of bytes to allocate
@@ -75,6 +105,10 @@ class AudioTransferBuffer {
 
   size_t buffer_size_{0};
   size_t buffer_length_{0};
+
+  uint64_t bytes_copied_{0};
+
+  bool ring_mode_{false};
 };
 
 class AudioSinkTransferBuffer : public AudioTransferBuffer {
@@ -91,7 +125,7 @@ class AudioSinkTransferBuffer : public AudioTransferBuffer {
   /// @brief Writes any available data in the transfer buffer to the sink.
   /// @param ticks_to_wait FreeRTOS ticks to block while waiting for the sink to have enough space
   /// @param post_shift If true, all remaining data is moved to the start of the buffer after transferring to the sink.
-  ///                   Defaults to true.
+  ///                   Defaults to true. Ignored in ring mode.
   /// @return Number of bytes written
   size_t transfer_data_to_sink(TickType_t ticks_to_wait, bool post_shift = true);
 
@@ -128,10 +162,13 @@ class AudioSourceTransferBuffer : public AudioTransferBuffer {
 
   /// @brief Reads any available data from the sink into the transfer buffer.
   /// @param ticks_to_wait FreeRTOS ticks to block while waiting for the source to have enough data
-  /// @param pre_shift If true, any unwritten data is moved to the start of the buffer before transferring from the
-  ///                  source. Defaults to true.
+  /// @param pre_shift If true, any unread data is moved to the start of the buffer before transferring from the
+  ///                  source, but only if less than half of the buffer is free after the existing data. Defaults to
+  ///                  true. Ignored in ring mode.
+  /// @param force_shift If true, unread data is moved to the start of the buffer regardless of the free space, e.g.,
+  ///                    when an incomplete frame needs all of the buffer. Defaults to false. Ignored in ring mode.
   /// @return Number of bytes read
-  size_t transfer_data_from_source(TickType_t ticks_to_wait, bool pre_shift = true);
+  size_t transfer_data_from_source(TickType_t ticks_to_wait, bool pre_shift = true, bool force_shift = false);
 
   /// @brief Adds a ring buffer as the transfer buffer's source.
   /// @param ring_buffer weak_ptr to the allocated ring buffer
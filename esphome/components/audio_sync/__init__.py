@@ -0,0 +1,109 @@
+import esphome.config_validation as cv
+import esphome.codegen as cg
+
+from esphome import automation
+from esphome.automation import register_action
+from esphome.components import sensor
+from esphome.components.network import IPAddress
+from esphome.const import (
+    CONF_ID,
+    CONF_IP_ADDRESS,
+    CONF_PORT,
+    CONF_SPEAKER,
+    DEVICE_CLASS_DURATION,
+    STATE_CLASS_MEASUREMENT,
+    UNIT_MILLISECOND,
+    UNIT_PARTS_PER_MILLION,
+)
+
+from esphome.components.i2s_audio.speaker import I2SAudioSpeaker
+
+AUTO_LOAD = ["sensor"]
+DEPENDENCIES = ["esp32", "network"]
+
+CONF_CORRECTION_RATE = "correction_rate"
+CONF_MAX_CORRECTION_RATE = "max_correction_rate"
+CONF_OFFSET = "offset"
+CONF_ROUND_TRIP = "round_trip"
+CONF_START_TIME = "start_time"
+CONF_STEP_THRESHOLD = "step_threshold"
+
+audio_sync_ns = cg.esphome_ns.namespace("audio_sync")
+AudioSync = audio_sync_ns.class_("AudioSync", cg.Component)
+
+SetStartTimeAction = audio_sync_ns.class_(
+    "SetStartTimeAction", automation.Action, cg.Parented.template(AudioSync)
+)
+
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(AudioSync),
+        cv.Required(CONF_SPEAKER): cv.use_id(I2SAudioSpeaker),
+        cv.Required(CONF_IP_ADDRESS): cv.ipv4address,
+        cv.Optional(CONF_PORT, default=5140): cv.port,
+        cv.Optional(
+            CONF_STEP_THRESHOLD, default="20ms"
+        ): cv.positive_time_period_microseconds,
+        cv.Optional(CONF_MAX_CORRECTION_RATE, default=500): cv.int_range(
+            min=1, max=10000
+        ),
+        cv.Optional(CONF_OFFSET): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            accuracy_decimals=2,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_CORRECTION_RATE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PARTS_PER_MILLION,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_ROUND_TRIP): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            accuracy_decimals=2,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    spkr = await cg.get_variable(config[CONF_SPEAKER])
+    cg.add(var.set_speaker(spkr))
+    cg.add(var.set_server_ip(IPAddress(*map(int, str(config[CONF_IP_ADDRESS]).split(".")))))
+    cg.add(var.set_server_port(config[CONF_PORT]))
+    cg.add(var.set_step_threshold(config[CONF_STEP_THRESHOLD].total_microseconds))
+    cg.add(var.set_max_correction_rate(config[CONF_MAX_CORRECTION_RATE]))
+
+    if CONF_OFFSET in config:
+        sens = await sensor.new_sensor(config[CONF_OFFSET])
+        cg.add(var.set_offset_sensor(sens))
+    if CONF_CORRECTION_RATE in config:
+        sens = await sensor.new_sensor(config[CONF_CORRECTION_RATE])
+        cg.add(var.set_correction_rate_sensor(sens))
+    if CONF_ROUND_TRIP in config:
+        sens = await sensor.new_sensor(config[CONF_ROUND_TRIP])
+        cg.add(var.set_round_trip_sensor(sens))
+
+
+@register_action(
+    "audio_sync.set_start_time",
+    SetStartTimeAction,
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.use_id(AudioSync),
+            cv.Required(CONF_START_TIME): cv.templatable(cv.float_),
+        }
+    ),
+)
+async def audio_sync_set_start_time_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    template_ = await cg.templatable(config[CONF_START_TIME], args, cg.double)
+    cg.add(var.set_start_time(template_))
+    return var
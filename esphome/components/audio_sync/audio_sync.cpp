@@ -0,0 +1,279 @@
+#include "audio_sync.h"
+
+#ifdef USE_ESP32
+
+#include "esphome/components/audio/audio_resampler.h"
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+
+namespace esphome {
+namespace audio_sync {
+
+static const char *const TAG = "audio_sync";
+
+static const uint32_t SYNC_TASK_STACK_SIZE = 3072;
+static const UBaseType_t SYNC_TASK_PRIORITY = 2;
+
+// Exchanges are frequent while the clock isn't synchronized yet
+static const uint32_t SYNC_INTERVAL_MS = 1000;
+static const uint32_t INITIAL_SYNC_INTERVAL_MS = 100;
+static const uint32_t RESPONSE_TIMEOUT_MS = 200;
+
+static const uint32_t CONTROL_INTERVAL_MS = 1000;
+
+// A running resampler picks up a step within one write; if none did by then, no stream is consuming the correction
+static const uint32_t STEP_APPLY_TIMEOUT_MS = 2 * CONTROL_INTERVAL_MS;
+
+// PI controller gains; the offset is in milliseconds and the correction rate in ppm. With these gains, an offset
+// settles in about 20 seconds without overshooting much.
+static const float PROPORTIONAL_GAIN = 100.0f;
+static const float INTEGRAL_GAIN = 5.0f;
+
+static const uint32_t TIME_PACKET_MAGIC = 0x53315453;  // "S1TS"
+
+struct TimePacket {
+  /* Request and reply of the time server, little endian. The request leaves the server fields at 0; the reply echoes
+   * the request and adds the server times in microseconds since the Unix epoch.
+   */
+  uint32_t magic;
+  uint32_t sequence;
+  int64_t client_send_us;
+  int64_t server_receive_us;
+  int64_t server_send_us;
+} __attribute__((packed));
+
+void AudioSync::setup() {
+  xTaskCreate(AudioSync::sync_task, "audio_sync", SYNC_TASK_STACK_SIZE, (void *) this, SYNC_TASK_PRIORITY,
+              &this->sync_task_handle_);
+  if (this->sync_task_handle_ == nullptr) {
+    ESP_LOGE(TAG, "Failed to create the sync task");
+    this->mark_failed();
+  }
+}
+
+void AudioSync::dump_config() {
+  ESP_LOGCONFIG(TAG, "Audio Sync:");
+  ESP_LOGCONFIG(TAG, "  Time Server: %s:%u", this->server_ip_.str().c_str(), this->server_port_);
+  ESP_LOGCONFIG(TAG, "  Step Threshold: %" PRIu32 " ms", this->step_threshold_us_ / 1000);
+  ESP_LOGCONFIG(TAG, "  Max Correction Rate: %" PRId32 " ppm", this->max_correction_rate_ppm_);
+  LOG_SENSOR("  ", "Offset", this->offset_sensor_);
+  LOG_SENSOR("  ", "Correction Rate", this->correction_rate_sensor_);
+  LOG_SENSOR("  ", "Round Trip", this->round_trip_sensor_);
+}
+
+void AudioSync::loop() {
+  const uint32_t now = millis();
+  if (now - this->last_update_ms_ < CONTROL_INTERVAL_MS) {
+    return;
+  }
+  this->last_update_ms_ = now;
+
+  i2s_audio::SpeakerPlaybackPosition position;
+  if (!this->speaker_->get_playback_position(position) || (position.sample_rate == 0)) {
+    if (this->stream_active_) {
+      this->end_stream_();
+    }
+    return;
+  }
+
+  this->update_correction_(position);
+}
+
+void AudioSync::set_start_time(int64_t start_time_us) {
+  this->requested_start_us_ = start_time_us;
+  this->start_time_pending_ = true;
+}
+
+bool AudioSync::get_server_time(int64_t local_us, int64_t &server_us) const {
+  if (!this->synchronized_) {
+    return false;
+  }
+  LockGuard lock(this->clock_lock_);
+  server_us = local_us + this->clock_.offset_us;
+  return true;
+}
+
+void AudioSync::update_correction_(const i2s_audio::SpeakerPlaybackPosition &position) {
+  int64_t server_us = 0;
+  if (!this->get_server_time(position.timestamp_us, server_us)) {
+    return;
+  }
+
+  audio::AudioDriftCorrection &correction = audio::AudioDriftCorrection::get_instance();
+
+  if (!this->stream_active_) {
+    this->stream_active_ = true;
+    this->step_pending_ = false;
+    this->correction_us_ = 0;
+    this->last_position_us_ = position.timestamp_us;
+    this->rate_ppm_ = clamp<int32_t>(lroundf(this->integral_ppm_), -this->max_correction_rate_ppm_,
+                                     this->max_correction_rate_ppm_);
+    correction.set_rate_ppm(this->rate_ppm_);
+
+    const int64_t played_us = (int64_t) (position.frames_played * 1000000 / position.sample_rate);
+    if (this->start_time_pending_) {
+      this->stream_start_us_ = this->requested_start_us_;
+      this->start_time_pending_ = false;
+    } else {
+      this->stream_start_us_ = server_us - played_us;
+    }
+    ESP_LOGD(TAG, "Stream started, scheduled %" PRId64 " ms ago", (server_us - this->stream_start_us_) / 1000);
+    return;
+  }
+
+  // The rate set at the previous update was applied since then
+  this->correction_us_ += (int64_t) this->rate_ppm_ * (position.timestamp_us - this->last_position_us_) / 1000000;
+  this->last_position_us_ = position.timestamp_us;
+
+  if (this->step_pending_) {
+    if ((int32_t) (correction.get_applied_step_generation() - this->step_generation_) >= 0) {
+      this->step_pending_ = false;
+      this->correction_us_ += this->step_us_;
+    } else if (millis() - this->step_requested_ms_ < STEP_APPLY_TIMEOUT_MS) {
+      // Measuring now would step again for the offset the pending step already corrects
+      return;
+    } else {
+      ESP_LOGD(TAG, "No stream applied the step");
+      this->step_pending_ = false;
+    }
+  }
+
+  // Positive if the audio playing now should have been played earlier
+  const int64_t content_us = (int64_t) (position.frames_played * 1000000 / position.sample_rate) + this->correction_us_;
+  const int64_t offset_us = server_us - (this->stream_start_us_ + content_us);
+
+  if ((uint64_t) std::abs(offset_us) > this->step_threshold_us_) {
+    ESP_LOGD(TAG, "Offset is %" PRId64 " ms, stepping", offset_us / 1000);
+    // Booked once a resampler applied it, a step that no stream plays doesn't move the content
+    this->step_us_ = (int32_t) clamp<int64_t>(offset_us, INT32_MIN, INT32_MAX);
+    this->step_generation_ = correction.step(this->step_us_);
+    this->step_requested_ms_ = millis();
+    this->step_pending_ = true;
+  } else {
+    const float offset_ms = offset_us / 1000.0f;
+    const float max_ppm = this->max_correction_rate_ppm_;
+    this->integral_ppm_ = clamp(this->integral_ppm_ + INTEGRAL_GAIN * offset_ms * CONTROL_INTERVAL_MS / 1000.0f,
+                                -max_ppm, max_ppm);
+    this->rate_ppm_ = lroundf(clamp(PROPORTIONAL_GAIN * offset_ms + this->integral_ppm_, -max_ppm, max_ppm));
+    correction.set_rate_ppm(this->rate_ppm_);
+  }
+
+  if (this->offset_sensor_ != nullptr) {
+    this->offset_sensor_->publish_state(offset_us / 1000.0f);
+  }
+  if (this->correction_rate_sensor_ != nullptr) {
+    this->correction_rate_sensor_->publish_state(this->rate_ppm_);
+  }
+  if (this->round_trip_sensor_ != nullptr) {
+    LockGuard lock(this->clock_lock_);
+    this->round_trip_sensor_->publish_state(this->clock_.delay_us / 1000.0f);
+  }
+}
+
+void AudioSync::end_stream_() {
+  this->stream_active_ = false;
+  this->rate_ppm_ = 0;
+  audio::AudioDriftCorrection::get_instance().set_rate_ppm(0);
+  ESP_LOGD(TAG, "Stream ended after correcting %" PRId64 " ms", this->correction_us_ / 1000);
+}
+
+void AudioSync::sync_task(void *params) {
+  AudioSync *this_sync = (AudioSync *) params;
+
+  int sock = -1;
+  while (true) {
+    if (sock < 0) {
+      sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+      if (sock >= 0) {
+        struct sockaddr_in server_addr;
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(this_sync->server_port_);
+        esp_ip_addr_t esp_ip = this_sync->server_ip_;
+        server_addr.sin_addr.s_addr = esp_ip.u_addr.ip4.addr;
+
+        struct timeval timeout = {.tv_sec = 0, .tv_usec = RESPONSE_TIMEOUT_MS * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (connect(sock, (struct sockaddr *) &server_addr, sizeof(server_addr)) != 0) {
+          close(sock);
+          sock = -1;
+        }
+      }
+    }
+
+    ClockSample sample;
+    if ((sock >= 0) && this_sync->exchange_timestamps_(sock, sample)) {
+      this_sync->add_clock_sample_(sample);
+    }
+
+    const uint32_t interval_ms = this_sync->synchronized_ ? SYNC_INTERVAL_MS : INITIAL_SYNC_INTERVAL_MS;
+    vTaskDelay(pdMS_TO_TICKS(interval_ms));
+  }
+}
+
+bool AudioSync::exchange_timestamps_(int sock, ClockSample &sample) {
+  TimePacket request{};
+  request.magic = TIME_PACKET_MAGIC;
+  request.sequence = ++this->sequence_;
+  request.client_send_us = esp_timer_get_time();
+  if (send(sock, &request, sizeof(request), 0) != sizeof(request)) {
+    return false;
+  }
+
+  // Replies to earlier requests that timed out may still arrive, skip them
+  while (true) {
+    TimePacket reply;
+    const ssize_t received = recv(sock, &reply, sizeof(reply), 0);
+    const int64_t client_receive_us = esp_timer_get_time();
+    if (received < 0) {
+      return false;
+    }
+    if ((received != sizeof(reply)) || (reply.magic != TIME_PACKET_MAGIC) || (reply.sequence != request.sequence)) {
+      continue;
+    }
+
+    sample.local_us = (request.client_send_us + client_receive_us) / 2;
+    sample.offset_us = ((reply.server_receive_us - request.client_send_us) +
+                        (reply.server_send_us - client_receive_us)) /
+                       2;
+    sample.delay_us = (client_receive_us - request.client_send_us) - (reply.server_send_us - reply.server_receive_us);
+    return true;
+  }
+}
+
+void AudioSync::add_clock_sample_(const ClockSample &sample) {
+  const size_t capacity = sizeof(this->clock_samples_) / sizeof(this->clock_samples_[0]);
+
+  LockGuard lock(this->clock_lock_);
+  this->clock_samples_[this->next_clock_sample_] = sample;
+  this->next_clock_sample_ = (this->next_clock_sample_ + 1) % capacity;
+  this->clock_sample_count_ = std::min(this->clock_sample_count_ + 1, capacity);
+
+  // Only a few recent samples are kept, so the clocks don't drift apart much between the best sample and now
+  const ClockSample *best = &this->clock_samples_[0];
+  for (size_t i = 1; i < this->clock_sample_count_; ++i) {
+    if (this->clock_samples_[i].delay_us < best->delay_us) {
+      best = &this->clock_samples_[i];
+    }
+  }
+  this->clock_ = *best;
+
+  if (!this->synchronized_ && (this->clock_sample_count_ == capacity)) {
+    ESP_LOGD(TAG, "Synchronized with the time server, round trip %" PRId64 " us", this->clock_.delay_us);
+    this->synchronized_ = true;
+  }
+}
+
+}  // namespace audio_sync
+}  // namespace esphome
+
+#endif
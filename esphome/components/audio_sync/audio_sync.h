@@ -0,0 +1,142 @@
+#pragma once
+
+#ifdef USE_ESP32
+
+#include "esphome/components/i2s_audio/speaker/i2s_audio_speaker.h"
+#include "esphome/components/network/ip_address.h"
+#include "esphome/components/sensor/sensor.h"
+
+#include "esphome/core/automation.h"
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+
+namespace esphome {
+namespace audio_sync {
+
+struct ClockSample {
+  /* One timestamp exchange with the time server, NTP style.
+   *
+   *  - local_us is the esp_timer_get_time() time halfway between sending the request and receiving the reply.
+   *  - offset_us is added to a local time to get the server time.
+   *  - delay_us is the round trip time without the server's processing time. The offset error is at most half of it.
+   */
+  int64_t local_us{0};
+  int64_t offset_us{0};
+  int64_t delay_us{0};
+};
+
+class AudioSync : public Component {
+  /*
+   * @brief Keeps the I2S speaker output of several devices phase locked to the timebase of a shared time server.
+   *
+   *  - A task exchanges timestamps with the time server over UDP and uses the offset of the exchange with the lowest
+   *    round trip delay among the last few, as delayed replies are the least accurate.
+   *  - Every stream is expected to play its audio at a fixed server time: its start time plus the duration played so
+   *    far. The start time is set with set_start_time before the stream starts; otherwise the first measured position
+   *    defines it, and only the drift between the devices' clocks is corrected.
+   *  - Offsets above the step threshold are corrected at once by dropping audio or inserting silence. Smaller offsets
+   *    are slewed by a PI controller, which sets the rate at which every AudioResampler drops or repeats frames.
+   */
+ public:
+  void setup() override;
+  void loop() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::AFTER_CONNECTION; }
+
+  void set_speaker(i2s_audio::I2SAudioSpeaker *speaker) { this->speaker_ = speaker; }
+  void set_server_ip(network::IPAddress server_ip) { this->server_ip_ = server_ip; }
+  void set_server_port(uint16_t server_port) { this->server_port_ = server_port; }
+  void set_step_threshold(uint32_t step_threshold_us) { this->step_threshold_us_ = step_threshold_us; }
+  void set_max_correction_rate(int32_t max_correction_rate_ppm) {
+    this->max_correction_rate_ppm_ = max_correction_rate_ppm;
+  }
+
+  void set_offset_sensor(sensor::Sensor *offset_sensor) { this->offset_sensor_ = offset_sensor; }
+  void set_correction_rate_sensor(sensor::Sensor *correction_rate_sensor) {
+    this->correction_rate_sensor_ = correction_rate_sensor;
+  }
+  void set_round_trip_sensor(sensor::Sensor *round_trip_sensor) { this->round_trip_sensor_ = round_trip_sensor; }
+
+  /// @brief Sets when the next stream starts playing
+  /// @param start_time_us Server time in microseconds since the Unix epoch
+  void set_start_time(int64_t start_time_us);
+
+  /// @brief Converts an esp_timer_get_time() time to server time
+  /// @param local_us Local time in microseconds
+  /// @param server_us Variable to store the server time in
+  /// @return True if the clock is synchronized with the server, false otherwise
+  bool get_server_time(int64_t local_us, int64_t &server_us) const;
+
+  bool is_synchronized() const { return this->synchronized_; }
+
+ protected:
+  static void sync_task(void *params);
+
+  /// @brief Sends a request to the time server and waits for its reply
+  /// @param sock UDP socket connected to the server
+  /// @param sample ClockSample to store the measurement in
+  /// @return True if a reply was received in time, false otherwise
+  bool exchange_timestamps_(int sock, ClockSample &sample);
+
+  /// @brief Adds a measurement and selects the one with the lowest round trip delay as the current clock offset
+  void add_clock_sample_(const ClockSample &sample);
+
+  /// @brief Updates the correction from a playback position of the speaker
+  void update_correction_(const i2s_audio::SpeakerPlaybackPosition &position);
+
+  /// @brief Removes the correction once the speaker stopped
+  void end_stream_();
+
+  i2s_audio::I2SAudioSpeaker *speaker_{nullptr};
+  network::IPAddress server_ip_;
+  uint16_t server_port_{5140};
+  uint32_t step_threshold_us_{20000};
+  int32_t max_correction_rate_ppm_{500};
+
+  sensor::Sensor *offset_sensor_{nullptr};
+  sensor::Sensor *correction_rate_sensor_{nullptr};
+  sensor::Sensor *round_trip_sensor_{nullptr};
+
+  TaskHandle_t sync_task_handle_{nullptr};
+
+  // Clock synchronization, written by the sync task and read in the loop
+  mutable Mutex clock_lock_;
+  ClockSample clock_samples_[4];
+  size_t clock_sample_count_{0};
+  size_t next_clock_sample_{0};
+  ClockSample clock_;
+  std::atomic<bool> synchronized_{false};
+  uint32_t sequence_{0};
+
+  // Stream state, only used in the loop
+  bool stream_active_{false};
+  bool start_time_pending_{false};
+  int64_t requested_start_us_{0};
+  int64_t stream_start_us_{0};  // Server time the stream's first frame was, or should have been, played
+  int64_t correction_us_{0};    // Audio dropped minus audio inserted since the stream started
+  bool step_pending_{false};     // A step was requested, but no resampler reported applying it yet
+  int32_t step_us_{0};
+  uint32_t step_generation_{0};
+  uint32_t step_requested_ms_{0};
+  int64_t last_position_us_{0};
+  float integral_ppm_{0.0f};  // Kept between streams, as it mostly compensates the crystals' frequency difference
+  int32_t rate_ppm_{0};
+  uint32_t last_update_ms_{0};
+};
+
+template<typename... Ts> class SetStartTimeAction : public Action<Ts...>, public Parented<AudioSync> {
+ public:
+  TEMPLATABLE_VALUE(double, start_time)
+
+  void play(Ts... x) override { this->parent_->set_start_time((int64_t) (this->start_time_.value(x...) * 1e6)); }
+};
+
+}  // namespace audio_sync
+}  // namespace esphome
+
+#endif
@@ -36,6 +36,7 @@ CONF_PRIMARY = "primary"
 CONF_SECONDARY = "secondary"
 CONF_USE_APLL = "use_apll"
 CONF_I2S_ACCESS_MODE = "access_mode"
+CONF_USE_CHANNEL_DRIVER = "use_channel_driver"
 
 
 CONF_BITS_PER_CHANNEL = "bits_per_channel"
@@ -67,6 +68,7 @@ CONFIG_SCHEMA = cv.Schema(
         cv.Optional(CONF_I2S_BCLK_PIN): pins.internal_gpio_output_pin_number,
         cv.Optional(CONF_I2S_MCLK_PIN): pins.internal_gpio_output_pin_number,
         cv.Optional(CONF_I2S_ACCESS_MODE, default="exclusive"): cv.enum(ACCESS_MODES),
+        cv.Optional(CONF_USE_CHANNEL_DRIVER, default=False): cv.boolean,
     }
 )
 
@@ -80,6 +82,14 @@ def _final_validate(_):
         raise cv.Invalid(
             f"Only {I2S_PORTS[variant]} I2S audio ports are supported on {variant}"
         )
+    use_channel_driver = {conf[CONF_USE_CHANNEL_DRIVER] for conf in i2s_audio_configs}
+    if len(use_channel_driver) > 1:
+        # The legacy and the channel driver abort at startup if both are linked
+        raise cv.Invalid(
+            f"{CONF_USE_CHANNEL_DRIVER} must be the same for all I2S audio ports"
+        )
+    if True in use_channel_driver:
+        cv.require_framework_version(esp_idf=cv.Version(5, 0, 0))(True)
 
 
 FINAL_VALIDATE_SCHEMA = _final_validate
@@ -89,6 +99,8 @@ async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
     cg.add(var.set_access_mode(config[CONF_I2S_ACCESS_MODE]))
+    if config[CONF_USE_CHANNEL_DRIVER]:
+        cg.add_define("USE_I2S_CHANNEL_DRIVER")
     cg.add(var.set_lrclk_pin(config[CONF_I2S_LRCLK_PIN]))
     if CONF_I2S_BCLK_PIN in config:
         cg.add(var.set_bclk_pin(config[CONF_I2S_BCLK_PIN]))
@@ -230,6 +242,8 @@ async def apply_i2s_settings(var, config) -> None:
     cg.add(var.set_bits_per_sample(config[i2s.CONF_BITS_PER_SAMPLE]))
     cg.add(var.set_use_apll(config[i2s.CONF_USE_APLL]))
     cg.add(var.set_fixed_settings(config[i2s.CONF_FIXED_SETTINGS]))
+    if i2s.CONF_TDM_SLOTS in config:
+        cg.add(var.set_tdm_slots(config[i2s.CONF_TDM_SLOTS]))
 
 
 async def register_i2s_writer(writer, config: dict) -> None:
@@ -13,9 +13,6 @@ namespace i2s_audio {
 static const uint8_t I2S_NUM_MAX = SOC_I2S_NUM;  // because IDF 5+ took this away :(
 #endif
 
-static const size_t DMA_BUFFERS_COUNT = 4;
-static const size_t I2S_EVENT_QUEUE_COUNT = DMA_BUFFERS_COUNT + 1;
-
 
 void I2SAudioComponent::setup() {
   static i2s_port_t next_port_num = I2S_NUM_0;
@@ -35,6 +32,11 @@ void I2SAudioComponent::setup() {
 void I2SAudioComponent::dump_config(){
   esph_log_config(TAG, "I2SController:");
   esph_log_config(TAG, "  AccessMode: %s", this->access_mode_ == I2SAccessMode::DUPLEX ? "duplex" : "exclusive" );
+#ifdef USE_I2S_CHANNEL_DRIVER
+  esph_log_config(TAG, "  Driver: channel");
+#else
+  esph_log_config(TAG, "  Driver: legacy");
+#endif
   esph_log_config(TAG, "  Port: %d", this->get_port() );
   if( this->audio_in_ != nullptr ){
     esph_log_config(TAG, "  Reader registered.");
@@ -73,6 +75,9 @@ bool I2SAudioComponent::install_i2s_driver_(i2s_driver_config_t i2s_cfg, uint8_t
   bool success = false;
   this->lock();
   esph_log_d(TAG, "Install driver requested by %s", access == I2SAccess::RX ? "Reader" : "Writer");
+#ifdef USE_I2S_CHANNEL_DRIVER
+  success = this->install_channel_(i2s_cfg, access);
+#else
   if( this->access_state_ == I2SAccess::FREE || this->access_state_ == access ){
     if( this->driver_loaded_ ){
       ESP_LOGW(TAG,"trying to load i2s driver twice");
@@ -81,7 +86,9 @@ bool I2SAudioComponent::install_i2s_driver_(i2s_driver_config_t i2s_cfg, uint8_t
     if(this->access_mode_ == I2SAccessMode::DUPLEX){
       i2s_cfg.mode = (i2s_mode_t) (i2s_cfg.mode | I2S_MODE_TX | I2S_MODE_RX);
     }
-    success = ESP_OK == i2s_driver_install(this->get_port(), &i2s_cfg, I2S_EVENT_QUEUE_COUNT, &this->i2s_event_queue_);
+    this->tx_dma_underflow_pending_ = false;
+    this->rx_dma_overflows_ = 0;
+    success = ESP_OK == i2s_driver_install(this->get_port(), &i2s_cfg, i2s_cfg.dma_buf_count + 1, &this->i2s_event_queue_);
     esph_log_d(TAG, "Installing driver : %s", success ? "yes" : "no" );
     i2s_pin_config_t pin_config = this->get_pin_config();
     if( success ){
@@ -107,6 +114,7 @@ bool I2SAudioComponent::install_i2s_driver_(i2s_driver_config_t i2s_cfg, uint8_t
   } else {
     ESP_LOGE(TAG, "Unexpected i2s state: mode: %d access_state: %d access_request: %d", (int) this->access_mode_, (int) this->access_state_, (int) access);
   }
+#endif
   this->unlock();
   return success;
 }
@@ -114,6 +122,9 @@ bool I2SAudioComponent::install_i2s_driver_(i2s_driver_config_t i2s_cfg, uint8_t
 bool I2SAudioComponent::uninstall_i2s_driver_(uint8_t access){
   bool success = false;
   this->lock();
+#ifdef USE_I2S_CHANNEL_DRIVER
+  success = this->uninstall_channel_(access);
+#else
   // check that i2s is not occupied by others
   if( (this->access_state_ & access) == access && (this->access_state_ & ~access) == 0 ){
     i2s_zero_dma_buffer(this->get_port());
@@ -132,22 +143,297 @@ bool I2SAudioComponent::uninstall_i2s_driver_(uint8_t access){
     esph_log_d(TAG, "Other component hasn't released");
     this->access_state_ = this->access_state_ & (~access);
   }
+#endif
   this->unlock();
   return success;
 }
 
 void I2SAudioComponent::process_i2s_events(bool &tx_dma_underflow){
+  this->drain_i2s_events_();
+  if (this->tx_dma_underflow_pending_.exchange(false)) {
+    tx_dma_underflow = true;
+  }
+}
+
+uint32_t I2SAudioComponent::get_rx_dma_overflows(){
+  this->drain_i2s_events_();
+  return this->rx_dma_overflows_.load();
+}
+
+void I2SAudioComponent::drain_i2s_events_(){
+  // The channel driver has no event queue, its callbacks record the overflows right away
+#ifndef USE_I2S_CHANNEL_DRIVER
+  if( this->i2s_event_queue_ == nullptr ){
+    return;
+  }
   i2s_event_t i2s_event;
-      while (xQueueReceive(this->i2s_event_queue_, &i2s_event, 0)) {
-        if (i2s_event.type == I2S_EVENT_TX_Q_OVF) {
-          tx_dma_underflow = true;
-        }
+  while (xQueueReceive(this->i2s_event_queue_, &i2s_event, 0)) {
+    if (i2s_event.type == I2S_EVENT_TX_Q_OVF) {
+      this->tx_dma_underflow_pending_ = true;
+    } else if (i2s_event.type == I2S_EVENT_RX_Q_OVF) {
+      ++this->rx_dma_overflows_;
+    }
+  }
+#endif
+}
+
+esp_err_t I2SAudioComponent::read_(void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait){
+#ifdef USE_I2S_CHANNEL_DRIVER
+  if( this->rx_handle_ == nullptr ){
+    *bytes_read = 0;
+    return ESP_ERR_INVALID_STATE;
+  }
+  return i2s_channel_read(this->rx_handle_, dest, size, bytes_read, pdTICKS_TO_MS(ticks_to_wait));
+#else
+  return i2s_read(this->get_port(), dest, size, bytes_read, ticks_to_wait);
+#endif
+}
+
+esp_err_t I2SAudioComponent::write_(const void *src, size_t size, size_t *bytes_written, TickType_t ticks_to_wait){
+#ifdef USE_I2S_CHANNEL_DRIVER
+  if( this->tx_handle_ == nullptr ){
+    *bytes_written = 0;
+    return ESP_ERR_INVALID_STATE;
+  }
+  return i2s_channel_write(this->tx_handle_, src, size, bytes_written, pdTICKS_TO_MS(ticks_to_wait));
+#else
+  return i2s_write(this->get_port(), src, size, bytes_written, ticks_to_wait);
+#endif
+}
+
+#ifdef USE_I2S_CHANNEL_DRIVER
+
+bool IRAM_ATTR I2SAudioComponent::on_send_q_ovf_(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx){
+  ((I2SAudioComponent *) user_ctx)->tx_dma_underflow_pending_ = true;
+  return false;
+}
+
+bool IRAM_ATTR I2SAudioComponent::on_recv_q_ovf_(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx){
+  ++((I2SAudioComponent *) user_ctx)->rx_dma_overflows_;
+  return false;
+}
+
+bool I2SAudioComponent::install_channel_(const i2s_driver_config_t &i2s_cfg, uint8_t access){
+  const bool duplex = this->access_mode_ == I2SAccessMode::DUPLEX;
+  if( !this->driver_loaded_ ){
+    const i2s_role_t role = (i2s_cfg.mode & I2S_MODE_SLAVE) ? I2S_ROLE_SLAVE : I2S_ROLE_MASTER;
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(this->get_port(), role);
+    chan_cfg.dma_desc_num = i2s_cfg.dma_buf_count;
+    chan_cfg.dma_frame_num = i2s_cfg.dma_buf_len;
+    chan_cfg.auto_clear = i2s_cfg.tx_desc_auto_clear;
+
+    // In duplex mode both channels are created at once, so they share the port's clock. Each direction is then
+    // enabled and disabled on its own, without interrupting the other one.
+    i2s_chan_handle_t *tx_handle = (duplex || access == I2SAccess::TX) ? &this->tx_handle_ : nullptr;
+    i2s_chan_handle_t *rx_handle = (duplex || access == I2SAccess::RX) ? &this->rx_handle_ : nullptr;
+    esp_err_t err = i2s_new_channel(&chan_cfg, tx_handle, rx_handle);
+    if( err != ESP_OK ){
+      esph_log_e(TAG, "Creating channels failed: %s", esp_err_to_name(err));
+      return false;
+    }
+
+    i2s_event_callbacks_t callbacks = {};
+    if( this->tx_handle_ != nullptr ){
+      callbacks.on_send_q_ovf = I2SAudioComponent::on_send_q_ovf_;
+      i2s_channel_register_event_callback(this->tx_handle_, &callbacks, this);
+    }
+    if( this->rx_handle_ != nullptr ){
+      callbacks = {};
+      callbacks.on_recv_q_ovf = I2SAudioComponent::on_recv_q_ovf_;
+      i2s_channel_register_event_callback(this->rx_handle_, &callbacks, this);
+    }
+
+    this->tx_dma_underflow_pending_ = false;
+    this->rx_dma_overflows_ = 0;
+    this->installed_cfg_ = i2s_cfg;
+    this->driver_loaded_ = true;
+  } else if( duplex && (this->enabled_channels_ & ~access) ){
+    // The other direction is running, so the bus clock can't change
+    if( !this->validate_cfg_for_duplex_(i2s_cfg) ){
+      ESP_LOGE(TAG, "incompatible i2s settings for duplex mode, access_state: %d", this->access_state_);
+      return false;
+    }
+  } else {
+    // Only the DMA geometry is kept from the first installation
+    const int dma_buf_count = this->installed_cfg_.dma_buf_count;
+    const int dma_buf_len = this->installed_cfg_.dma_buf_len;
+    this->installed_cfg_ = i2s_cfg;
+    this->installed_cfg_.dma_buf_count = dma_buf_count;
+    this->installed_cfg_.dma_buf_len = dma_buf_len;
+  }
+
+  i2s_chan_handle_t handle = access == I2SAccess::TX ? this->tx_handle_ : this->rx_handle_;
+  if( handle == nullptr ){
+    ESP_LOGE(TAG, "No %s channel on this port, access_state: %d", access == I2SAccess::RX ? "RX" : "TX", this->access_state_);
+    return false;
+  }
+  if( this->enabled_channels_ & access ){
+    ESP_LOGW(TAG,"trying to enable i2s channel twice");
+    return true;
+  }
+
+  esp_err_t err = this->configure_channel_(handle, i2s_cfg, access);
+  if( err == ESP_OK ){
+    err = i2s_channel_enable(handle);
+  }
+  if( err != ESP_OK ){
+    esph_log_e(TAG, "Enabling %s channel failed: %s", access == I2SAccess::RX ? "RX" : "TX", esp_err_to_name(err));
+    return false;
+  }
+  this->enabled_channels_ |= access;
+  esph_log_d(TAG, "Enabled %s channel", access == I2SAccess::RX ? "RX" : "TX");
+  return true;
+}
+
+esp_err_t I2SAudioComponent::configure_channel_(i2s_chan_handle_t handle, const i2s_driver_config_t &i2s_cfg, uint8_t access){
+  const gpio_num_t dout = (access == I2SAccess::TX && this->audio_out_ != nullptr) ? (gpio_num_t) this->audio_out_->get_dout_pin() : I2S_GPIO_UNUSED;
+  const gpio_num_t din = (access == I2SAccess::RX && this->audio_in_ != nullptr) ? (gpio_num_t) this->audio_in_->get_din_pin() : I2S_GPIO_UNUSED;
+  const bool initialized = this->initialized_channels_ & access;
+  const i2s_data_bit_width_t data_bits = (i2s_data_bit_width_t) i2s_cfg.bits_per_sample;
+  esp_err_t err;
+
+#if SOC_I2S_SUPPORTS_TDM
+  if( i2s_cfg.channel_format == I2S_CHANNEL_FMT_MULTIPLE ){
+    // The legacy config keeps the TDM slots in the upper half of chan_mask
+    i2s_tdm_config_t tdm_cfg = {
+      .clk_cfg = I2S_TDM_CLK_DEFAULT_CONFIG(i2s_cfg.sample_rate),
+      .slot_cfg = I2S_TDM_PHILIPS_SLOT_DEFAULT_CONFIG(data_bits, I2S_SLOT_MODE_STEREO, (i2s_tdm_slot_mask_t) (i2s_cfg.chan_mask >> 16)),
+      .gpio_cfg = {
+        .mclk = (gpio_num_t) this->mclk_pin_,
+        .bclk = (gpio_num_t) this->bclk_pin_,
+        .ws = (gpio_num_t) this->lrclk_pin_,
+        .dout = dout,
+        .din = din,
+        .invert_flags = {},
+      },
+    };
+    tdm_cfg.clk_cfg.mclk_multiple = i2s_cfg.mclk_multiple;
+    if( i2s_cfg.bits_per_chan != I2S_BITS_PER_CHAN_DEFAULT ){
+      tdm_cfg.slot_cfg.slot_bit_width = (i2s_slot_bit_width_t) i2s_cfg.bits_per_chan;
+    }
+    if( !initialized ){
+      err = i2s_channel_init_tdm_mode(handle, &tdm_cfg);
+    } else {
+      err = i2s_channel_reconfig_tdm_clock(handle, &tdm_cfg.clk_cfg);
+      if( err == ESP_OK ){
+        err = i2s_channel_reconfig_tdm_slot(handle, &tdm_cfg.slot_cfg);
       }
+    }
+    if( err == ESP_OK ){
+      this->initialized_channels_ |= access;
+    }
+    return err;
+  }
+#endif
+
+  i2s_slot_mode_t slot_mode = I2S_SLOT_MODE_MONO;
+  i2s_std_slot_mask_t slot_mask = I2S_STD_SLOT_BOTH;
+  switch( i2s_cfg.channel_format ){
+    case I2S_CHANNEL_FMT_ONLY_LEFT:
+      slot_mask = I2S_STD_SLOT_LEFT;
+      break;
+    case I2S_CHANNEL_FMT_ONLY_RIGHT:
+      slot_mask = I2S_STD_SLOT_RIGHT;
+      break;
+    case I2S_CHANNEL_FMT_ALL_LEFT:
+    case I2S_CHANNEL_FMT_ALL_RIGHT:
+      // Mono data on both slots
+      break;
+    default:
+      slot_mode = I2S_SLOT_MODE_STEREO;
+      break;
+  }
+
+  i2s_std_config_t std_cfg = {
+    .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(i2s_cfg.sample_rate),
+    .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(data_bits, slot_mode),
+    .gpio_cfg = {
+      .mclk = (gpio_num_t) this->mclk_pin_,
+      .bclk = (gpio_num_t) this->bclk_pin_,
+      .ws = (gpio_num_t) this->lrclk_pin_,
+      .dout = dout,
+      .din = din,
+      .invert_flags = {},
+    },
+  };
+  std_cfg.clk_cfg.mclk_multiple = i2s_cfg.mclk_multiple;
+#if SOC_I2S_SUPPORTS_APLL
+  if( i2s_cfg.use_apll ){
+    std_cfg.clk_cfg.clk_src = I2S_CLK_SRC_APLL;
+  }
+#endif
+  std_cfg.slot_cfg.slot_mask = slot_mask;
+  if( i2s_cfg.bits_per_chan != I2S_BITS_PER_CHAN_DEFAULT ){
+    std_cfg.slot_cfg.slot_bit_width = (i2s_slot_bit_width_t) i2s_cfg.bits_per_chan;
+  }
+
+  if( !initialized ){
+    err = i2s_channel_init_std_mode(handle, &std_cfg);
+  } else {
+    // A channel is only initialized once, later installs just change its clock and slots
+    err = i2s_channel_reconfig_std_clock(handle, &std_cfg.clk_cfg);
+    if( err == ESP_OK ){
+      err = i2s_channel_reconfig_std_slot(handle, &std_cfg.slot_cfg);
+    }
+  }
+  if( err == ESP_OK ){
+    this->initialized_channels_ |= access;
+  }
+  return err;
+}
+
+bool I2SAudioComponent::uninstall_channel_(uint8_t access){
+  i2s_chan_handle_t handle = access == I2SAccess::TX ? this->tx_handle_ : this->rx_handle_;
+  if( handle != nullptr && (this->enabled_channels_ & access) ){
+    i2s_channel_disable(handle);
+    this->enabled_channels_ &= ~access;
+  }
+
+  if( (this->access_state_ & ~access) != 0 ){
+    // The other direction keeps running on its own channel
+    esph_log_d(TAG, "Other component hasn't released");
+    this->access_state_ = this->access_state_ & (~access);
+    return false;
+  }
+
+  if( this->tx_handle_ != nullptr ){
+    if( this->enabled_channels_ & I2SAccess::TX ){
+      i2s_channel_disable(this->tx_handle_);
+    }
+    i2s_del_channel(this->tx_handle_);
+    this->tx_handle_ = nullptr;
+  }
+  if( this->rx_handle_ != nullptr ){
+    if( this->enabled_channels_ & I2SAccess::RX ){
+      i2s_channel_disable(this->rx_handle_);
+    }
+    i2s_del_channel(this->rx_handle_);
+    this->rx_handle_ = nullptr;
+  }
+  this->initialized_channels_ = I2SAccess::FREE;
+  this->enabled_channels_ = I2SAccess::FREE;
+  this->access_state_ = I2SAccess::FREE;
+  this->driver_loaded_ = false;
+  return true;
 }
 
+#else
 
-bool I2SAudioComponent::validate_cfg_for_duplex_(i2s_driver_config_t& i2s_cfg){
-  i2s_driver_config_t& installed = this->installed_cfg_;
+esp_err_t I2SAudioComponent::write_expand_(const void *src, size_t size, size_t src_bits, size_t aim_bits, size_t *bytes_written,
+                                           TickType_t ticks_to_wait){
+  return i2s_write_expand(this->get_port(), src, size, src_bits, aim_bits, bytes_written, ticks_to_wait);
+}
+
+#endif
+
+
+bool I2SAudioComponent::validate_cfg_for_duplex_(const i2s_driver_config_t& i2s_cfg) const {
+  const i2s_driver_config_t& installed = this->installed_cfg_;
+  if (installed.dma_buf_count != i2s_cfg.dma_buf_count || installed.dma_buf_len != i2s_cfg.dma_buf_len) {
+    // Both directions share the DMA geometry of whoever installed the driver first
+    ESP_LOGW(TAG, "Duplex driver already installed with %d DMA buffers of %d frames, requested %d of %d",
+             installed.dma_buf_count, installed.dma_buf_len, i2s_cfg.dma_buf_count, i2s_cfg.dma_buf_len);
+  }
   return (
          installed.sample_rate == i2s_cfg.sample_rate
      &&  installed.bits_per_chan == i2s_cfg.bits_per_chan
@@ -167,6 +453,10 @@ void I2SSettings::dump_i2s_settings() const {
   esph_log_config(TAG, "  sample-rate: %d bits_per_sample: %d", this->sample_rate_, this->bits_per_sample_ );
   esph_log_config(TAG, "  channel_fmt: %d channels: %d", this->channel_fmt_, this->num_of_channels() );
   esph_log_config(TAG, "  use_apll: %s, use_pdm: %s", this->use_apll_ ? "yes": "no", this->pdm_ ? "yes": "no");
+  esph_log_config(TAG, "  dma_buf_count: %d dma_buf_len: %d", this->dma_buf_count_, this->dma_buf_len_);
+  if( this->tdm_slots_ > 0 ){
+    esph_log_config(TAG, "  tdm_slots: %d", this->tdm_slots_);
+  }
 }
 
 
@@ -184,8 +474,8 @@ i2s_driver_config_t I2SSettings::get_i2s_cfg() const {
       .channel_format = this->channel_fmt_,
       .communication_format = I2S_COMM_FORMAT_STAND_I2S,
       .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-      .dma_buf_count = DMA_BUFFERS_COUNT,
-      .dma_buf_len = 240,
+      .dma_buf_count = this->dma_buf_count_,
+      .dma_buf_len = this->dma_buf_len_,
       .use_apll = false,
       .tx_desc_auto_clear = true,
       .fixed_mclk = I2S_PIN_NO_CHANGE,
@@ -193,7 +483,7 @@ i2s_driver_config_t I2SSettings::get_i2s_cfg() const {
       .bits_per_chan = I2S_BITS_PER_CHAN_DEFAULT,
 #if SOC_I2S_SUPPORTS_TDM
       .chan_mask = I2S_CHANNEL_MONO,
-      .total_chan = 0,
+      .total_chan = this->tdm_slots_,
       .left_align = false,
       .big_edin = false,
       .bit_order_msb = false,
@@ -201,6 +491,14 @@ i2s_driver_config_t I2SSettings::get_i2s_cfg() const {
 #endif
   };
 
+#if SOC_I2S_SUPPORTS_TDM
+  if( this->tdm_slots_ > 0 ){
+    // Every slot of the frame is active, slot masks start at bit 16 (I2S_TDM_ACTIVE_CH0)
+    config.channel_format = I2S_CHANNEL_FMT_MULTIPLE;
+    config.chan_mask = (i2s_channel_t) (((1u << this->tdm_slots_) - 1) << 16);
+  }
+#endif
+
   return config;
 }
 
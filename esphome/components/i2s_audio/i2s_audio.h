@@ -3,7 +3,15 @@
 #include "esphome/core/defines.h"
 #ifdef USE_ESP32
 
+#ifdef USE_I2S_CHANNEL_DRIVER
+#include <driver/i2s_std.h>
+#include <driver/i2s_tdm.h>
+// The settings keep the legacy driver's types; they are translated to channel configurations when installing
+#include <driver/i2s_types_legacy.h>
+#else
 #include <driver/i2s.h>
+#endif
+#include <atomic>
 #include "esphome/core/component.h"
 #include "esphome/core/helpers.h"
 
@@ -26,6 +34,7 @@ class I2SAudioComponent : public Component {
   void setup() override;
   void dump_config() override;
 
+#ifndef USE_I2S_CHANNEL_DRIVER
   i2s_pin_config_t get_pin_config() const {
     return {
         .mck_io_num = this->mclk_pin_,
@@ -35,6 +44,7 @@ class I2SAudioComponent : public Component {
         .data_in_num = I2S_PIN_NO_CHANGE,
     };
   }
+#endif
 
   void set_mclk_pin(int pin) { this->mclk_pin_ = pin; }
   void set_bclk_pin(int pin) { this->bclk_pin_ = pin; }
@@ -53,6 +63,10 @@ class I2SAudioComponent : public Component {
 
   void process_i2s_events(bool &tx_dma_underflow);
 
+  /// @brief Returns how often the RX DMA buffers overflowed because they weren't read in time, since the driver was
+  /// installed
+  uint32_t get_rx_dma_overflows();
+
  protected:
   friend I2SReader;
   friend I2SWriter;
@@ -65,7 +79,32 @@ class I2SAudioComponent : public Component {
   bool release_access_(uint8_t access);
   bool install_i2s_driver_(i2s_driver_config_t i2s_cfg, uint8_t access);
   bool uninstall_i2s_driver_(uint8_t access);
-  bool validate_cfg_for_duplex_(i2s_driver_config_t& i2s_cfg);
+  bool validate_cfg_for_duplex_(const i2s_driver_config_t& i2s_cfg) const;
+  void drain_i2s_events_();
+
+  esp_err_t read_(void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait);
+  esp_err_t write_(const void *src, size_t size, size_t *bytes_written, TickType_t ticks_to_wait);
+
+#ifdef USE_I2S_CHANNEL_DRIVER
+  /// @brief Creates the channels if necessary, then initializes or reconfigures the direction's channel and enables
+  /// it. In duplex mode, both channels are created together, so they share the bus clock but are enabled and disabled
+  /// independently.
+  bool install_channel_(const i2s_driver_config_t &i2s_cfg, uint8_t access);
+  /// @brief Disables the direction's channel, and deletes both channels once neither direction uses them
+  bool uninstall_channel_(uint8_t access);
+  esp_err_t configure_channel_(i2s_chan_handle_t handle, const i2s_driver_config_t &i2s_cfg, uint8_t access);
+
+  static bool on_send_q_ovf_(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx);
+  static bool on_recv_q_ovf_(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx);
+
+  i2s_chan_handle_t tx_handle_{nullptr};
+  i2s_chan_handle_t rx_handle_{nullptr};
+  uint8_t initialized_channels_{I2SAccess::FREE};
+  uint8_t enabled_channels_{I2SAccess::FREE};
+#else
+  esp_err_t write_expand_(const void *src, size_t size, size_t src_bits, size_t aim_bits, size_t *bytes_written,
+                          TickType_t ticks_to_wait);
+#endif
 
   I2SReader *audio_in_{nullptr};
   I2SWriter *audio_out_{nullptr};
@@ -75,8 +114,12 @@ class I2SAudioComponent : public Component {
   int lrclk_pin_;
   i2s_port_t port_{};
   i2s_driver_config_t installed_cfg_{};
-  QueueHandle_t i2s_event_queue_;
+  QueueHandle_t i2s_event_queue_{nullptr};
   bool driver_loaded_{false};
+
+  // The reader and writer tasks both drain the event queue, so events are recorded until their owner asks for them
+  std::atomic<bool> tx_dma_underflow_pending_{false};
+  std::atomic<uint32_t> rx_dma_overflows_{0};
 };
 
 class I2SSettings {
@@ -93,10 +136,14 @@ public:
   void set_bits_per_sample(i2s_bits_per_sample_t bits_per_sample) { this->bits_per_sample_ = bits_per_sample; }
   void set_bits_per_channel(i2s_bits_per_chan_t bits_per_channel) { this->bits_per_channel_ = bits_per_channel; }
   void set_use_apll(uint32_t use_apll) { this->use_apll_ = use_apll; }
+  void set_dma_buf_count(int dma_buf_count) { this->dma_buf_count_ = dma_buf_count; }
+  void set_dma_buf_len(int dma_buf_len) { this->dma_buf_len_ = dma_buf_len; }
+  /// @brief Sets the number of TDM slots per frame; 0 uses the standard Philips format with the channel setting
+  void set_tdm_slots(uint8_t tdm_slots) { this->tdm_slots_ = tdm_slots; }
   
   void set_pdm(bool pdm) { this->pdm_ = pdm; }
   void set_fixed_settings(bool is_fixed){ this->is_fixed_ = is_fixed; }
-  int num_of_channels() const { return (this->channel_fmt_ == I2S_CHANNEL_FMT_ONLY_RIGHT
+  int num_of_channels() const { return this->tdm_slots_ > 0 ? this->tdm_slots_ : (this->channel_fmt_ == I2S_CHANNEL_FMT_ONLY_RIGHT
    || this->channel_fmt_ == I2S_CHANNEL_FMT_ONLY_LEFT) ? 1 : 2; }
   
 
@@ -110,6 +157,9 @@ protected:
    
    bool pdm_{false};
    uint32_t sample_rate_;
+   int dma_buf_count_{4};
+   int dma_buf_len_{240};  // Measured in frames
+   uint8_t tdm_slots_{0};
 
    bool is_fixed_{false};
    uint8_t i2s_access_;
@@ -126,7 +176,12 @@ public:
    bool claim_i2s_access(){return this->parent_->claim_access_(I2SAccess::RX);}
    bool release_i2s_access(){return this->parent_->release_access_(I2SAccess::RX);}
    bool is_adjustable(){return !this->is_fixed_ && this->parent_->is_exclusive();}
-#if SOC_I2S_SUPPORTS_ADC
+
+   /// @brief Reads straight into the caller's buffer
+   esp_err_t read_i2s_data(void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait){
+      return this->parent_->read_(dest, size, bytes_read, ticks_to_wait);}
+
+#if SOC_I2S_SUPPORTS_ADC && !defined(USE_I2S_CHANNEL_DRIVER)
   void set_adc_channel(adc1_channel_t channel) {
     this->adc_channel_ = channel;
     this->use_internal_adc_ = true;
@@ -136,7 +191,7 @@ public:
    int8_t get_din_pin() { return this->din_pin_; }
 
 protected:
-#if SOC_I2S_SUPPORTS_ADC
+#if SOC_I2S_SUPPORTS_ADC && !defined(USE_I2S_CHANNEL_DRIVER)
    adc1_channel_t adc_channel_{ADC1_CHANNEL_MAX};
    bool use_internal_adc_{false};
 #endif
@@ -155,6 +210,29 @@ public:
    bool release_i2s_access(){return this->parent_->release_access_(I2SAccess::TX);}
    bool is_adjustable(){return !this->is_fixed_ && this->parent_->is_exclusive();}
 
+   /// @brief Returns how many frames the DMA buffers of the installed driver hold. In duplex mode, the driver may have
+   /// been installed with the reader's DMA geometry.
+   uint32_t get_installed_dma_frames() const {
+      return this->parent_->installed_cfg_.dma_buf_count * this->parent_->installed_cfg_.dma_buf_len;}
+   /// @brief Returns how many frames a single DMA buffer of the installed driver holds
+   uint32_t get_installed_dma_buf_len() const { return this->parent_->installed_cfg_.dma_buf_len; }
+
+   /// @brief Returns whether the writer may keep the bus claimed while it is idle. On an exclusive bus, that would lock
+   /// out the reader.
+   bool can_hold_i2s_access() const {
+      return this->parent_->access_mode_ != I2SAccessMode::EXCLUSIVE || this->parent_->audio_in_ == nullptr;}
+
+   /// @brief Writes straight from the caller's buffer
+   esp_err_t write_i2s_data(const void *src, size_t size, size_t *bytes_written, TickType_t ticks_to_wait){
+      return this->parent_->write_(src, size, bytes_written, ticks_to_wait);}
+#ifndef USE_I2S_CHANNEL_DRIVER
+   /// @brief Writes samples with fewer bits than the bus, expanded by the driver. Not available with the channel
+   /// driver.
+   esp_err_t write_i2s_data_expanded(const void *src, size_t size, size_t src_bits, size_t aim_bits,
+                                     size_t *bytes_written, TickType_t ticks_to_wait){
+      return this->parent_->write_expand_(src, size, src_bits, aim_bits, bytes_written, ticks_to_wait);}
+#endif
+
 #if SOC_I2S_SUPPORTS_DAC
   void set_internal_dac_mode(i2s_dac_mode_t mode) { this->internal_dac_mode_ = mode; }
 #endif
@@ -8,6 +8,7 @@ CONF_BITS_PER_SAMPLE = "bits_per_sample"
 CONF_PDM = "pdm"
 CONF_USE_APLL = "use_apll"
 CONF_FIXED_SETTINGS = "fixed_settings"
+CONF_TDM_SLOTS = "tdm_slots"
 
 CONF_MONO = "mono"
 CONF_LEFT = "left"
@@ -70,6 +71,18 @@ BITS_PER_CHANNEL = {
 
 _validate_bits = cv.float_with_unit("bits", "bit")
 
+
+def _validate_tdm_slots(value):
+    # Imported here, the settings module is loaded before the esp32 component is configured
+    from esphome.components.esp32 import get_esp32_variant
+    from esphome.components.esp32.const import VARIANT_ESP32, VARIANT_ESP32S2
+
+    value = cv.int_range(min=2, max=16)(value)
+    variant = get_esp32_variant()
+    if variant in (VARIANT_ESP32, VARIANT_ESP32S2):
+        raise cv.Invalid(f"{variant} does not support TDM")
+    return value
+
 CONFIG_SCHEMA_I2S_COMMON = cv.Schema(
     {
         cv.Optional(CONF_CLK_MODE, default=INTERNAL_CLK): cv.enum(I2S_CLK_MODES),
@@ -80,6 +93,7 @@ CONFIG_SCHEMA_I2S_COMMON = cv.Schema(
         ),
         cv.Optional(CONF_USE_APLL, default=False): cv.boolean,
         cv.Optional(CONF_FIXED_SETTINGS, default=False): cv.boolean,
+        cv.Optional(CONF_TDM_SLOTS): _validate_tdm_slots,
     }
 )
 
@@ -95,5 +109,6 @@ def get_i2s_config_schema(default_channel, default_rate, default_bits):
             ),
             cv.Optional(CONF_USE_APLL, default=False): cv.boolean,
             cv.Optional(CONF_FIXED_SETTINGS, default=False): cv.boolean,
+            cv.Optional(CONF_TDM_SLOTS): _validate_tdm_slots,
         }
     )
@@ -1,5 +1,6 @@
 import esphome.config_validation as cv
 import esphome.codegen as cg
+import esphome.final_validate as fv
 
 from esphome import pins
 from esphome.const import CONF_CHANNEL, CONF_ID, CONF_MODEL, CONF_NUMBER
@@ -13,7 +14,9 @@ from .. import (
     I2SAudioComponent,
     I2SReader,
     CONF_I2S_ADC,
+    CONF_I2S_AUDIO,
     CONF_I2S_AUDIO_ID,
+    CONF_USE_CHANNEL_DRIVER,
     CONF_I2S_DIN_PIN,
     CONFIG_SCHEMA_ADC,
     register_i2s_reader,
@@ -64,6 +67,24 @@ def validate_esp32_variant(config):
     raise NotImplementedError
 
 
+def _final_validate(config):
+    i2s_audio_configs = fv.full_config.get()[CONF_I2S_AUDIO]
+    parent = next(
+        conf for conf in i2s_audio_configs if conf[CONF_ID] == config[CONF_I2S_AUDIO_ID]
+    )
+    if parent[CONF_USE_CHANNEL_DRIVER]:
+        if config[CONF_ADC_TYPE] == "internal":
+            raise cv.Invalid(
+                f"The internal ADC isn't supported with {CONF_USE_CHANNEL_DRIVER}"
+            )
+        if config[CONF_PDM]:
+            raise cv.Invalid(f"PDM isn't supported with {CONF_USE_CHANNEL_DRIVER}")
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
+
 BASE_SCHEMA = microphone.MICROPHONE_SCHEMA.extend(
     {
         cv.GenerateID(): cv.declare_id(I2SAudioMicrophone),
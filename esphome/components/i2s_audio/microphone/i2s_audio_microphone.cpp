@@ -2,7 +2,6 @@
 
 #ifdef USE_ESP32
 
-#include <driver/i2s.h>
 #include "esphome/core/hal.h"
 #include "esphome/core/log.h"
 
@@ -19,7 +18,7 @@ static const char *const TAG = "i2s_audio.microphone";
 
 void I2SAudioMicrophone::setup() {
   ESP_LOGCONFIG(TAG, "Setting up I2S Audio Microphone...");
-#if SOC_I2S_SUPPORTS_ADC
+#if SOC_I2S_SUPPORTS_ADC && !defined(USE_I2S_CHANNEL_DRIVER)
   if (this->use_internal_adc_) {
     if (this->parent_->get_port() != I2S_NUM_0) {
       ESP_LOGE(TAG, "Internal ADC only works on I2S0!");
@@ -61,7 +60,7 @@ void I2SAudioMicrophone::start_() {
 i2s_driver_config_t config = this->get_i2s_cfg();
 //config.mode = (i2s_mode_t) (I2S_MODE_MASTER | I2S_MODE_RX);
 
-#if SOC_I2S_SUPPORTS_ADC
+#if SOC_I2S_SUPPORTS_ADC && !defined(USE_I2S_CHANNEL_DRIVER)
   if (this->use_internal_adc_) {
     config.mode = (i2s_mode_t) (config.mode | I2S_MODE_ADC_BUILT_IN);
     i2s_driver_install(this->parent_->get_port(), &config, 0, nullptr);
@@ -107,7 +106,7 @@ void I2SAudioMicrophone::stop_() {
 
 size_t I2SAudioMicrophone::read(int16_t *buf, size_t len) {
   size_t bytes_read = 0;
-  esp_err_t err = i2s_read(this->parent_->get_port(), buf, len, &bytes_read, (1 / portTICK_PERIOD_MS));
+  esp_err_t err = this->read_i2s_data(buf, len, &bytes_read, (1 / portTICK_PERIOD_MS));
   if (err != ESP_OK) {
     ESP_LOGW(TAG, "Error reading from I2S microphone: %s", esp_err_to_name(err));
     this->status_set_warning();
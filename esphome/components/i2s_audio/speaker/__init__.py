@@ -32,6 +32,7 @@ I2SAudioSpeaker = i2s_audio_ns.class_(
     "I2SAudioSpeaker", cg.Component, speaker.Speaker, I2SWriter
 )
 CONF_BUFFER_DURATION = "buffer_duration"
+CONF_IDLE_HOLD = "idle_hold"
 CONF_NEVER = "never"
 i2s_dac_mode_t = cg.global_ns.enum("i2s_dac_mode_t")
 
@@ -74,6 +75,9 @@ BASE_SCHEMA = (
                 cv.positive_time_period_milliseconds,
                 cv.one_of(CONF_NEVER, lower=True),
             ),
+            cv.Optional(
+                CONF_IDLE_HOLD, default="0ms"
+            ): cv.positive_time_period_milliseconds,
         }
     )
     .extend(cv.COMPONENT_SCHEMA)
@@ -107,6 +111,9 @@ CONFIG_SCHEMA = cv.All(
                 cv.positive_time_period_milliseconds,
                 cv.one_of(CONF_NEVER, lower=True),
             ),
+            cv.Optional(
+                CONF_IDLE_HOLD, default="0ms"
+            ): cv.positive_time_period_milliseconds,
                 }
             )
             .extend(
@@ -134,3 +141,4 @@ async def to_code(config):
     if config[CONF_TIMEOUT] != CONF_NEVER:
         cg.add(var.set_timeout(config[CONF_TIMEOUT]))
     cg.add(var.set_buffer_duration(config[CONF_BUFFER_DURATION]))
+    cg.add(var.set_idle_hold(config[CONF_IDLE_HOLD]))
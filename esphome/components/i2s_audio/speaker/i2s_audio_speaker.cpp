@@ -2,14 +2,15 @@
 
 #ifdef USE_ESP32
 
-#include <driver/i2s.h>
-
 #include "esphome/components/audio/audio.h"
+#include "esphome/components/audio/audio_sample_conversion.h"
 
 #include "esphome/core/application.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/log.h"
 
+#include <esp_timer.h>
+
 namespace esphome {
 namespace i2s_audio {
 
@@ -18,6 +19,9 @@ static const size_t DMA_BUFFERS_COUNT = 4;
 
 static const size_t TASK_DELAY_MS = DMA_BUFFER_DURATION_MS * DMA_BUFFERS_COUNT / 2;
 
+// An i2s_write that took longer than this waited for a DMA descriptor to finish, so the DMA queue is full afterwards
+static const uint32_t DMA_WRITE_BLOCKED_US = 500;
+
 static const size_t TASK_STACK_SIZE = 4096;
 static const ssize_t TASK_PRIORITY = 23;
 
@@ -32,6 +36,7 @@ enum SpeakerEventGroupBits : uint32_t {
   STATE_RUNNING = (1 << 11),
   STATE_STOPPING = (1 << 12),
   STATE_STOPPED = (1 << 13),
+  STATE_IDLE = (1 << 21),  // Finished a stream, but holds the I2S driver and buffers for the next one
   ERR_TASK_FAILED_TO_START = (1 << 14),
   ERR_ESP_INVALID_STATE = (1 << 15),
   ERR_ESP_NOT_SUPPORTED = (1 << 16),
@@ -62,22 +67,6 @@ static esp_err_t err_bit_to_esp_err(uint32_t bit) {
   }
 }
 
-/// @brief Multiplies the input array of Q15 numbers by a Q15 constant factor
-///
-/// Based on `dsps_mulc_s16_ansi` from the esp-dsp library:
-/// https://github.com/espressif/esp-dsp/blob/master/modules/math/mulc/fixed/dsps_mulc_s16_ansi.c
-/// (accessed on 2024-09-30).
-/// @param input Array of Q15 numbers
-/// @param output Array of Q15 numbers
-/// @param len Length of array
-/// @param c Q15 constant factor
-static void q15_multiplication(const int16_t *input, int16_t *output, size_t len, int16_t c) {
-  for (int i = 0; i < len; i++) {
-    int32_t acc = (int32_t) input[i] * (int32_t) c;
-    output[i] = (int16_t) (acc >> 15);
-  }
-}
-
 // Lists the Q15 fixed point scaling factor for volume reduction.
 // Has 100 values representing silence and a reduction [49, 48.5, ... 0.5, 0] dB.
 // dB to PCM scaling factor formula: floating_point_scale_factor = 2^(-db/6.014)
@@ -106,6 +95,12 @@ void I2SAudioSpeaker::setup() {
 void I2SAudioSpeaker::loop() {
   uint32_t event_group_bits = xEventGroupGetBits(this->event_group_);
 
+  // Checked first, a held task may already be starting the next stream
+  if (event_group_bits & SpeakerEventGroupBits::STATE_IDLE) {
+    ESP_LOGD(TAG, "Stopped Speaker, holding the I2S driver");
+    this->state_ = speaker::STATE_STOPPED;
+    xEventGroupClearBits(this->event_group_, SpeakerEventGroupBits::STATE_IDLE);
+  }
   if (event_group_bits & SpeakerEventGroupBits::STATE_STARTING) {
     ESP_LOGD(TAG, "Starting Speaker");
     this->state_ = speaker::STATE_STARTING;
@@ -202,16 +197,19 @@ size_t I2SAudioSpeaker::play(const uint8_t *data, size_t length, TickType_t tick
     this->start();
   }
 
-  if ((this->state_ != speaker::STATE_RUNNING) || (this->audio_ring_buffer_.use_count() == 1)) {
+  if ((this->state_ != speaker::STATE_RUNNING) || !this->stream_active_ ||
+      (this->audio_ring_buffer_.use_count() == 1)) {
     // Unable to write data to a running speaker, so delay the max amount of time so it can get ready
     vTaskDelay(ticks_to_wait);
     ticks_to_wait = 0;
   }
 
   size_t bytes_written = 0;
-  if ((this->state_ == speaker::STATE_RUNNING) && (this->audio_ring_buffer_.use_count() == 1)) {
+  if ((this->state_ == speaker::STATE_RUNNING) && this->stream_active_ &&
+      (this->audio_ring_buffer_.use_count() == 1)) {
     // Only one owner of the ring buffer (the speaker task), so the ring buffer is allocated and no other components are
-    // attempting to write to it.
+    // attempting to write to it. Once the stream ended, state_ stays RUNNING until the loop sees the task stop or hold
+    // the driver, but the audio would never be played.
 
     // Temporarily share ownership of the ring buffer so it won't be deallocated while writing
     std::shared_ptr<RingBuffer> temp_ring_buffer = this->audio_ring_buffer_;
@@ -222,7 +220,8 @@ size_t I2SAudioSpeaker::play(const uint8_t *data, size_t length, TickType_t tick
   }
 
 bool I2SAudioSpeaker::has_buffered_data() const {
-  if (this->audio_ring_buffer_ != nullptr) {
+  // A held ring buffer may still hold audio from the stream that ended, it is reset when the next stream starts
+  if (this->stream_active_ && (this->audio_ring_buffer_ != nullptr)) {
     return this->audio_ring_buffer_->available() > 0;
     }
   return false;
@@ -245,34 +244,88 @@ void I2SAudioSpeaker::speaker_task(void *params) {
     this_speaker->delete_task_(0);
   }
 
-  xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::STATE_STARTING);
+  // Kept across the streams played while the task is held
+  size_t allocated_buffer_size = 0;
+  bool driver_installed = false;
 
-  audio::AudioStreamInfo audio_stream_info = this_speaker->audio_stream_info_;
+  while (true) {
+    xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::STATE_STARTING);
 
-  const uint32_t dma_buffers_duration_ms = DMA_BUFFER_DURATION_MS * DMA_BUFFERS_COUNT;
-  // Ensure ring buffer duration is at least the duration of all DMA buffers
-  const uint32_t ring_buffer_duration = std::max(dma_buffers_duration_ms, this_speaker->buffer_duration_ms_);
+    audio::AudioStreamInfo audio_stream_info = this_speaker->audio_stream_info_;
 
-  // The DMA buffers may have more bits per sample, so calculate buffer sizes based in the input audio stream info
-  const size_t data_buffer_size = audio_stream_info.ms_to_bytes(dma_buffers_duration_ms);
-  const size_t ring_buffer_size = audio_stream_info.ms_to_bytes(ring_buffer_duration);
+    const uint32_t dma_buffers_duration_ms = DMA_BUFFER_DURATION_MS * DMA_BUFFERS_COUNT;
+    // Ensure ring buffer duration is at least the duration of all DMA buffers
+    const uint32_t ring_buffer_duration = std::max(dma_buffers_duration_ms, this_speaker->buffer_duration_ms_);
 
-  const size_t single_dma_buffer_input_size = data_buffer_size / DMA_BUFFERS_COUNT;
+    // The DMA buffers may have more bits per sample, so calculate buffer sizes based in the input audio stream info
+    const size_t data_buffer_size = audio_stream_info.ms_to_bytes(dma_buffers_duration_ms);
+    const size_t ring_buffer_size = audio_stream_info.ms_to_bytes(ring_buffer_duration);
 
-  if (this_speaker->send_esp_err_to_event_group_(this_speaker->allocate_buffers_(data_buffer_size, ring_buffer_size))) {
-    // Failed to allocate buffers
-    xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::ERR_ESP_NO_MEM);
-    this_speaker->delete_task_(data_buffer_size);
-  }
+    const size_t single_dma_buffer_input_size = data_buffer_size / DMA_BUFFERS_COUNT;
+
+    if (data_buffer_size != allocated_buffer_size) {
+      // Buffers held from the previous stream are only reused if they have the same size
+      this_speaker->deallocate_buffers_(allocated_buffer_size);
+      allocated_buffer_size = data_buffer_size;
+    }
+
+    if (this_speaker->send_esp_err_to_event_group_(this_speaker->allocate_buffers_(data_buffer_size, ring_buffer_size))) {
+      // Failed to allocate buffers
+      xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::ERR_ESP_NO_MEM);
+      break;
+    }
+
+    // Like a new task, the stream starts without audio left over from the previous one
+    this_speaker->audio_ring_buffer_->reset();
+
+    // start_i2s_driver_ installs the configured bus settings whatever the stream is, so the bus rate is fixed and a
+    // held driver is reused as is. Only a slave bus has to reject a stream at another rate, like a new install does.
+    if (!driver_installed) {
+      if (this_speaker->send_esp_err_to_event_group_(this_speaker->start_i2s_driver_(audio_stream_info))) {
+        break;
+      }
+      driver_installed = true;
+    } else if ((this_speaker->i2s_clk_mode_ & I2S_MODE_SLAVE) &&
+               (this_speaker->sample_rate_ != audio_stream_info.get_sample_rate())) {  // NOLINT
+      this_speaker->send_esp_err_to_event_group_(ESP_ERR_NOT_SUPPORTED);
+      break;
+    }
 
-  if (!this_speaker->send_esp_err_to_event_group_(this_speaker->start_i2s_driver_(audio_stream_info))) {
+    this_speaker->stream_active_ = true;
     xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::STATE_RUNNING);
 
     bool stop_gracefully = false;
+    bool stream_info_changed = false;
     uint32_t last_data_received_time = millis();
     bool tx_dma_underflow = false;
 
     this_speaker->accumulated_frames_written_ = 0;
+    this_speaker->start_playback_clock_(audio_stream_info.get_sample_rate());
+
+    // Audio with fewer bits than the 32 bit slots is widened and scaled in a single pass into a staging buffer holding
+    // one DMA buffer, instead of scaling it in place and expanding it in i2s_write_expand. If the staging buffer fails
+    // to allocate, it falls back to i2s_write_expand, which the channel driver doesn't have.
+    const size_t input_bytes_per_sample = audio_stream_info.samples_to_bytes(1);
+    if ((this_speaker->bits_per_sample_ == I2S_BITS_PER_SAMPLE_32BIT) && (input_bytes_per_sample < sizeof(int32_t))) {
+      const size_t staging_samples = this_speaker->get_installed_dma_buf_len() * audio_stream_info.get_channels();
+      RAMAllocator<int32_t> allocator(RAMAllocator<int32_t>::ALLOC_INTERNAL);
+      this_speaker->staging_buffer_ = allocator.allocate(staging_samples);
+      if (this_speaker->staging_buffer_ != nullptr) {
+        this_speaker->staging_buffer_samples_ = staging_samples;
+      }
+#ifdef USE_I2S_CHANNEL_DRIVER
+      else {
+        // The channel driver can't expand samples, so the stream can't play without the staging buffer
+        xEventGroupSetBits(this_speaker->event_group_,
+                           SpeakerEventGroupBits::ERR_ESP_NO_MEM | SpeakerEventGroupBits::COMMAND_STOP);
+      }
+#endif
+    }
+
+    // With a staging buffer, each batch fills exactly one DMA buffer
+    const size_t batch_size = (this_speaker->staging_buffer_ != nullptr)
+                                  ? this_speaker->staging_buffer_samples_ * input_bytes_per_sample
+                                  : single_dma_buffer_input_size;
 
     // Keep looping if paused, there is no timeout configured, or data was received more recently than the configured
     // timeout
@@ -291,6 +344,7 @@ void I2SAudioSpeaker::speaker_task(void *params) {
 
       if (this_speaker->audio_stream_info_ != audio_stream_info) {
         // Audio stream info changed, stop the speaker task so it will restart with the proper settings.
+        stream_info_changed = true;
         break;
       }
 
@@ -308,31 +362,40 @@ void I2SAudioSpeaker::speaker_task(void *params) {
                                                                  pdMS_TO_TICKS(TASK_DELAY_MS));
       
       if ( bytes_read > 0) {
-        if ((audio_stream_info.get_bits_per_sample() == 16) && (this_speaker->q15_volume_factor_ < INT16_MAX)) {
+        if ((this_speaker->q15_volume_factor_ < INT16_MAX) && (this_speaker->staging_buffer_ == nullptr)) {
           // Scale samples by the volume factor in place
-          q15_multiplication((int16_t *) this_speaker->data_buffer_, (int16_t *) this_speaker->data_buffer_,
-                             bytes_read / sizeof(int16_t), this_speaker->q15_volume_factor_);
+          audio::scale_audio_data(this_speaker->data_buffer_, this_speaker->data_buffer_,
+                                  this_speaker->q15_volume_factor_, bytes_read,
+                                  audio_stream_info.samples_to_bytes(1));
         }
 
         // Write the audio data to a single DMA buffer at a time to reduce latency for the audio duration played
         // callback.
-        const uint32_t batches = (bytes_read + single_dma_buffer_input_size - 1) / single_dma_buffer_input_size;
+        const uint32_t batches = (bytes_read + batch_size - 1) / batch_size;
 
         for (uint32_t i = 0; i < batches; ++i) {
           size_t bytes_written = 0;
-          size_t bytes_to_write = std::min(single_dma_buffer_input_size, bytes_read);
+          size_t bytes_to_write = std::min(batch_size, bytes_read);
 
+          const int64_t write_start_us = esp_timer_get_time();
         if (audio_stream_info.get_bits_per_sample() == (uint8_t) this_speaker->bits_per_sample_) {
-            i2s_write(this_speaker->parent_->get_port(), this_speaker->data_buffer_ + i * single_dma_buffer_input_size,
-                      bytes_to_write, &bytes_written, pdMS_TO_TICKS(DMA_BUFFER_DURATION_MS * 5));
-        } else if (audio_stream_info.get_bits_per_sample() < (uint8_t) this_speaker->bits_per_sample_) {
-            i2s_write_expand(this_speaker->parent_->get_port(),
-                             this_speaker->data_buffer_ + i * single_dma_buffer_input_size, bytes_to_write,
-                           audio_stream_info.get_bits_per_sample(), this_speaker->bits_per_sample_, &bytes_written,
-                             pdMS_TO_TICKS(DMA_BUFFER_DURATION_MS * 5));
+            this_speaker->write_i2s_data(this_speaker->data_buffer_ + i * batch_size, bytes_to_write, &bytes_written,
+                                         pdMS_TO_TICKS(DMA_BUFFER_DURATION_MS * 5));
+        } else if (this_speaker->staging_buffer_ != nullptr) {
+            bytes_written = this_speaker->write_staged_(this_speaker->data_buffer_ + i * batch_size, bytes_to_write,
+                                                        input_bytes_per_sample,
+                                                        pdMS_TO_TICKS(DMA_BUFFER_DURATION_MS * 5));
         }
+#ifndef USE_I2S_CHANNEL_DRIVER
+          else if (audio_stream_info.get_bits_per_sample() < (uint8_t) this_speaker->bits_per_sample_) {
+            this_speaker->write_i2s_data_expanded(this_speaker->data_buffer_ + i * batch_size, bytes_to_write,
+                                                  audio_stream_info.get_bits_per_sample(),
+                                                  this_speaker->bits_per_sample_, &bytes_written,
+                                                  pdMS_TO_TICKS(DMA_BUFFER_DURATION_MS * 5));
+        }
+#endif
 
-          uint32_t write_timestamp = micros();
+          const int64_t write_end_us = esp_timer_get_time();
 
           if (bytes_written != bytes_to_write) {
           xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::ERR_ESP_INVALID_SIZE);
@@ -348,9 +411,15 @@ void I2SAudioSpeaker::speaker_task(void *params) {
 
           uint32_t pending_frames =
               audio_stream_info.bytes_to_frames(bytes_read + this_speaker->audio_ring_buffer_->available());
+
+          // Report when the written audio is actually heard, rather than when the write returned. micros() is the
+          // esp_timer time truncated to 32 bits.
+          const int64_t presentation_us = this_speaker->advance_playback_clock_(
+              audio_stream_info.bytes_to_frames(bytes_written), pending_frames, write_start_us, write_end_us);
+
           const uint32_t pending_ms = audio_stream_info.frames_to_milliseconds_with_remainder(&pending_frames);
 
-          this_speaker->audio_output_callback_(new_playback_ms, remainder_us, pending_ms, write_timestamp);
+          this_speaker->audio_output_callback_(new_playback_ms, remainder_us, pending_ms, (uint32_t) presentation_us);
 
         tx_dma_underflow = false;
         last_data_received_time = millis();
@@ -363,13 +432,126 @@ void I2SAudioSpeaker::speaker_task(void *params) {
       }
     }
 
-    xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::STATE_STOPPING);
+    // Refuse further writes, the ring buffer is left alone until the next stream starts
+    this_speaker->stream_active_ = false;
+
+    const bool hold = (this_speaker->idle_hold_ms_ > 0) && this_speaker->can_hold_i2s_access();
+    if (!hold) {
+      xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::STATE_STOPPING);
+    }
+
+    {
+      LockGuard lock(this_speaker->clock_lock_);
+      this_speaker->clock_running_ = false;
+    }
+
+    if (this_speaker->staging_buffer_ != nullptr) {
+      RAMAllocator<int32_t> allocator(RAMAllocator<int32_t>::ALLOC_INTERNAL);
+      allocator.deallocate(this_speaker->staging_buffer_, this_speaker->staging_buffer_samples_);
+      this_speaker->staging_buffer_ = nullptr;
+      this_speaker->staging_buffer_samples_ = 0;
+    }
 
+    if (!hold) {
+      break;
+    }
+
+    if (stream_info_changed) {
+      // Continue right away with the new stream's settings. A stop sent while this stream ended doesn't apply to the
+      // new one, which play() is already waiting to write to.
+      xEventGroupClearBits(this_speaker->event_group_,
+                           SpeakerEventGroupBits::COMMAND_STOP | SpeakerEventGroupBits::COMMAND_STOP_GRACEFULLY);
+      continue;
+    }
+
+    // The DMA descriptors are cleared once played, so the held driver keeps clocking out silence until the next
+    // stream starts. A start command sent while this stream was playing must not start the next one.
+    xEventGroupClearBits(this_speaker->event_group_, SpeakerEventGroupBits::COMMAND_START);
+    this_speaker->held_ = true;
+    xEventGroupSetBits(this_speaker->event_group_, SpeakerEventGroupBits::STATE_IDLE);
+    event_group_bits = xEventGroupWaitBits(this_speaker->event_group_, SpeakerEventGroupBits::COMMAND_START,
+                                           pdTRUE,   // Clear the bits on exit
+                                           pdFALSE,  // Don't wait for all the bits
+                                           pdMS_TO_TICKS(this_speaker->idle_hold_ms_));
+    if (!(event_group_bits & SpeakerEventGroupBits::COMMAND_START)) {
+      if (this_speaker->held_.exchange(false)) {
+        break;
+      }
+      // start() claimed the hold just as it expired, its COMMAND_START is about to be set
+      xEventGroupWaitBits(this_speaker->event_group_, SpeakerEventGroupBits::COMMAND_START, pdTRUE, pdFALSE,
+                          portMAX_DELAY);
+    }
+    // Stop commands sent while the previous stream was ending don't apply to the new one
+    xEventGroupClearBits(this_speaker->event_group_,
+                         SpeakerEventGroupBits::COMMAND_STOP | SpeakerEventGroupBits::COMMAND_STOP_GRACEFULLY);
+  }
+
+  if (driver_installed) {
     this_speaker->uninstall_i2s_driver();
     this_speaker->release_i2s_access();
   }
-  
-  this_speaker->delete_task_(data_buffer_size);
+
+  this_speaker->delete_task_(allocated_buffer_size);
+}
+
+size_t I2SAudioSpeaker::write_staged_(const uint8_t *data, size_t length, size_t input_bytes_per_sample,
+                                      TickType_t ticks_to_wait) {
+  const size_t samples = std::min(length / input_bytes_per_sample, this->staging_buffer_samples_);
+  audio::convert_audio_samples_to_q31_scaled(data, input_bytes_per_sample, this->staging_buffer_,
+                                             this->q15_volume_factor_, samples);
+
+  size_t bytes_written = 0;
+  this->write_i2s_data(this->staging_buffer_, samples * sizeof(int32_t), &bytes_written, ticks_to_wait);
+  return bytes_written / sizeof(int32_t) * input_bytes_per_sample;
+}
+
+void I2SAudioSpeaker::start_playback_clock_(uint32_t sample_rate) {
+  LockGuard lock(this->clock_lock_);
+  this->clock_running_ = true;
+  this->clock_sample_rate_ = sample_rate;
+  this->clock_dma_frames_ = this->get_installed_dma_frames();
+  this->clock_buffered_frames_ = 0;
+  this->clock_frames_written_ = 0;
+  this->clock_presentation_end_us_ = esp_timer_get_time();
+}
+
+int64_t I2SAudioSpeaker::advance_playback_clock_(uint32_t frames, uint32_t buffered_frames, int64_t write_start_us,
+                                                 int64_t write_end_us) {
+  LockGuard lock(this->clock_lock_);
+  const int64_t dma_duration_us = (int64_t) this->clock_dma_frames_ * 1000000 / this->clock_sample_rate_;
+
+  if (write_end_us - write_start_us >= DMA_WRITE_BLOCKED_US) {
+    // The write waited for a descriptor to finish, so the DMA queue is full and the descriptor that just finished
+    // holds the last written frames. This corrects any drift between the estimate and the I2S clock.
+    this->clock_presentation_end_us_ = write_end_us + dma_duration_us;
+  } else {
+    // If the DMA queue ran empty, it played silence and the new frames start now. The queue can't hold more than its
+    // capacity.
+    const int64_t duration_us = (int64_t) frames * 1000000 / this->clock_sample_rate_;
+    const int64_t end_us = std::max(this->clock_presentation_end_us_, write_end_us) + duration_us;
+    this->clock_presentation_end_us_ = std::min(end_us, write_end_us + dma_duration_us);
+  }
+
+  this->clock_frames_written_ += frames;
+  this->clock_buffered_frames_ = buffered_frames;
+  return this->clock_presentation_end_us_;
+}
+
+bool I2SAudioSpeaker::get_playback_position(SpeakerPlaybackPosition &position) const {
+  LockGuard lock(this->clock_lock_);
+  if (!this->clock_running_) {
+    return false;
+  }
+
+  position.timestamp_us = esp_timer_get_time();
+  position.sample_rate = this->clock_sample_rate_;
+  const int64_t dma_pending_us = std::max(this->clock_presentation_end_us_ - position.timestamp_us, (int64_t) 0);
+  position.dma_pending_frames = std::min<uint64_t>(dma_pending_us * this->clock_sample_rate_ / 1000000,
+                                                   this->clock_frames_written_);
+  position.frames_played = this->clock_frames_written_ - position.dma_pending_frames;
+  position.output_latency_us =
+      dma_pending_us + (uint64_t) this->clock_buffered_frames_ * 1000000 / this->clock_sample_rate_;
+  return true;
 }
 
 void I2SAudioSpeaker::start() {
@@ -387,6 +569,10 @@ void I2SAudioSpeaker::start() {
   } else {
     xEventGroupSetBits(this->event_group_, SpeakerEventGroupBits::ERR_TASK_FAILED_TO_START);
     }
+  } else if (this->held_.exchange(false)) {
+    // Wakes up the task holding the driver. Only a held task is woken, a task that is still starting or finishing a
+    // stream would otherwise keep the bit and start an empty stream once it's held.
+    xEventGroupSetBits(this->event_group_, SpeakerEventGroupBits::COMMAND_START);
   }
 }
 
@@ -475,14 +661,18 @@ esp_err_t I2SAudioSpeaker::start_i2s_driver_(audio::AudioStreamInfo &audio_strea
   return ESP_OK;
 }
 
-void I2SAudioSpeaker::delete_task_(size_t buffer_size) {
+void I2SAudioSpeaker::deallocate_buffers_(size_t data_buffer_size) {
   this->audio_ring_buffer_.reset();  // Releases ownership of the shared_ptr
 
   if (this->data_buffer_ != nullptr) {
     ExternalRAMAllocator<uint8_t> allocator(ExternalRAMAllocator<uint8_t>::ALLOW_FAILURE);
-    allocator.deallocate(this->data_buffer_, buffer_size);
+    allocator.deallocate(this->data_buffer_, data_buffer_size);
     this->data_buffer_ = nullptr;
   }
+}
+
+void I2SAudioSpeaker::delete_task_(size_t buffer_size) {
+  this->deallocate_buffers_(buffer_size);
 
   xEventGroupSetBits(this->event_group_, SpeakerEventGroupBits::STATE_STOPPED);
 
@@ -4,7 +4,7 @@
 
 #include "../i2s_audio.h"
 
-#include <driver/i2s.h>
+#include <atomic>
 
 #include <freertos/event_groups.h>
 #include <freertos/queue.h>
@@ -21,6 +21,24 @@
 namespace esphome {
 namespace i2s_audio {
 
+struct SpeakerPlaybackPosition {
+  /* Position of the speaker's playback clock.
+   *
+   *  - frames_played counts the frames that left the I2S bus since the speaker task started. Frames written but still
+   *    queued in the DMA descriptors aren't included.
+   *  - dma_pending_frames were written to the DMA descriptors, but haven't been played yet.
+   *  - output_latency_us is how long it takes until audio passed to play() now is heard: the DMA queue plus the ring
+   *    buffer.
+   *  - timestamp_us is the esp_timer_get_time() time the position refers to.
+   *  - sample_rate is the rate the frames are played at.
+   */
+  uint64_t frames_played{0};
+  uint32_t dma_pending_frames{0};
+  uint32_t output_latency_us{0};
+  int64_t timestamp_us{0};
+  uint32_t sample_rate{0};
+};
+
 class I2SAudioSpeaker : public I2SWriter, public speaker::Speaker, public Component {
  public:
   float get_setup_priority() const override { return esphome::setup_priority::PROCESSOR; }
@@ -31,6 +49,9 @@ class I2SAudioSpeaker : public I2SWriter, public speaker::Speaker, public Compon
 
   void set_buffer_duration(uint32_t buffer_duration_ms) { this->buffer_duration_ms_ = buffer_duration_ms; }
   void set_timeout(uint32_t ms) { this->timeout_ = ms; }
+  /// @brief Sets how long the speaker task keeps the I2S driver, its buffers and itself alive after a stream ends, so
+  /// the next stream starts without reinstalling them. 0 tears everything down right away.
+  void set_idle_hold(uint32_t idle_hold_ms) { this->idle_hold_ms_ = idle_hold_ms; }
 
   void start() override;
   void stop() override;
@@ -62,14 +83,43 @@ class I2SAudioSpeaker : public I2SWriter, public speaker::Speaker, public Compon
   /// @param mute_state true for muting, false for unmuting
   void set_mute_state(bool mute_state) override;
 
+  /// @brief Returns the playback position at the current time, accounting for the frames still queued in the DMA
+  /// descriptors. Can be called from any task.
+  /// @param position SpeakerPlaybackPosition to store the position in
+  /// @return True if the speaker task is playing, false otherwise
+  bool get_playback_position(SpeakerPlaybackPosition &position) const;
+
  protected:
+  /// @brief Restarts the playback clock when the speaker task starts writing to a freshly installed driver
+  void start_playback_clock_(uint32_t sample_rate);
+
+  /// @brief Advances the playback clock after frames were written to the DMA descriptors.
+  /// @param frames Number of frames written
+  /// @param buffered_frames Frames still waiting in the ring buffer and data buffer
+  /// @param write_start_us esp_timer time before the write
+  /// @param write_end_us esp_timer time after the write returned
+  /// @return esp_timer time when the last written frame leaves the I2S bus
+  int64_t advance_playback_clock_(uint32_t frames, uint32_t buffered_frames, int64_t write_start_us,
+                                  int64_t write_end_us);
+
+  /// @brief Widens and scales samples into the staging buffer and writes them to the I2S bus with a single i2s_write.
+  /// The staging buffer holds one DMA buffer, so each call fills at most one DMA buffer.
+  /// @param data Audio samples with fewer than 32 bits per sample
+  /// @param length Number of bytes of audio
+  /// @param input_bytes_per_sample Bytes per input sample
+  /// @param ticks_to_wait FreeRTOS ticks to wait for a free DMA buffer
+  /// @return Number of input bytes written
+  size_t write_staged_(const uint8_t *data, size_t length, size_t input_bytes_per_sample, TickType_t ticks_to_wait);
+
   /// @brief Function for the FreeRTOS task handling audio output.
   /// After receiving the COMMAND_START signal, allocates space for the buffers, starts the I2S driver, and reads
   /// audio from the ring buffer and writes audio to the I2S port. Stops immmiately after receiving the COMMAND_STOP
   /// signal and stops only after the ring buffer is empty after receiving the COMMAND_STOP_GRACEFULLY signal. Stops if
-  /// the ring buffer hasn't read data for more than timeout_ milliseconds. When stopping, it deallocates the buffers,
-  /// stops the I2S driver, unlocks the I2S port, and deletes the task. It communicates the state and any errors via
-  /// event_group_.
+  /// the ring buffer hasn't read data for more than timeout_ milliseconds. With an idle hold, a stopped stream leaves
+  /// the task waiting for the next COMMAND_START signal for up to idle_hold_ms_, with the I2S driver and buffers kept.
+  /// The bus runs at the configured sample rate, so the held driver is reused for every stream. When stopping, it
+  /// deallocates the buffers, stops the I2S driver, unlocks the I2S port, and deletes the task. It communicates the
+  /// state and any errors via event_group_.
   /// @param params I2SAudioSpeaker component
   static void speaker_task(void *params);
 
@@ -89,6 +139,10 @@ class I2SAudioSpeaker : public I2SWriter, public speaker::Speaker, public Compon
   ///         ESP_OK if successful
   esp_err_t allocate_buffers_(size_t data_buffer_size, size_t ring_buffer_size);
 
+  /// @brief Deallocates the data buffer and releases the ring buffer
+  /// @param data_buffer_size The allocated size of the data_buffer_.
+  void deallocate_buffers_(size_t data_buffer_size);
+
   /// @brief Starts the ESP32 I2S driver.
   /// Attempts to lock the I2S port, starts the I2S driver using the passed in stream information, and sets the data out
   /// pin. If it fails, it will unlock the I2S port and uninstall the driver, if necessary.
@@ -111,12 +165,22 @@ class I2SAudioSpeaker : public I2SWriter, public speaker::Speaker, public Compon
 
   QueueHandle_t i2s_event_queue_;
 
-  uint8_t *data_buffer_;
+  uint8_t *data_buffer_{nullptr};
+
+  // Holds one DMA buffer of 32 bit samples, if the audio is widened by the speaker task instead of i2s_write_expand
+  int32_t *staging_buffer_{nullptr};
+  size_t staging_buffer_samples_{0};
   std::shared_ptr<RingBuffer> audio_ring_buffer_;
 
   uint32_t buffer_duration_ms_;
 
   optional<uint32_t> timeout_;
+  uint32_t idle_hold_ms_{0};
+  // Set by the speaker task while it waits with the driver held, cleared by whichever of start() or the expiring hold
+  // claims it first
+  std::atomic<bool> held_{false};
+  // Set by the speaker task while a stream is playing. play() only writes to the ring buffer while it is set.
+  std::atomic<bool> stream_active_{false};
 
 
   bool task_created_{false};
@@ -126,6 +190,15 @@ class I2SAudioSpeaker : public I2SWriter, public speaker::Speaker, public Compon
   
   size_t bytes_written_{0};
   uint32_t accumulated_frames_written_{0};
+
+  // Playback clock, updated by the speaker task and read by get_playback_position
+  mutable Mutex clock_lock_;
+  bool clock_running_{false};
+  uint32_t clock_sample_rate_{0};
+  uint32_t clock_dma_frames_{0};
+  uint32_t clock_buffered_frames_{0};
+  uint64_t clock_frames_written_{0};
+  int64_t clock_presentation_end_us_{0};  // When the last written frame leaves the I2S bus
 };
 
 }  // namespace i2s_audio
@@ -2,6 +2,7 @@ import hashlib
 import logging
 from pathlib import Path
 import re
+import zlib
 
 import esphome.codegen as cg
 import esphome.config_validation as cv
@@ -45,8 +46,10 @@ CONF_MD5 = "md5"
 CONF_MD5_FILE = "md5_file"
 CONF_MD5_URL = "md5_url"
 CONF_IMAGE_FILE = "image_file"
+CONF_SECTOR_MANIFEST_URL = "sector_manifest_url"
 
 CONF_EMBED_FLASH_IMAGE = "embed_flash_image"
+CONF_COMPRESS = "compress"
 CONF_FLASH_IMAGE_VERSION = "image_version"
 CONF_FLASHER_ID = "flasher_id"
 
@@ -212,6 +215,8 @@ def _validate_embed_image_schema(image_config:dict) -> dict:
     img_local_path = _resolve_local_file(image_file_conf)
     if not _check_image_md5_sum(img_local_path, md5_sum):
         raise cv.Invalid( f"Flash-Image: md5 sum does not match.")
+    if image_config[CONF_COMPRESS] and not CORE.is_esp32:
+        raise cv.Invalid( f"Flash-Image: compressed images are only supported on the ESP32.")
     
     return image_config
 
@@ -238,6 +243,7 @@ EMBED_FLASH_IMAGE_SCHEMA = cv.All(
         {
             cv.Required(CONF_IMAGE_FILE): _file_schema,
             cv.Optional(CONF_MD5_FILE): _file_schema,
+            cv.Optional(CONF_COMPRESS, default=False): cv.boolean,
             cv.GenerateID(CONF_RAW_DATA_ID): cv.declare_id(cg.uint8),
         }
     ),
@@ -272,11 +278,22 @@ FLASHER_CONFIG_SCHEMA = cv.Schema(
 
 
 def _prepare_flash_image_pgm(flash_config: dict) -> tuple[str, tuple[str], int]:
+    """
+    Reads the image to embed, zlib compressing it if configured. Returns the expected MD5 sum,
+    the bytes to store in the firmware and the uncompressed image size.
+    """
     local_flash_image = _resolve_local_file(flash_config[CONF_IMAGE_FILE])    
     md5_sum = _get_expected_md5(flash_config)
     with open( local_flash_image, "rb" ) as f:
-        hex_strings = tuple(map(HexInt, f.read()))
-    return md5_sum, hex_strings, len(hex_strings)
+        image = f.read()
+    if flash_config[CONF_COMPRESS]:
+        compressed = zlib.compress(image, 9)
+        _LOGGER.info(
+            "Compressed embedded flash image from %d to %d bytes (%.1f%%)",
+            len(image), len(compressed), 100. * len(compressed) / len(image)
+        )
+        return md5_sum, tuple(map(HexInt, compressed)), len(image)
+    return md5_sum, tuple(map(HexInt, image)), len(image)
 
 
 
@@ -304,9 +321,11 @@ async def register_memory_flasher(var, flasher_config):
     await cg.register_component(var, flasher_config)
 
     if image_conf := flasher_config.get(CONF_EMBED_FLASH_IMAGE):
-        expected_md5_sum, hex_strings, num_of_bytes = _prepare_flash_image_pgm(image_conf)
+        expected_md5_sum, hex_strings, image_size = _prepare_flash_image_pgm(image_conf)
         prog_arr = cg.progmem_array(image_conf[CONF_RAW_DATA_ID], hex_strings)
-        cg.add( var.set_embedded_image(prog_arr, num_of_bytes, expected_md5_sum, _version_to_bytes(image_conf[CONF_FLASH_IMAGE_VERSION])) )
+        cg.add( var.set_embedded_image(prog_arr, len(hex_strings), expected_md5_sum, _version_to_bytes(image_conf[CONF_FLASH_IMAGE_VERSION])) )
+        if image_conf[CONF_COMPRESS]:
+            cg.add( var.set_embedded_image_compressed(image_size) )
 
     for conf in flasher_config.get(CONF_ON_FLASHING_START, []):
         trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var )
@@ -331,7 +350,8 @@ async def register_memory_flasher(var, flasher_config):
 FLASH_ACTION_SCHEMA = cv.All(
     FLASH_IMAGE_SCHEMA.extend(
         {
-            cv.GenerateID(CONF_FLASHER_ID): cv.use_id(MemoryFlasher)    
+            cv.GenerateID(CONF_FLASHER_ID): cv.use_id(MemoryFlasher),
+            cv.Optional(CONF_SECTOR_MANIFEST_URL): cv.templatable(cv.url),
         }
     )
 )
@@ -357,6 +377,10 @@ async def flash_image_action_to_code(config, action_id, template_arg, args):
     template_ = await cg.templatable(config[CONF_IMAGE_FILE], args, cg.std_string)
     cg.add(var.set_url(template_))
 
+    if manifest_url := config.get(CONF_SECTOR_MANIFEST_URL):
+        template_ = await cg.templatable(manifest_url, args, cg.std_string)
+        cg.add(var.set_sector_manifest_url(template_))
+
     return var
 
 
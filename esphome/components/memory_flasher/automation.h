@@ -13,6 +13,7 @@ class FlashAction : public Action<Ts...> {
   TEMPLATABLE_VALUE(std::string, md5_url)
   TEMPLATABLE_VALUE(std::string, md5)
   TEMPLATABLE_VALUE(std::string, url)
+  TEMPLATABLE_VALUE(std::string, sector_manifest_url)
 
   void play(Ts... x) override {
     if (this->md5_url_.has_value()) {
@@ -22,6 +23,8 @@ class FlashAction : public Action<Ts...> {
       this->parent_->set_md5(this->md5_.value(x...));
     }
     this->parent_->set_url(this->url_.value(x...));
+    this->parent_->set_sector_manifest_url(
+        this->sector_manifest_url_.has_value() ? this->sector_manifest_url_.value(x...) : std::string());
 
     this->parent_->flash_remote_image();
   }
@@ -61,16 +64,16 @@ class FlashingStartedTrigger : public Trigger<>{
 public:
   explicit FlashingStartedTrigger(MemoryFlasher *xflash) {
     xflash->add_on_state_callback([this, xflash]() {
-      if(  xflash->state == FLASHER_ERASING && this->last_reported_ != FLASHER_ERASING ){
-        this->last_reported_ = FLASHER_ERASING;
+      // Image flashes may go straight to FLASHER_FLASHING, erasing sector by sector while flashing
+      const bool active = xflash->state == FLASHER_ERASING || xflash->state == FLASHER_FLASHING;
+      if( active && !this->last_active_ ){
         this->trigger();
-      } else {
-        this->last_reported_ = xflash->state;  
       }
+      this->last_active_ = active;
     });
   }
 protected:
-  FlasherState last_reported_{FLASHER_IDLE};
+  bool last_active_{false};
 };
 
 class ErasingDoneTrigger : public Trigger<>{
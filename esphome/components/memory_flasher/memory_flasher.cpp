@@ -1,5 +1,6 @@
 #include "memory_flasher.h"
 
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 #include "esphome/components/md5/md5.h"
 
@@ -8,6 +9,18 @@ namespace memory_flasher {
 
 static const char *const TAG = "memory_flasher";
 
+// Gives up skipping if the image source doesn't deliver any data for this long
+static const uint32_t SKIP_STALL_TIMEOUT_MS = 10000;
+// Shorter skips are read and discarded, which is cheaper than a new request
+static const size_t RANGE_REQUEST_MIN_SKIP = 64 * 1024;
+static const int HTTP_STATUS_PARTIAL_CONTENT = 206;
+
+// Reconnects if the image download doesn't deliver any data for this long
+static const uint32_t RESUME_STALL_TIMEOUT_MS = 4000;
+// Reconnect attempts without receiving data in between before giving up
+static const uint8_t MAX_RESUME_ATTEMPTS = 5;
+static const uint32_t RESUME_BACKOFF_MS = 500;
+
 
 void MemoryFlasher::dump_config(){
     if( this->has_image_embedded()){
@@ -76,6 +89,36 @@ void MemoryFlasher::set_md5_url(const std::string &url) {
   this->md5_expected_.clear();  // to be retrieved later
 }
 
+FlashImageReader *MemoryFlasher::create_embedded_image_reader_(){
+#ifdef USE_ESP32
+  if( this->embedded_image_.uncompressed_length > 0 ){
+    return new InflatingImageReader(this->embedded_image_);
+  }
+#endif
+  return new EmbeddedImageReader(this->embedded_image_);
+}
+
+bool FlashImageReader::skip_image_bytes(size_t bytes){
+  uint8_t discard[256];
+  uint32_t last_data_received = millis();
+  while( bytes > 0 ){
+    int bytes_read = this->read_image_block(discard, std::min(bytes, sizeof(discard)));
+    if( bytes_read < 0 ){
+      return false;
+    }
+    if( bytes_read == 0 ){
+      if( (millis() - last_data_received) > SKIP_STALL_TIMEOUT_MS ){
+        return false;
+      }
+      delay(1);
+      continue;
+    }
+    last_data_received = millis();
+    bytes -= bytes_read;
+  }
+  return true;
+}
+
 bool HttpImageReader::init_reader(){
   auto url_with_auth = this->url_;
     if (url_with_auth.empty() || this->http_request_ == nullptr) {
@@ -85,28 +128,201 @@ bool HttpImageReader::init_reader(){
     ESP_LOGVV(TAG, "url_with_auth: %s", url_with_auth.c_str());
     ESP_LOGI(TAG, "Connecting to: %s", this->url_.c_str());
     
-    this->container_ = this->http_request_->get(url_with_auth);
-    if (this->container_ == nullptr) {
+    this->resume_attempts_ = 0;
+    this->resumes_ = 0;
+    if( !this->connect_from_(0) ){
       return false;
     }
+    this->image_size_ = this->container_->content_length;
     return true;
 }
 
 bool HttpImageReader::deinit_reader(){
     if( this->container_ != nullptr ){
       this->container_->end();
+      this->container_ = nullptr;
+    }
+    if( this->resumes_ > 0 ){
+      ESP_LOGD(TAG, "Resumed the download %u times", (unsigned) this->resumes_);
+    }
+    return true;
+}
+
+
+bool HttpImageReader::connect_from_(size_t pos){
+    if( this->container_ != nullptr ){
+      this->container_->end();
+      this->container_ = nullptr;
+    }
+    
+    if( pos == 0 ){
+      this->container_ = this->http_request_->get(this->url_);
+    } else {
+      const std::string range = "bytes=" + to_string(pos) + "-";
+      std::list<http_request::Header> headers = {{"Range", range.c_str()}};
+      this->container_ = this->http_request_->get(this->url_, headers);
+    }
+    if (this->container_ == nullptr) {
+      return false;
+    }
+    
+    this->read_pos_ = 0;
+    this->last_data_received_ = millis();
+    if( pos > 0 && this->container_->status_code != HTTP_STATUS_PARTIAL_CONTENT ){
+      // The server sends the whole image again, so discard everything up to the position
+      ESP_LOGW(TAG, "Server ignored the range request, discarding %u bytes", pos);
+      if( !FlashImageReader::skip_image_bytes(pos) ){
+        if( this->container_ != nullptr ){
+          this->container_->end();
+          this->container_ = nullptr;
+        }
+        return false;
+      }
+      return true;
+    }
+    this->read_pos_ = pos;
+    return true;
+}
+
+
+bool HttpImageReader::resume_(){
+    if( this->image_size_ == 0 || this->resume_attempts_ >= MAX_RESUME_ATTEMPTS ){
+      return false;
+    }
+    this->resume_attempts_++;
+    this->resumes_++;
+    ESP_LOGW(TAG, "Download interrupted at %u of %u bytes, resuming (attempt %u of %u)", this->read_pos_,
+             this->image_size_, this->resume_attempts_, MAX_RESUME_ATTEMPTS);
+    delay(RESUME_BACKOFF_MS * this->resume_attempts_);
+    
+    // A failed connection leaves no container, which the next read takes as another drop
+    const size_t resume_pos = this->read_pos_;
+    if( !this->connect_from_(resume_pos) ){
+      this->read_pos_ = resume_pos;
+      this->last_data_received_ = millis();
     }
     return true;
 }
 
 
 int HttpImageReader::read_image_block(uint8_t *buffer, size_t block_size){
-    int bytes_read = this->container_->read(buffer, block_size);
-    ESP_LOGVV(TAG, "bytes_read_ = %u, body_length_ = %u, bufsize = %i", container->get_bytes_read(),
-              container->content_length, bytes_read);
-    return bytes_read;
+    bool resumed = false;
+    while( true ){
+      int bytes_read = -1;
+      if( this->container_ != nullptr ){
+        bytes_read = this->container_->read(buffer, block_size);
+        ESP_LOGVV(TAG, "bytes_read_ = %u, body_length_ = %u, bufsize = %i", this->container_->get_bytes_read(),
+                  this->container_->content_length, bytes_read);
+      }
+      if( bytes_read > 0 ){
+        this->read_pos_ += bytes_read;
+        this->last_data_received_ = millis();
+        this->resume_attempts_ = 0;
+        return bytes_read;
+      }
+      if( this->read_pos_ >= this->image_size_ ){
+        return bytes_read;
+      }
+      
+      // The response ending before the image did counts as a dropped connection too
+      const bool dropped = bytes_read < 0 || this->container_->get_bytes_read() >= this->container_->content_length;
+      const bool stalled = (millis() - this->last_data_received_) > RESUME_STALL_TIMEOUT_MS;
+      if( dropped || stalled ){
+        if( !this->resume_() ){
+          return -1;
+        }
+        resumed = true;
+        continue;
+      }
+      if( !resumed ){
+        return 0;
+      }
+      // Waits for the first data after resuming here, so the caller's own stall timeout doesn't count the reconnect
+      delay(1);
+    }
 } 
 
+bool HttpImageReader::skip_image_bytes(size_t bytes){
+    if( bytes < RANGE_REQUEST_MIN_SKIP ){
+      return FlashImageReader::skip_image_bytes(bytes);
+    }
+    
+    if( !this->connect_from_(this->read_pos_ + bytes) ){
+      return false;
+    }
+    ESP_LOGD(TAG, "Skipped %u bytes with a range request", bytes);
+    return true;
+}
+
+
+#ifdef USE_ESP32
+bool InflatingImageReader::init_reader(){
+  RAMAllocator<uint8_t> allocator;
+  this->decompressor_ = (tinfl_decompressor *) allocator.allocate(sizeof(tinfl_decompressor));
+  this->window_ = allocator.allocate(TINFL_LZ_DICT_SIZE);
+  if( this->decompressor_ == nullptr || this->window_ == nullptr ){
+    ESP_LOGE(TAG, "Couldn't allocate the decompression buffers");
+    this->deinit_reader();
+    return false;
+  }
+  tinfl_init(this->decompressor_);
+  this->input_pos_ = 0;
+  this->window_pos_ = 0;
+  this->pending_pos_ = 0;
+  this->pending_length_ = 0;
+  this->finished_ = false;
+  return true;
+}
+
+bool InflatingImageReader::deinit_reader(){
+  RAMAllocator<uint8_t> allocator;
+  if( this->decompressor_ != nullptr ){
+    allocator.deallocate((uint8_t *) this->decompressor_, sizeof(tinfl_decompressor));
+    this->decompressor_ = nullptr;
+  }
+  if( this->window_ != nullptr ){
+    allocator.deallocate(this->window_, TINFL_LZ_DICT_SIZE);
+    this->window_ = nullptr;
+  }
+  return true;
+}
+
+int InflatingImageReader::read_image_block(uint8_t *buffer, size_t block_size){
+  size_t copied = 0;
+  while( copied < block_size ){
+    if( this->pending_length_ > 0 ){
+      const size_t to_copy = std::min(this->pending_length_, block_size - copied);
+      memcpy(buffer + copied, this->window_ + this->pending_pos_, to_copy);
+      this->pending_pos_ += to_copy;
+      this->pending_length_ -= to_copy;
+      copied += to_copy;
+      continue;
+    }
+    if( this->finished_ ){
+      break;
+    }
+
+    // The whole stream is in memory, so tinfl only stops once the window wraps around or the stream ends
+    size_t input_length = this->image_.length - this->input_pos_;
+    size_t output_length = TINFL_LZ_DICT_SIZE - this->window_pos_;
+    tinfl_status status = tinfl_decompress(this->decompressor_, this->image_.data + this->input_pos_, &input_length,
+                                           this->window_, this->window_ + this->window_pos_, &output_length,
+                                           TINFL_FLAG_PARSE_ZLIB_HEADER);
+    this->input_pos_ += input_length;
+    this->pending_pos_ = this->window_pos_;
+    this->pending_length_ = output_length;
+    this->window_pos_ = (this->window_pos_ + output_length) & (TINFL_LZ_DICT_SIZE - 1);
+
+    if( status == TINFL_STATUS_DONE ){
+      this->finished_ = true;
+    } else if( status != TINFL_STATUS_HAS_MORE_OUTPUT ){
+      ESP_LOGE(TAG, "Decompressing the embedded image failed (%d)", (int) status);
+      return -1;
+    }
+  }
+  return copied;
+}
+#endif
 
 }
-}
\ No newline at end of file
+}
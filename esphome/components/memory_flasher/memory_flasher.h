@@ -2,6 +2,12 @@
 
 #include "esphome/components/http_request/http_request.h"
 
+#ifdef USE_ESP32
+#include "rom/miniz.h"
+#endif
+
+#include <algorithm>
+
 namespace esphome {
 namespace memory_flasher {
 
@@ -32,6 +38,7 @@ struct FlashImage {
   size_t length{0};
   std::string md5;
   ImageVersion version;
+  size_t uncompressed_length{0};  // non-zero if `data` holds the image as a zlib stream
 };
 
 class FlashImageReader {
@@ -42,6 +49,10 @@ public:
   
   virtual size_t get_image_size() = 0;
   virtual int read_image_block(uint8_t *buffer, size_t bock_size) = 0; 
+  
+  /// @brief Skips the next `bytes` bytes of the image. The default reads and discards them.
+  /// @return false if the image source failed or stalled
+  virtual bool skip_image_bytes(size_t bytes);
 };
 
 
@@ -51,18 +62,30 @@ public:
   bool init_reader() override;
   bool deinit_reader() override;
 
-  size_t get_image_size() override {
-    if (this->container_ == nullptr ){
-      return 0;
-    }
-    return this->container_->content_length;
-  }
+  size_t get_image_size() override { return this->image_size_; }
+  
+  /// @brief Reads the next bytes of the image. If the connection drops or stalls, it reconnects and
+  /// continues right after the last byte returned, so the caller never sees the interruption.
   int read_image_block(uint8_t *buffer, size_t block_size) override;
   
+  /// @brief Skips long runs with a new request for the rest of the image, starting at the first byte
+  /// after the skipped ones. Falls back to discarding the data if the server ignores the range.
+  bool skip_image_bytes(size_t bytes) override;
+  
 protected:
+  /// @brief Opens a new request for the image starting at `pos`, using a range request if `pos` > 0
+  bool connect_from_(size_t pos);
+  /// @brief Reconnects after a dropped connection, returns false once the attempts are used up
+  bool resume_();
+  
   http_request::HttpRequestComponent* http_request_{nullptr};
   std::shared_ptr<esphome::http_request::HttpContainer> container_{nullptr};
   std::string url_{};
+  size_t image_size_{0};  // size of the whole image, kept when a range request returns only its tail
+  size_t read_pos_{0};
+  uint32_t last_data_received_{0};
+  uint8_t resume_attempts_{0};  // reconnects since data was last received
+  uint32_t resumes_{0};
 };
 
 
@@ -78,6 +101,11 @@ public:
     this->read_pos_ += to_read;
     return to_read;
   }
+  
+  bool skip_image_bytes(size_t bytes) override {
+    this->read_pos_ = std::min(this->read_pos_ + bytes, this->image_.length);
+    return true;
+  }
 
 protected:
   FlashImage image_;
@@ -85,6 +113,33 @@ protected:
 };
 
 
+#ifdef USE_ESP32
+class InflatingImageReader : public FlashImageReader {
+  /*
+   * @brief Reads an embedded image stored as a zlib stream, decompressing it with the ROM's tinfl while reading. Only
+   * the compressed bytes are read from the firmware partition; the decompressed data passes through a 32 KB window,
+   * which deflate needs to resolve back references.
+   */
+public:
+  InflatingImageReader(FlashImage img) : image_(img) {}
+  bool init_reader() override;
+  bool deinit_reader() override;
+  size_t get_image_size() override { return this->image_.uncompressed_length; }
+  int read_image_block(uint8_t *buffer, size_t block_size) override;
+
+protected:
+  FlashImage image_;
+  tinfl_decompressor *decompressor_{nullptr};
+  uint8_t *window_{nullptr};
+  size_t input_pos_{0};
+  size_t window_pos_{0};      // where the next decompressed bytes are written to the window
+  size_t pending_pos_{0};     // decompressed bytes in the window that weren't returned yet
+  size_t pending_length_{0};
+  bool finished_{false};
+};
+#endif
+
+
 enum FlasherAction : uint8_t {
   ACTION_FULL_ERASE,
   ACTION_FLASH_REMOTE_IMAGE,
@@ -148,6 +203,11 @@ public:
     this->embedded_image_.md5 = expected_md5;    
     memcpy(this->embedded_image_.version.bytes, version_bytes, 5);
   }
+  
+  /// @brief Marks the embedded image as a zlib stream that decompresses to `uncompressed_length` bytes
+  void set_embedded_image_compressed(size_t uncompressed_length) {
+    this->embedded_image_.uncompressed_length = uncompressed_length;
+  }
     
   void set_http_request_component(http_request::HttpRequestComponent* http_request ){
     this->http_request_ = http_request;
@@ -157,6 +217,13 @@ public:
   void set_md5(const std::string &md5) { this->md5_expected_ = md5; }
   void set_url(const std::string &url);
   
+  /// @brief Sets the URL of a sector hash manifest for the next remote image. Flashers that support it only download
+  /// and program sectors whose hash differs from the flash contents. An empty URL flashes without a manifest.
+  void set_sector_manifest_url(const std::string &url) { this->sector_manifest_url_ = url; }
+  
+  /// @brief Compares every sector with the flash contents and skips erasing and programming unchanged ones
+  void set_skip_unchanged_sectors(bool skip) { this->skip_unchanged_sectors_ = skip; }
+  
   void add_on_state_callback(std::function<void()> &&callback) {
     this->state_callback_.add(std::move(callback));
   }
@@ -170,6 +237,8 @@ protected:
 
   /* flashing embedded image*/
   FlashImage embedded_image_;
+  /// @brief Creates the reader matching how the image is embedded; the caller owns it
+  FlashImageReader *create_embedded_image_reader_();
   
   /* flashing remote image */
   bool http_get_md5_();
@@ -184,6 +253,8 @@ protected:
   std::string password_{};
   std::string username_{};
   std::string url_{};
+  std::string sector_manifest_url_{};
+  bool skip_unchanged_sectors_{false};
 };
 
 
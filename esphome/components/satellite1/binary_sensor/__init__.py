@@ -0,0 +1,44 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome import pins
+from esphome.components import binary_sensor
+
+from esphome.const import CONF_PIN
+
+from ..satellite1 import (
+    namespace as sat1_ns,
+    CONF_SATELLITE1
+)
+
+
+CODEOWNERS = ["@gnumpi"]
+DEPENDENCIES = ["satellite1"]
+
+Satellite1BinarySensor = sat1_ns.class_(
+    "Satellite1BinarySensor", binary_sensor.BinarySensor, cg.Component
+)
+
+
+def _validate_satellite1_pin(value):
+    if CONF_SATELLITE1 not in value:
+        raise cv.Invalid("Only pins of the satellite1 component are supported, use the gpio platform instead")
+    return value
+
+
+CONFIG_SCHEMA = (
+    binary_sensor.binary_sensor_schema(Satellite1BinarySensor)
+    .extend(
+        {
+            cv.Required(CONF_PIN): cv.All(pins.gpio_input_pin_schema, _validate_satellite1_pin),
+        }
+    )
+    .extend(cv.COMPONENT_SCHEMA)
+)
+
+
+async def to_code(config):
+    var = await binary_sensor.new_binary_sensor(config)
+    await cg.register_component(var, config)
+
+    pin = await cg.gpio_pin_expression(config[CONF_PIN])
+    cg.add(var.set_pin(pin))
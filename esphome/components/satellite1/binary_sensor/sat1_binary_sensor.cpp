@@ -0,0 +1,33 @@
+#include "sat1_binary_sensor.h"
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace satellite1 {
+
+static const char *const TAG = "Satellite1-BinarySensor";
+
+void Satellite1BinarySensor::setup(){
+  if( this->has_status_irq_() ){
+    // The first state is reported once the XMOS connected
+    this->pin_->add_on_state_callback([this](bool state){
+      this->publish_state(state);
+    });
+  } else {
+    this->publish_initial_state( this->pin_->digital_read() );
+  }
+}
+
+void Satellite1BinarySensor::loop(){
+  if( !this->has_status_irq_() ){
+    this->publish_state( this->pin_->digital_read() );
+  }
+}
+
+void Satellite1BinarySensor::dump_config(){
+  LOG_BINARY_SENSOR("", "Satellite1 Binary Sensor", this);
+  esph_log_config(TAG, "  Updated by: %s", this->has_status_irq_() ? "XMOS IRQ" : "polling");
+}
+
+}
+}
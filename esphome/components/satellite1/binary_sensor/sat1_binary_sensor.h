@@ -0,0 +1,29 @@
+#pragma once
+
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#include "esphome/core/component.h"
+
+#include "../sat_gpio.h"
+
+namespace esphome {
+namespace satellite1 {
+
+/// @brief Binary sensor for an XMOS input pin. With the XMOS IRQ pin it is updated by the pin's state
+/// callback, so reading it costs no SPI transfers; without it, the pin is polled like a GPIO binary sensor.
+class Satellite1BinarySensor : public binary_sensor::BinarySensor, public Component {
+public:
+    void setup() override;
+    void loop() override;
+    void dump_config() override;
+    float get_setup_priority() const override { return setup_priority::HARDWARE; }
+
+    void set_pin(Satellite1GPIOPin *pin) { this->pin_ = pin; }
+
+ protected:
+    bool has_status_irq_() const { return this->pin_->get_parent()->has_status_irq(); }
+
+    Satellite1GPIOPin *pin_;
+};
+
+}
+}
@@ -38,7 +38,8 @@ void LEDRing::write_state(light::LightState *state){
   if (this->is_failed()){
     return;  
   }
-  this->parent_->transfer(LED_RES_ID, CMD_WRITE_LED_RING_RAW, this->buf_, this->buffer_size_);
+  // Only the newest frame matters, so a frame that is still queued is replaced instead of sent late
+  this->parent_->queue_transfer(LED_RES_ID, CMD_WRITE_LED_RING_RAW, this->buf_, this->buffer_size_, nullptr, true);
 }
 
 
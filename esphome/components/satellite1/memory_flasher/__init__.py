@@ -1,6 +1,6 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.const import CONF_ID
+from esphome.const import CONF_DATA_RATE, CONF_ID
 
 from esphome.components.memory_flasher import (
     FLASHER_CONFIG_SCHEMA,
@@ -15,14 +15,63 @@ CODEOWNERS = ["@gnumpi"]
 DEPENDENCIES = ["satellite1", "memory_flasher"]
 
 XMOSFlasher = sat.namespace.class_("XMOSFlasher", MemoryFlasher, sat.Satellite1SPIService, cg.Component )
+SPINorSimulator = sat.namespace.class_("SPINorSimulator")
+FlashVerifyMode = sat.namespace.enum("FlashVerifyMode")
 
+VERIFY_MODES = {
+    "SECTOR": FlashVerifyMode.VERIFY_SECTOR_CRC,
+    "PAGE": FlashVerifyMode.VERIFY_PAGE_COMPARE,
+}
+
+CONF_SKIP_UNCHANGED_SECTORS = "skip_unchanged_sectors"
+CONF_VERIFY = "verify"
+
+CONF_SIMULATE_FLASH = "simulate_flash"
+CONF_CAPACITY = "capacity"
+CONF_PAGE_PROGRAM_TIME = "page_program_time"
+CONF_SECTOR_ERASE_TIME = "sector_erase_time"
+CONF_BLOCK_32K_ERASE_TIME = "block_32k_erase_time"
+CONF_BLOCK_64K_ERASE_TIME = "block_64k_erase_time"
+CONF_CHIP_ERASE_TIME = "chip_erase_time"
+CONF_SIMULATE_BUS_TIME = "simulate_bus_time"
+CONF_PROGRAM_BIT_FLIP_RATE = "program_bit_flip_rate"
+CONF_READ_BIT_FLIP_RATE = "read_bit_flip_rate"
+
+# JEDEC capacity IDs are log2 of the size in bytes
+FLASH_CAPACITY_IDS = {
+    "1MB": 20,
+    "2MB": 21,
+    "4MB": 22,
+    "8MB": 23,
+    "16MB": 24,
+}
+
+# Defaults are the typical timings of common 3.3 V NOR flashes
+SIMULATE_FLASH_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(SPINorSimulator),
+        cv.Optional(CONF_CAPACITY, default="8MB"): cv.one_of(*FLASH_CAPACITY_IDS, upper=True),
+        cv.Optional(CONF_PAGE_PROGRAM_TIME, default="700us"): cv.positive_time_period_microseconds,
+        cv.Optional(CONF_SECTOR_ERASE_TIME, default="45ms"): cv.positive_time_period_microseconds,
+        cv.Optional(CONF_BLOCK_32K_ERASE_TIME, default="120ms"): cv.positive_time_period_microseconds,
+        cv.Optional(CONF_BLOCK_64K_ERASE_TIME, default="150ms"): cv.positive_time_period_microseconds,
+        cv.Optional(CONF_CHIP_ERASE_TIME, default="20s"): cv.positive_time_period_microseconds,
+        cv.Optional(CONF_DATA_RATE, default="8MHz"): cv.frequency,
+        cv.Optional(CONF_SIMULATE_BUS_TIME, default=True): cv.boolean,
+        cv.Optional(CONF_PROGRAM_BIT_FLIP_RATE, default=0): cv.percentage,
+        cv.Optional(CONF_READ_BIT_FLIP_RATE, default=0): cv.percentage,
+    }
+)
 
 
 CONFIG_SCHEMA = FLASHER_CONFIG_SCHEMA.extend(
     cv.Schema(
         {
           cv.GenerateID(): cv.declare_id(XMOSFlasher),
-          cv.GenerateID(sat.CONF_SATELLITE1): cv.use_id(sat.Satellite1)
+          cv.GenerateID(sat.CONF_SATELLITE1): cv.use_id(sat.Satellite1),
+          cv.Optional(CONF_SKIP_UNCHANGED_SECTORS, default=False): cv.boolean,
+          cv.Optional(CONF_VERIFY, default="SECTOR"): cv.enum(VERIFY_MODES, upper=True),
+          cv.Optional(CONF_SIMULATE_FLASH): SIMULATE_FLASH_SCHEMA,
         }
     )
 )
@@ -33,5 +82,22 @@ async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await register_memory_flasher(var, config)
     await cg.register_parented(var, config[sat.CONF_SATELLITE1])
+    cg.add(var.set_skip_unchanged_sectors(config[CONF_SKIP_UNCHANGED_SECTORS]))
+    cg.add(var.set_verify_mode(config[CONF_VERIFY]))
+
+    if sim_config := config.get(CONF_SIMULATE_FLASH):
+        cg.add_define("USE_XMOS_FLASH_SIMULATOR")
+        sim = cg.new_Pvariable(sim_config[CONF_ID])
+        cg.add(sim.set_capacity_id(FLASH_CAPACITY_IDS[sim_config[CONF_CAPACITY]]))
+        cg.add(sim.set_page_program_time(sim_config[CONF_PAGE_PROGRAM_TIME].total_microseconds))
+        cg.add(sim.set_sector_erase_time(sim_config[CONF_SECTOR_ERASE_TIME].total_microseconds))
+        cg.add(sim.set_block_32k_erase_time(sim_config[CONF_BLOCK_32K_ERASE_TIME].total_microseconds))
+        cg.add(sim.set_block_64k_erase_time(sim_config[CONF_BLOCK_64K_ERASE_TIME].total_microseconds))
+        cg.add(sim.set_chip_erase_time(sim_config[CONF_CHIP_ERASE_TIME].total_microseconds))
+        cg.add(sim.set_data_rate(int(sim_config[CONF_DATA_RATE])))
+        cg.add(sim.set_simulate_bus_time(sim_config[CONF_SIMULATE_BUS_TIME]))
+        cg.add(sim.set_program_bit_flip_rate(sim_config[CONF_PROGRAM_BIT_FLIP_RATE]))
+        cg.add(sim.set_read_bit_flip_rate(sim_config[CONF_READ_BIT_FLIP_RATE]))
+        cg.add(var.set_flash_simulator(sim))
     return var
 
@@ -0,0 +1,302 @@
+#include "spi_nor_simulator.h"
+
+#ifdef USE_XMOS_FLASH_SIMULATOR
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+#include <cinttypes>
+#include <cstring>
+
+namespace esphome {
+namespace satellite1 {
+
+static const char *const TAG = "spi_nor_simulator";
+
+static const size_t PAGE_SIZE = 256;
+static const size_t SECTOR_SIZE = 4096;
+
+static const uint8_t CMD_PAGE_PROGRAM = 0x02;
+static const uint8_t CMD_READ = 0x03;
+static const uint8_t CMD_WRITE_DISABLE = 0x04;
+static const uint8_t CMD_READ_STATUS = 0x05;
+static const uint8_t CMD_WRITE_ENABLE = 0x06;
+static const uint8_t CMD_FAST_READ = 0x0B;
+static const uint8_t CMD_SECTOR_ERASE = 0x20;
+static const uint8_t CMD_BLOCK_32K_ERASE = 0x52;
+static const uint8_t CMD_CHIP_ERASE = 0x60;
+static const uint8_t CMD_JEDEC_ID = 0x9F;
+static const uint8_t CMD_CHIP_ERASE_ALT = 0xC7;
+static const uint8_t CMD_BLOCK_64K_ERASE = 0xD8;
+
+static const uint8_t STATUS_BUSY = 0x01;
+static const uint8_t STATUS_WEL = 0x02;
+
+static const size_t ADDRESS_BYTES = 3;
+
+bool SPINorSimulator::init(){
+  if( this->sectors_.empty() ){
+    this->sectors_.assign(this->capacity_() / SECTOR_SIZE, nullptr);
+  }
+  ESP_LOGD(TAG, "Simulating a %" PRIu32 " byte flash", this->capacity_());
+  return true;
+}
+
+void SPINorSimulator::log_counters() const {
+  const SPINorSimulatorCounters &counters = this->counters_;
+  ESP_LOGD(TAG, "  %" PRIu32 " transactions, %" PRIu32 " kB over SPI, %" PRIu32 " ms bus time",
+           counters.transactions, (uint32_t) (counters.spi_bytes / 1024), (uint32_t) (counters.bus_us / 1000));
+  ESP_LOGD(TAG, "  %" PRIu32 " page programs, %" PRIu32 " erases, %" PRIu32 " status reads",
+           counters.page_programs, counters.erases, counters.status_reads);
+  ESP_LOGD(TAG, "  %" PRIu32 " rejected commands, %" PRIu32 " injected faults", counters.rejected_commands,
+           counters.injected_faults);
+}
+
+bool SPINorSimulator::is_busy_() const {
+  return (micros() - this->busy_since_) < this->busy_duration_us_;
+}
+
+void SPINorSimulator::start_busy_(uint32_t duration_us){
+  this->busy_since_ = micros();
+  this->busy_duration_us_ = duration_us;
+  this->write_enabled_ = false;
+}
+
+void SPINorSimulator::account_bus_time_(size_t bytes){
+  const uint32_t bus_us = (uint64_t) bytes * 8 * 1000000 / this->data_rate_;
+  this->counters_.spi_bytes += bytes;
+  this->counters_.bus_us += bus_us;
+  if( this->simulate_bus_time_ && bus_us > 0 ){
+    delayMicroseconds(bus_us);
+  }
+}
+
+uint8_t SPINorSimulator::read_flash_byte_(uint32_t addr) const {
+  addr &= this->capacity_() - 1;
+  const uint8_t *sector = this->sectors_[addr / SECTOR_SIZE];
+  return (sector == nullptr) ? 0xFF : sector[addr % SECTOR_SIZE];
+}
+
+uint8_t *SPINorSimulator::writable_sector_(uint32_t sector){
+  if( this->sectors_[sector] == nullptr ){
+    ExternalRAMAllocator<uint8_t> allocator(ExternalRAMAllocator<uint8_t>::ALLOW_FAILURE);
+    uint8_t *data = allocator.allocate(SECTOR_SIZE);
+    if( data == nullptr ){
+      ESP_LOGE(TAG, "Out of memory for sector %" PRIu32, sector);
+      return nullptr;
+    }
+    memset(data, 0xFF, SECTOR_SIZE);
+    this->sectors_[sector] = data;
+  }
+  return this->sectors_[sector];
+}
+
+void SPINorSimulator::erase_range_(uint32_t addr, uint32_t size, uint32_t duration_us){
+  ExternalRAMAllocator<uint8_t> allocator(ExternalRAMAllocator<uint8_t>::ALLOW_FAILURE);
+  addr &= ~(size - 1);
+  for( uint32_t sector = addr / SECTOR_SIZE; sector < (addr + size) / SECTOR_SIZE; sector++ ){
+    if( this->sectors_[sector] != nullptr ){
+      allocator.deallocate(this->sectors_[sector], SECTOR_SIZE);
+      this->sectors_[sector] = nullptr;
+    }
+  }
+  this->counters_.erases++;
+  this->start_busy_(duration_us);
+}
+
+void SPINorSimulator::program_page_(){
+  const uint32_t page_addr = this->address_ & ~(PAGE_SIZE - 1) & (this->capacity_() - 1);
+  if( this->program_bit_flip_rate_ > 0 && random_float() < this->program_bit_flip_rate_ ){
+    // A bit that should be cleared stays set, like a weak cell. Searches from a random bit for one to be cleared.
+    const uint32_t start_bit = random_uint32() % (PAGE_SIZE * 8);
+    for( uint32_t i = 0; i < PAGE_SIZE * 8; i++ ){
+      const uint32_t bit = (start_bit + i) % (PAGE_SIZE * 8);
+      if( (this->page_buffer_[bit / 8] & (1 << (bit % 8))) == 0 ){
+        this->page_buffer_[bit / 8] |= 1 << (bit % 8);
+        this->counters_.injected_faults++;
+        break;
+      }
+    }
+  }
+  uint8_t *sector = this->writable_sector_(page_addr / SECTOR_SIZE);
+  if( sector != nullptr ){
+    uint8_t *page = sector + (page_addr % SECTOR_SIZE);
+    for( size_t i = 0; i < PAGE_SIZE; i++ ){
+      page[i] &= this->page_buffer_[i];
+    }
+  }
+  this->counters_.page_programs++;
+  this->start_busy_(this->page_program_us_);
+}
+
+void SPINorSimulator::enable(){
+  this->selected_ = true;
+  this->command_bytes_ = 0;
+  this->address_ = 0;
+  this->data_bytes_ = 0;
+  this->read_fault_at_ = -1;
+  this->ignored_ = false;
+  this->counters_.transactions++;
+}
+
+void SPINorSimulator::disable(){
+  if( !this->selected_ ){
+    return;
+  }
+  this->selected_ = false;
+  if( this->command_bytes_ == 0 || this->ignored_ ){
+    return;
+  }
+  
+  const bool address_complete = this->command_bytes_ > ADDRESS_BYTES;
+  switch( this->command_ ){
+    case CMD_WRITE_ENABLE:
+      this->write_enabled_ = true;
+      return;
+    case CMD_WRITE_DISABLE:
+      this->write_enabled_ = false;
+      return;
+    case CMD_PAGE_PROGRAM:
+    case CMD_SECTOR_ERASE:
+    case CMD_BLOCK_32K_ERASE:
+    case CMD_BLOCK_64K_ERASE:
+    case CMD_CHIP_ERASE:
+    case CMD_CHIP_ERASE_ALT:
+      break;
+    default:
+      return;
+  }
+  
+  if( !this->write_enabled_ ){
+    this->counters_.rejected_commands++;
+    return;
+  }
+  
+  switch( this->command_ ){
+    case CMD_PAGE_PROGRAM:
+      if( address_complete && this->data_bytes_ > 0 ){
+        this->program_page_();
+      }
+      break;
+    case CMD_SECTOR_ERASE:
+      if( address_complete ){
+        this->erase_range_(this->address_, SECTOR_SIZE, this->sector_erase_us_);
+      }
+      break;
+    case CMD_BLOCK_32K_ERASE:
+      if( address_complete ){
+        this->erase_range_(this->address_, 32 * 1024, this->block_32k_erase_us_);
+      }
+      break;
+    case CMD_BLOCK_64K_ERASE:
+      if( address_complete ){
+        this->erase_range_(this->address_, 64 * 1024, this->block_64k_erase_us_);
+      }
+      break;
+    default:
+      this->erase_range_(0, this->capacity_(), this->chip_erase_us_);
+      break;
+  }
+}
+
+uint8_t SPINorSimulator::process_byte_(uint8_t mosi){
+  if( !this->selected_ ){
+    return 0xFF;
+  }
+  
+  const size_t index = this->command_bytes_++;
+  if( index == 0 ){
+    this->command_ = mosi;
+    if( this->command_ == CMD_READ_STATUS ){
+      this->counters_.status_reads++;
+    } else if( this->is_busy_() ){
+      this->ignored_ = true;
+      this->counters_.rejected_commands++;
+    } else if( this->command_ == CMD_PAGE_PROGRAM ){
+      memset(this->page_buffer_, 0xFF, PAGE_SIZE);
+    } else if( (this->command_ == CMD_READ || this->command_ == CMD_FAST_READ) && this->read_bit_flip_rate_ > 0 &&
+               random_float() < this->read_bit_flip_rate_ ){
+      this->read_fault_at_ = random_uint32() % PAGE_SIZE;
+    }
+    return 0xFF;
+  }
+  
+  switch( this->command_ ){
+    case CMD_READ_STATUS:
+      return (this->is_busy_() ? STATUS_BUSY : 0) | (this->write_enabled_ ? STATUS_WEL : 0);
+    case CMD_JEDEC_ID:
+      if( this->ignored_ ){
+        return 0xFF;
+      }
+      if( index == 1 ){
+        return this->manufacturer_id_;
+      } else if( index == 2 ){
+        return this->memory_type_id_;
+      } else if( index == 3 ){
+        return this->capacity_id_;
+      }
+      return 0xFF;
+    default:
+      break;
+  }
+  
+  if( index <= ADDRESS_BYTES ){
+    this->address_ = (this->address_ << 8) | mosi;
+    return 0xFF;
+  }
+  if( this->ignored_ ){
+    return 0xFF;
+  }
+  
+  if( this->command_ == CMD_PAGE_PROGRAM ){
+    // Data past the end of the page wraps around to its start
+    this->page_buffer_[(this->address_ + this->data_bytes_) % PAGE_SIZE] = mosi;
+    this->data_bytes_++;
+    return 0xFF;
+  }
+  
+  if( this->command_ == CMD_READ || this->command_ == CMD_FAST_READ ){
+    if( this->command_ == CMD_FAST_READ && index == ADDRESS_BYTES + 1 ){
+      return 0xFF;  // dummy byte
+    }
+    uint8_t data = this->read_flash_byte_(this->address_ + this->data_bytes_);
+    if( (int32_t) this->data_bytes_ == this->read_fault_at_ ){
+      data ^= 1 << (random_uint32() % 8);
+      this->counters_.injected_faults++;
+    }
+    this->data_bytes_++;
+    return data;
+  }
+  return 0xFF;
+}
+
+uint8_t SPINorSimulator::transfer_byte(uint8_t data){
+  this->account_bus_time_(1);
+  return this->process_byte_(data);
+}
+
+void SPINorSimulator::transfer_array(uint8_t *data, size_t length){
+  this->account_bus_time_(length);
+  for( size_t i = 0; i < length; i++ ){
+    data[i] = this->process_byte_(data[i]);
+  }
+}
+
+void SPINorSimulator::write_array(const uint8_t *data, size_t length){
+  this->account_bus_time_(length);
+  for( size_t i = 0; i < length; i++ ){
+    this->process_byte_(data[i]);
+  }
+}
+
+void SPINorSimulator::read_array(uint8_t *data, size_t length){
+  this->account_bus_time_(length);
+  for( size_t i = 0; i < length; i++ ){
+    data[i] = this->process_byte_(0x00);
+  }
+}
+
+}  // namespace satellite1
+}  // namespace esphome
+
+#endif
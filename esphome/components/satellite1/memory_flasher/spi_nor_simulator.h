@@ -0,0 +1,121 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_XMOS_FLASH_SIMULATOR
+
+#include "esphome/core/helpers.h"
+
+#include <vector>
+
+namespace esphome {
+namespace satellite1 {
+
+struct SPINorSimulatorCounters {
+  /* Counters of the simulated flash, logged when the flasher releases it.
+   *
+   *  - spi_bytes counts every byte clocked over the simulated bus in either direction, bus_us is the time these bytes
+   *    take at the configured data rate.
+   *  - rejected_commands counts program and erase commands ignored because the write enable latch wasn't set or the
+   *    flash was still busy.
+   *  - injected_faults counts the bit flips inserted while programming or reading.
+   */
+  uint64_t spi_bytes{0};
+  uint64_t bus_us{0};
+  uint32_t transactions{0};
+  uint32_t status_reads{0};
+  uint32_t page_programs{0};
+  uint32_t erases{0};
+  uint32_t rejected_commands{0};
+  uint32_t injected_faults{0};
+};
+
+class SPINorSimulator {
+  /*
+   * @brief Simulates the XMOS SPI NOR flash, so the flasher can be benchmarked and its error paths exercised without
+   * a Satellite1 HAT. Replaces the chip select and transfer calls of the flasher's SPI service.
+   *
+   *  - Answers JEDEC ID, read status, write enable/disable, page program, fast read, 4/32/64 KB erase and chip erase.
+   *  - Programming and erasing set the BUSY status bit for the configured duration and clear the write enable latch.
+   *    Like a real flash, commands other than read status are ignored while busy.
+   *  - Programming only clears bits, and a page program wraps around within its page.
+   *  - Sectors are allocated in external RAM once written, erased sectors take no memory.
+   *  - Faults: with the configured probability per page program, one bit isn't programmed; with the configured
+   *    probability per read, one bit read is flipped.
+   */
+public:
+  bool init();
+  void reset_counters() { this->counters_ = SPINorSimulatorCounters{}; }
+  SPINorSimulatorCounters get_counters() const { return this->counters_; }
+  void log_counters() const;
+
+  void enable();
+  void disable();
+  uint8_t transfer_byte(uint8_t data);
+  void transfer_array(uint8_t *data, size_t length);
+  void write_array(const uint8_t *data, size_t length);
+  void read_array(uint8_t *data, size_t length);
+
+  /// @brief Sets the capacity reported by the JEDEC ID, as log2 of the size in bytes
+  void set_capacity_id(uint8_t capacity_id) { this->capacity_id_ = capacity_id; }
+  void set_page_program_time(uint32_t us) { this->page_program_us_ = us; }
+  void set_sector_erase_time(uint32_t us) { this->sector_erase_us_ = us; }
+  void set_block_32k_erase_time(uint32_t us) { this->block_32k_erase_us_ = us; }
+  void set_block_64k_erase_time(uint32_t us) { this->block_64k_erase_us_ = us; }
+  void set_chip_erase_time(uint32_t us) { this->chip_erase_us_ = us; }
+  void set_data_rate(uint32_t data_rate) { this->data_rate_ = data_rate; }
+  /// @brief Delays every transfer by the time its bytes would take on the bus, so wall times match a real flash
+  void set_simulate_bus_time(bool simulate_bus_time) { this->simulate_bus_time_ = simulate_bus_time; }
+  /// @brief Probability per page program that one bit of the page stays set
+  void set_program_bit_flip_rate(float rate) { this->program_bit_flip_rate_ = rate; }
+  /// @brief Probability per read transaction that one bit read is flipped
+  void set_read_bit_flip_rate(float rate) { this->read_bit_flip_rate_ = rate; }
+
+protected:
+  uint8_t process_byte_(uint8_t mosi);
+  void account_bus_time_(size_t bytes);
+  bool is_busy_() const;
+  void start_busy_(uint32_t duration_us);
+  uint8_t read_flash_byte_(uint32_t addr) const;
+  /// @brief Returns the sector's memory, allocating it erased if necessary; nullptr if out of memory
+  uint8_t *writable_sector_(uint32_t sector);
+  void erase_range_(uint32_t addr, uint32_t size, uint32_t duration_us);
+  void program_page_();
+  uint32_t capacity_() const { return 1 << this->capacity_id_; }
+
+  uint8_t manufacturer_id_{0xEF};
+  uint8_t memory_type_id_{0x40};
+  uint8_t capacity_id_{23};
+  uint32_t page_program_us_{700};
+  uint32_t sector_erase_us_{45000};
+  uint32_t block_32k_erase_us_{120000};
+  uint32_t block_64k_erase_us_{150000};
+  uint32_t chip_erase_us_{20000000};
+  uint32_t data_rate_{8000000};
+  bool simulate_bus_time_{true};
+  float program_bit_flip_rate_{0.0f};
+  float read_bit_flip_rate_{0.0f};
+
+  std::vector<uint8_t *> sectors_;
+
+  // State of the current chip select
+  bool selected_{false};
+  uint8_t command_{0};
+  size_t command_bytes_{0};
+  uint32_t address_{0};
+  uint8_t page_buffer_[256];
+  size_t data_bytes_{0};
+  int32_t read_fault_at_{-1};  // data byte of the current read that gets a flipped bit
+  bool ignored_{false};        // sent while busy
+
+  bool write_enabled_{false};
+  uint32_t busy_since_{0};
+  uint32_t busy_duration_us_{0};
+
+  SPINorSimulatorCounters counters_;
+};
+
+}  // namespace satellite1
+}  // namespace esphome
+
+#endif
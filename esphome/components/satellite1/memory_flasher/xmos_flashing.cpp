@@ -1,7 +1,10 @@
 #include "xmos_flashing.h"
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
 #include "esphome/core/log.h"
 
-#include <endian.h>
+#include <esp_rom_crc.h>
+#include <strings.h>
 
 namespace esphome {
 namespace satellite1 {
@@ -10,7 +13,43 @@ static const char *const TAG = "xmos_flasher";
 
 static const size_t FLASH_PAGE_SIZE = 256;
 static const size_t FLASH_SECTOR_SIZE = 4096;
-constexpr size_t FLASH_TOTAL_NUMBER_OF_SECTORS = 8388608 / FLASH_SECTOR_SIZE;
+// Used if the JEDEC ID doesn't report a plausible capacity
+static const uint32_t DEFAULT_FLASH_CAPACITY = 8388608;
+// JEDEC capacity IDs are log2 of the size in bytes; 3 byte addresses reach at most 16 MB
+static const uint8_t MIN_CAPACITY_ID = 16;
+static const uint8_t MAX_CAPACITY_ID = 24;
+
+static const uint8_t FLASH_CMD_PAGE_PROGRAM = 0x02;
+static const uint8_t FLASH_CMD_READ_STATUS = 0x05;
+static const uint8_t FLASH_CMD_FAST_READ = 0x0B;
+
+struct EraseCommand {
+  uint8_t cmd;
+  uint32_t size;
+  uint32_t timeout_ms;  // maximum erase time of common 3.3 V NOR flashes
+};
+
+// Ordered from largest to smallest, so the planner picks the largest erase that fits
+static const EraseCommand ERASE_COMMANDS[] = {
+    {0xD8, 64 * 1024, 2000},
+    {0x52, 32 * 1024, 1600},
+    {0x20, FLASH_SECTOR_SIZE, 500},
+};
+
+static const uint8_t FLASH_STATUS_BUSY = 1;
+
+static const uint32_t PAGE_PROGRAM_TIMEOUT_MS = 15;
+
+// The reader gives up if the image source doesn't deliver any data for this long
+static const uint32_t READER_STALL_TIMEOUT_MS = 10000;
+// Pipeline tasks wake up this often while waiting for a block, to notice an aborted pipeline
+static const TickType_t BLOCK_WAIT_TICKS = pdMS_TO_TICKS(100);
+// Reads are split into transfers of at most this size, all within a single chip select
+static const size_t FLASH_READ_CHUNK_SIZE = 1024;
+
+static const uint32_t READER_TASK_STACK_SIZE = 6144;  // HTTPS reads run through mbedtls in this task
+static const uint32_t WRITER_TASK_STACK_SIZE = 3072;
+static const UBaseType_t PIPELINE_TASK_PRIORITY = 2;
 
 
 void XMOSFlasher::loop(){
@@ -20,7 +59,7 @@ void XMOSFlasher::loop(){
     
     case FLASHER_INITIALIZING:
       if( this->init_flashing_() ){
-        this->state = FLASHER_ERASING; 
+        this->state = (this->requested_action == ACTION_FULL_ERASE) ? FLASHER_ERASING : FLASHER_FLASHING;
       } else {
         this->deinit_flashing_();
         this->state = FLASHER_ERROR_STATE;
@@ -31,30 +70,45 @@ void XMOSFlasher::loop(){
       {
         int remaining = this->erasing_step_();
         this->publish_progress_();
-        if( remaining == 0 && this->requested_action == ACTION_FULL_ERASE ){
+        if( remaining == 0 ){
           this->deinit_flashing_();
           this->state = FLASHER_SUCCESS_STATE;
-        } else if( remaining == 0 ) {
-          this->state = FLASHER_FLASHING;
         } else if( remaining < 0 ){
+          this->deinit_flashing_();
           this->state = FLASHER_ERROR_STATE; 
         }
         break;  
       }
     
     case FLASHER_FLASHING:
-      {
-        int remaining = this->flashing_step_();
-        this->publish_progress_();
-        if( remaining == 0 ){
-          this->deinit_flashing_();
-          this->state = FLASHER_SUCCESS_STATE;
-        } else if( remaining < 0 ){
-          this->deinit_flashing_();
-          this->state = FLASHER_ERROR_STATE;
-        }
+      this->publish_progress_();
+      if( this->reader_task_running_ || this->writer_task_running_ ){
         break;
       }
+      this->error_code = this->pipeline_error_;
+      if( this->error_code == FLASHER_OK ){
+        if( strncmp(this->md5_computed_.c_str(), this->md5_expected_.c_str(), MD5_SIZE) != 0 ) {
+          ESP_LOGE(TAG, "MD5 computed: %s - Aborting due to MD5 mismatch", this->md5_computed_.c_str());
+          this->error_code = MD5_MISMATCH_ERROR;
+        } else {
+          ESP_LOGD(TAG, "MD5 computed: %s - Matches!", this->md5_computed_.c_str());
+        }
+      }
+      this->log_flashing_counters_();
+      {
+        const FlashingCounters counters = this->get_flashing_counters();
+        const uint32_t flashing_ms = millis() - this->flashing_start_time_;
+        ESP_LOGI(TAG,
+                 "Flashed %u bytes in %" PRIu32 " ms (%" PRIu32 " kB/s), %" PRIu32 " %s program retries, "
+                 "verifying took %" PRIu32 " ms",
+                 this->total_number_of_bytes_, flashing_ms,
+                 FlashingCounters::kbytes_per_second(this->total_number_of_bytes_, flashing_ms * 1000),
+                 counters.program_retries, (this->verify_mode_ == VERIFY_SECTOR_CRC) ? "sector" : "page",
+                 counters.verify_us / 1000);
+      }
+      this->deinit_flashing_();
+      this->state = (this->error_code == FLASHER_OK) ? FLASHER_SUCCESS_STATE : FLASHER_ERROR_STATE;
+      break;
     
     case FLASHER_SUCCESS_STATE:
       this->publish();
@@ -76,15 +130,15 @@ void XMOSFlasher::publish_progress_(){
     
     if ( (now - this->last_published_) > 1000 ) {
       if( this->requested_action == ACTION_FULL_ERASE ){
-        this->flashing_progress = this->current_sector_ * 100 / this->total_sectors_to_erase_;    
-      } else {
-          this->flashing_progress = (
-              (this->current_sector_ + this->total_number_of_bytes_ - this->bytes_remaining_ ) * 100 
-                / ( this->total_number_of_bytes_ + this->total_sectors_to_erase_ )
-          );    
+        this->flashing_progress = (uint64_t) this->erase_done_pos_ * 100 / this->erase_end_pos_;
+      } else if( this->total_number_of_bytes_ > 0 ){
+        this->flashing_progress = (uint64_t) this->bytes_flashed_.load() * 100 / this->total_number_of_bytes_;
       }
       this->last_published_ = now;
       ESP_LOGD(TAG, "Progress: %d%%", this->flashing_progress );
+      if( this->requested_action != ACTION_FULL_ERASE ){
+        this->log_flashing_counters_();
+      }
       this->publish();
     }
 }
@@ -92,26 +146,50 @@ void XMOSFlasher::publish_progress_(){
 
 bool XMOSFlasher::init_flasher(){
   ESP_LOGD(TAG, "Setting up XMOS flasher...");
-  this->parent_->set_spi_flash_direct_access_mode(true);
-  this->read_JEDECID_();
+#ifdef USE_XMOS_FLASH_SIMULATOR
+  if( this->simulator_ != nullptr ){
+    this->simulator_->init();
+    this->simulator_->reset_counters();
+  }
+#endif
+  this->set_direct_access_mode_(true);
+  if( this->read_JEDECID_() && this->capacityID_ >= MIN_CAPACITY_ID && this->capacityID_ <= MAX_CAPACITY_ID ){
+    this->capacity_ = 1 << this->capacityID_;
+  } else {
+    ESP_LOGW(TAG, "Unknown flash capacity, assuming %" PRIu32 " bytes", DEFAULT_FLASH_CAPACITY);
+    this->capacity_ = DEFAULT_FLASH_CAPACITY;
+  }
+  this->total_number_of_sectors_ = this->capacity_ / FLASH_SECTOR_SIZE;
   this->dump_flash_info();
-  this->total_number_of_sectors_ = FLASH_TOTAL_NUMBER_OF_SECTORS;
   return true;
 }
 
 bool XMOSFlasher::deinit_flasher(){
   ESP_LOGD(TAG, "Stopping XMOS flasher...");
-  this->parent_->set_spi_flash_direct_access_mode(false);
+  this->set_direct_access_mode_(false);
+#ifdef USE_XMOS_FLASH_SIMULATOR
+  if( this->simulator_ != nullptr ){
+    this->simulator_->log_counters();
+  }
+#endif
   return true;
 }
 
+void XMOSFlasher::set_direct_access_mode_(bool enable){
+#ifdef USE_XMOS_FLASH_SIMULATOR
+  if( this->simulator_ != nullptr ){
+    return;  // the simulated flash isn't connected to the XMOS
+  }
+#endif
+  this->parent_->set_spi_flash_direct_access_mode(enable);
+}
+
 void XMOSFlasher::dump_flash_info(){
   ESP_LOGCONFIG(TAG, "Satellite1-Flasher:");
   ESP_LOGCONFIG(TAG, "	JEDEC-manufacturerID %hhu", this->manufacturerID_);
   ESP_LOGCONFIG(TAG, "	JEDEC-memoryTypeID %hhu", this->memoryTypeID_);
   ESP_LOGCONFIG(TAG, "	JEDEC-capacityID %hhu", this->capacityID_);
-  ESP_LOGCONFIG(TAG, "	JEDEC-capacityID %hhu", this->capacityID_);
-  ESP_LOGCONFIG(TAG, "	JEDEC-capacity: %hhu", 1 << this->capacityID_);
+  ESP_LOGCONFIG(TAG, "	Capacity: %" PRIu32 " bytes", this->capacity_);
 }
 
 
@@ -192,19 +270,29 @@ bool XMOSFlasher::read_JEDECID_(){
 
 
 
-bool XMOSFlasher::wait_while_flash_busy_(uint32_t timeout_ms){
-  int32_t timeout_invoke = millis();
-  const uint8_t WEL  = 2;
-  const uint8_t BUSY = 1;
+uint8_t XMOSFlasher::read_status_(){
+  uint8_t cmd[2] = {FLASH_CMD_READ_STATUS, 0x00};
+  this->enable();
+  this->transfer_array(cmd, sizeof(cmd));
+  this->disable();
+  return cmd[1];
+}
+
+void XMOSFlasher::send_address_command_(uint8_t cmd, uint32_t byte_addr){
+  const uint8_t header[4] = {cmd, (uint8_t) (byte_addr >> 16), (uint8_t) (byte_addr >> 8), (uint8_t) byte_addr};
+  this->write_array(header, sizeof(header));
+}
+
+bool XMOSFlasher::wait_while_flash_busy_(uint32_t timeout_ms, bool yield_while_busy){
+  uint32_t timeout_invoke = millis();
 
   while( (millis() - timeout_invoke) < timeout_ms ){
-    this->enable();
-    this->transfer_byte(0x05);
-    uint8_t status = this->transfer_byte(0x00);
-    this->disable();
-    if( (status & BUSY) == 0){
+    if( (this->read_status_() & FLASH_STATUS_BUSY) == 0){
        return true;      
     }
+    if( yield_while_busy ){
+      delay(1);
+    }
   }
   return false;
 }
@@ -215,10 +303,7 @@ bool XMOSFlasher::enable_writing_(){
   this->transfer_byte(0x06);
   this->disable();
   
-  this->enable();
-  this->transfer_byte(0x05);
-  uint8_t status = this->transfer_byte(0x00);
-  this->disable();
+  uint8_t status = this->read_status_();
   const uint8_t WEL  = 2;
   if( !(status & WEL)){
     return false;      
@@ -234,24 +319,25 @@ bool XMOSFlasher::disable_writing_(){
   return true;
 }
 
-bool XMOSFlasher::erase_sector_(int sector){
-  //erase 4kB sector
-  assert( FLASH_SECTOR_SIZE == 4096 );
-  uint32_t u32 = htole32(sector * FLASH_SECTOR_SIZE);
-  uint8_t* u8_ptr = (uint8_t*) &u32;
+bool XMOSFlasher::start_erase_(uint32_t byte_addr, uint32_t end_addr){
+  // Pick the largest erase that is aligned to its own size and doesn't reach past the end
+  const EraseCommand *erase = &ERASE_COMMANDS[0];
+  while( erase->size > FLASH_SECTOR_SIZE && ((byte_addr % erase->size) != 0 || byte_addr + erase->size > end_addr) ){
+    erase++;
+  }
   
   if( !this->enable_writing_()){
     return false;
   }
   
   this->enable();
-  this->transfer_byte(0x20);
-  this->transfer_byte( *(u8_ptr+2));
-  this->transfer_byte( *(u8_ptr+1));
-  this->transfer_byte( *(u8_ptr)  );
+  this->send_address_command_(erase->cmd, byte_addr);
   this->disable();
 
-  //this->disable_writing_();
+  this->erase_pos_ = byte_addr + erase->size;
+  this->erase_timeout_ms_ = erase->timeout_ms;
+  this->erase_started_ = millis();
+  ESP_LOGV(TAG, "Erasing %" PRIu32 " bytes at 0x%06" PRIx32, erase->size, byte_addr);
   return true;
 }  
 
@@ -269,7 +355,7 @@ bool XMOSFlasher::chip_erase_(){
 }  
 
 
-bool XMOSFlasher::write_page_( uint32_t byte_addr, uint8_t* buffer ){
+bool XMOSFlasher::write_page_( uint32_t byte_addr, const uint8_t* buffer ){
   if ((byte_addr & (FLASH_PAGE_SIZE - 1)) != 0){
     ESP_LOGE(TAG, "Address needs to be page aligned (%d).", FLASH_PAGE_SIZE);
     return false;
@@ -279,23 +365,17 @@ bool XMOSFlasher::write_page_( uint32_t byte_addr, uint8_t* buffer ){
     return false;
   }
   
-  uint32_t u32 = htole32(byte_addr);
-  uint8_t* u8_ptr = (uint8_t*) &u32;
+  // Command, address, and the whole page in a single chip select, as two bulk transactions
   this->enable();
-  this->transfer_byte(0x02);
-  this->transfer_byte( *(u8_ptr+2));
-  this->transfer_byte( *(u8_ptr+1));
-  this->transfer_byte( *(u8_ptr)  );
-  for(int pos = 0; pos < FLASH_PAGE_SIZE; pos++){
-    this->transfer_byte(*(buffer + pos));
-  }
+  this->send_address_command_(FLASH_CMD_PAGE_PROGRAM, byte_addr);
+  this->write_array(buffer, FLASH_PAGE_SIZE);
   this->disable();
 
-  if( !this->wait_while_flash_busy_(15) ){
+  // The write enable latch resets itself once the page is programmed
+  if( !this->wait_while_flash_busy_(PAGE_PROGRAM_TIMEOUT_MS) ){
     ESP_LOGE(TAG, "Writing page timeout");
     return false;
   }
-  this->disable_writing_();
   return true;
 }
 
@@ -303,16 +383,16 @@ bool XMOSFlasher::read_page_( uint32_t byte_addr, uint8_t* buffer ){
   if ((byte_addr & (FLASH_PAGE_SIZE - 1)) != 0){
     return false;
   }
-  uint32_t u32 = htole32(byte_addr);
-  uint8_t* u8_ptr = (uint8_t*) &u32;
+  return this->read_data_(byte_addr, buffer, FLASH_PAGE_SIZE);
+}
+
+bool XMOSFlasher::read_data_( uint32_t byte_addr, uint8_t* buffer, size_t len ){
+  // Fast read: the address is followed by a dummy byte, then the flash streams data for as long as CS stays low
   this->enable();
-  this->transfer_byte(0x0B);
-  this->transfer_byte( *(u8_ptr+2));
-  this->transfer_byte( *(u8_ptr+1));
-  this->transfer_byte( *(u8_ptr)  );
+  this->send_address_command_(FLASH_CMD_FAST_READ, byte_addr);
   this->transfer_byte(0x00);
-  for(int pos=0; pos < FLASH_PAGE_SIZE; pos++){
-    *(buffer + pos) = this->transfer_byte(0x00);
+  for( size_t offset = 0; offset < len; offset += FLASH_READ_CHUNK_SIZE ){
+    this->read_array(buffer + offset, std::min(len - offset, FLASH_READ_CHUNK_SIZE));
   }
   this->disable();
   return true;
@@ -328,17 +408,20 @@ bool XMOSFlasher::init_flashing_() {
   }
   
   this->flashing_start_time_ = millis();
+  this->high_freq_.start();
 
   switch( this->requested_action ){
     case ACTION_FLASH_EMBEDDED_IMAGE:
-      this->reader_ = new EmbeddedImageReader(this->embedded_image_);
+      this->reader_ = this->create_embedded_image_reader_();
       break;
     case ACTION_FLASH_REMOTE_IMAGE:
       this->reader_ = new HttpImageReader(this->http_request_, this->url_);
       break;
     case ACTION_FULL_ERASE:
-      this->total_sectors_to_erase_ = this->total_number_of_sectors_;
-      this->current_sector_ = -1;
+      this->erase_pos_ = 0;
+      this->erase_done_pos_ = 0;
+      this->erase_end_pos_ = this->capacity_;
+      this->erase_in_progress_ = false;
       return true;  
   };
 
@@ -346,44 +429,116 @@ bool XMOSFlasher::init_flashing_() {
     this->error_code = INIT_READER_ERROR;
     return false;
   }
+  
+  size_t size_in_bytes = this->reader_->get_image_size();
+  size_t size_in_pages = ((size_in_bytes + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE);
+  size_t size_in_sectors = ((size_in_pages * FLASH_PAGE_SIZE + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE);
 
-  this->reader_buffer_ = (uint8_t *) malloc(FLASH_PAGE_SIZE);
-  if( this->reader_buffer_ == nullptr ){
+  this->total_number_of_bytes_ = size_in_bytes;
+  this->total_sectors_to_erase_ = size_in_sectors;
+  if( size_in_sectors > this->total_number_of_sectors_ ){
+    ESP_LOGE(TAG, "Image (%u bytes) doesn't fit the flash (%" PRIu32 " bytes)", size_in_bytes, this->capacity_);
+    this->error_code = INIT_FLASH_ERROR;
+    return false;
+  }
+  
+  this->use_manifest_ = false;
+  if( this->requested_action == ACTION_FLASH_REMOTE_IMAGE && !this->sector_manifest_url_.empty() ){
+    // The manifest only saves time, so flash the whole image if it is unusable
+    this->use_manifest_ = this->fetch_sector_manifest_();
+    if( !this->use_manifest_ ){
+      ESP_LOGW(TAG, "Couldn't use the sector manifest, flashing every sector");
+    }
+  }
+  this->sector_changed_.assign(size_in_sectors, true);
+  this->scan_done_ = false;
+
+  for( auto &block : this->blocks_ ){
+    block.data = (uint8_t *) malloc(FLASH_SECTOR_SIZE);
+    if( block.data == nullptr ){
+      ESP_LOGE(TAG, "Couldn't allocate memory");
+      this->error_code = INIT_FLASH_ERROR;
+      return false;
+    }
+  }
+  
+  this->free_blocks_ = xQueueCreate(NUMBER_OF_BLOCKS, sizeof(uint8_t));
+  this->filled_blocks_ = xQueueCreate(NUMBER_OF_BLOCKS + 1, sizeof(uint8_t));  // room for END_OF_IMAGE
+  if( this->free_blocks_ == nullptr || this->filled_blocks_ == nullptr ){
     ESP_LOGE(TAG, "Couldn't allocate memory");
     this->error_code = INIT_FLASH_ERROR;
     return false;
   }
+  for( uint8_t index = 0; index < NUMBER_OF_BLOCKS; index++ ){
+    xQueueSend(this->free_blocks_, &index, 0);
+  }
   
-  this->compare_buffer_ = (uint8_t *) malloc(FLASH_PAGE_SIZE);
+  this->compare_buffer_ = (uint8_t *) malloc(FLASH_READ_CHUNK_SIZE);
   if( this->compare_buffer_ == nullptr ){
     ESP_LOGE(TAG, "Couldn't allocate memory");
     this->error_code = INIT_FLASH_ERROR;
     return false;
   }
   
+  if( this->skip_unchanged_sectors_ || this->use_manifest_ ){
+    this->sector_buffer_ = (uint8_t *) malloc(FLASH_SECTOR_SIZE);
+    if( this->sector_buffer_ == nullptr ){
+      ESP_LOGE(TAG, "Couldn't allocate memory");
+      this->error_code = INIT_FLASH_ERROR;
+      return false;
+    }
+  }
+  
   ESP_LOGD(TAG, "MD5 expected: %s", this->md5_expected_.c_str());
   
   this->flashing_progress = 0;
   this->md5_receive_.init();
 
-  size_t size_in_bytes = this->reader_->get_image_size();
-  size_t size_in_pages = ((size_in_bytes + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE);
-  size_t size_in_sectors = ((size_in_pages * FLASH_PAGE_SIZE + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE);
-
-  this->total_number_of_bytes_ = size_in_bytes;
-  this->bytes_remaining_ = size_in_bytes;
-  this->page_pos_ = 0;
+  this->bytes_flashed_ = 0;
+  this->pipeline_error_ = FLASHER_OK;
+  this->abort_pipeline_ = false;
+  {
+    LockGuard lock(this->counters_lock_);
+    this->counters_ = FlashingCounters{};
+  }
 
-  this->total_sectors_to_erase_ = size_in_sectors;
-  this->current_sector_ = -1;
+  this->reader_task_running_ = true;
+  if( xTaskCreate(XMOSFlasher::reader_task_, "xmos_flash_read", READER_TASK_STACK_SIZE, (void *) this,
+                  PIPELINE_TASK_PRIORITY, nullptr) != pdPASS ){
+    ESP_LOGE(TAG, "Couldn't create the reader task");
+    this->reader_task_running_ = false;
+    this->error_code = INIT_FLASH_ERROR;
+    return false;
+  }
+  
+  this->writer_task_running_ = true;
+  if( xTaskCreate(XMOSFlasher::writer_task_, "xmos_flash_write", WRITER_TASK_STACK_SIZE, (void *) this,
+                  PIPELINE_TASK_PRIORITY, nullptr) != pdPASS ){
+    ESP_LOGE(TAG, "Couldn't create the writer task");
+    this->writer_task_running_ = false;
+    // The reader task is already running, so let the loop clean up once it noticed the abort
+    this->fail_pipeline_(INIT_FLASH_ERROR);
+  }
   
   return true;  
 }
 
 void XMOSFlasher::deinit_flashing_(){
-  if( this->reader_buffer_ ){
-    free( this->reader_buffer_ );
-    this->reader_buffer_ = nullptr;
+  for( auto &block : this->blocks_ ){
+    if( block.data ){
+      free( block.data );
+      block.data = nullptr;
+    }
+  }
+  
+  if( this->free_blocks_ ){
+    vQueueDelete(this->free_blocks_);
+    this->free_blocks_ = nullptr;
+  }
+  
+  if( this->filled_blocks_ ){
+    vQueueDelete(this->filled_blocks_);
+    this->filled_blocks_ = nullptr;
   }
   
   if( this->compare_buffer_ ){
@@ -391,6 +546,14 @@ void XMOSFlasher::deinit_flashing_(){
     this->compare_buffer_ = nullptr;
   }
   
+  if( this->sector_buffer_ ){
+    free( this->sector_buffer_);
+    this->sector_buffer_ = nullptr;
+  }
+  
+  this->sector_hashes_ = {};
+  this->sector_changed_ = {};
+  
   if( this->reader_){
     this->reader_->deinit_reader();
     delete this->reader_;
@@ -400,99 +563,537 @@ void XMOSFlasher::deinit_flashing_(){
   this->md5_computed_.clear();
   this->md5_expected_.clear();
   
+  this->high_freq_.stop();
   delay(5);
   this->deinit_flasher();
 }
 
 
 int XMOSFlasher::erasing_step_(){
-  if( !this->wait_while_flash_busy_(1) )
-  {
-    return this->total_sectors_to_erase_ - this->current_sector_;
-  }
-  
-  this->current_sector_++;
-  if( this->current_sector_ < this->total_sectors_to_erase_ ){
-    if( !this->erase_sector_(this->current_sector_) ){
+  // A single status read per loop iteration, instead of blocking the loop until the erase finished
+  if( this->erase_in_progress_ ){
+    if( this->read_status_() & FLASH_STATUS_BUSY ){
+      if( (millis() - this->erase_started_) > this->erase_timeout_ms_ ){
+        ESP_LOGE(TAG, "Erasing timeout at 0x%06" PRIx32, this->erase_done_pos_);
         this->error_code = WRITE_TO_FLASH_ERROR;
         return -1;
+      }
+      return (this->erase_end_pos_ - this->erase_done_pos_) / FLASH_SECTOR_SIZE;
     }
+    this->erase_in_progress_ = false;
+    this->erase_done_pos_ = this->erase_pos_;
+  }
+  
+  if( this->erase_done_pos_ >= this->erase_end_pos_ ){
+    return 0;
   }
   
-  return this->total_sectors_to_erase_ - this->current_sector_;
+  if( !this->start_erase_(this->erase_done_pos_, this->erase_end_pos_) ){
+    this->error_code = WRITE_TO_FLASH_ERROR;
+    return -1;
+  }
+  this->erase_in_progress_ = true;
+  return (this->erase_end_pos_ - this->erase_done_pos_) / FLASH_SECTOR_SIZE;
+}
+
+
+
+
+void XMOSFlasher::fail_pipeline_(FlasherError error){
+  FlasherError expected = FLASHER_OK;
+  this->pipeline_error_.compare_exchange_strong(expected, error);
+  this->abort_pipeline_ = true;
+}
+
+bool XMOSFlasher::receive_block_(QueueHandle_t queue, uint8_t *index){
+  while( !this->abort_pipeline_ ){
+    if( xQueueReceive(queue, index, BLOCK_WAIT_TICKS) == pdTRUE ){
+      return true;
+    }
+  }
+  return false;
 }
 
+void XMOSFlasher::reader_task_(void *params){
+  XMOSFlasher *this_flasher = (XMOSFlasher *) params;
+  FlasherError error = this_flasher->read_image_();
+  if( error != FLASHER_OK ){
+    this_flasher->fail_pipeline_(error);
+  }
+  this_flasher->reader_task_running_ = false;
+  vTaskDelete(nullptr);
+}
+
+void XMOSFlasher::writer_task_(void *params){
+  XMOSFlasher *this_flasher = (XMOSFlasher *) params;
+  FlasherError error = this_flasher->write_image_();
+  if( error != FLASHER_OK ){
+    this_flasher->fail_pipeline_(error);
+  }
+  this_flasher->writer_task_running_ = false;
+  vTaskDelete(nullptr);
+}
+
+FlasherError XMOSFlasher::read_image_(){
+  if( this->use_manifest_ ){
+    // The writer decides which sectors changed before anything is downloaded
+    while( !this->scan_done_ ){
+      if( this->abort_pipeline_ ){
+        return FLASHER_OK;
+      }
+      delay(10);
+    }
+  }
+  
+  size_t bytes_to_skip = 0;
+  for( size_t sector = 0; sector < this->total_sectors_to_erase_; sector++ ){
+    const size_t sector_length = this->sector_length_(sector);
+    if( !this->sector_changed_[sector] ){
+      bytes_to_skip += sector_length;
+      continue;
+    }
+    // Consecutive unchanged sectors are skipped at once, so a long run costs a single range request
+    if( bytes_to_skip > 0 ){
+      if( !this->reader_->skip_image_bytes(bytes_to_skip) ){
+        ESP_LOGE(TAG, "Couldn't skip unchanged sectors");
+        return CONNECTION_ERROR;
+      }
+      bytes_to_skip = 0;
+    }
+    
+    uint8_t index;
+    if( !this->receive_block_(this->free_blocks_, &index) ){
+      return FLASHER_OK;  // aborted by the writer, which set the error
+    }
+    
+    ImageBlock &block = this->blocks_[index];
+    block.sector = sector;
+    block.length = 0;
+    
+    uint32_t last_data_received = millis();
+    uint32_t download_us = 0;
+    while( block.length < sector_length ){
+      if( this->abort_pipeline_ ){
+        return FLASHER_OK;
+      }
+      
+      const uint32_t read_start = micros();
+      int bytes_read = this->reader_->read_image_block(block.data + block.length, sector_length - block.length);
+      download_us += micros() - read_start;
+      
+      if( bytes_read < 0 ){
+        ESP_LOGE(TAG, "Stream closed");
+        return CONNECTION_ERROR;
+      }
+      if( bytes_read == 0 ){
+        if( (millis() - last_data_received) > READER_STALL_TIMEOUT_MS ){
+          ESP_LOGE(TAG, "Image source stalled");
+          return CONNECTION_ERROR;
+        }
+        delay(1);
+        continue;
+      }
+      last_data_received = millis();
+      block.length += bytes_read;
+    }
+    
+    // Hashing here keeps it off the writer's path, so it runs while the writer programs the other block
+    const uint32_t hash_start = micros();
+    if( this->use_manifest_ ){
+      // Skipped sectors leave gaps in the image hash, so every downloaded sector is checked against the manifest
+      md5::MD5Digest sector_digest;
+      sector_digest.init();
+      sector_digest.add(block.data, block.length);
+      sector_digest.calculate();
+      if( !sector_digest.equals_bytes(this->sector_hashes_[sector].data()) ){
+        ESP_LOGE(TAG, "Sector %u doesn't match the manifest", (unsigned) sector);
+        return MD5_MISMATCH_ERROR;
+      }
+    } else {
+      this->md5_receive_.add(block.data, block.length);
+    }
+    // The last page is padded with zeros, as it is programmed as a whole page
+    const size_t padded_length = (block.length + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1);
+    memset(block.data + block.length, 0, padded_length - block.length);
+    if( this->verify_mode_ == VERIFY_SECTOR_CRC ){
+      block.crc = esp_rom_crc32_le(0, block.data, padded_length);
+    }
+    const uint32_t hash_us = micros() - hash_start;
+    
+    {
+      LockGuard lock(this->counters_lock_);
+      this->counters_.bytes_downloaded += block.length;
+      this->counters_.download_us += download_us;
+      this->counters_.hash_us += hash_us;
+    }
+    
+    xQueueSend(this->filled_blocks_, &index, portMAX_DELAY);
+  }
+  
+  const uint8_t end_of_image = END_OF_IMAGE;
+  xQueueSend(this->filled_blocks_, &end_of_image, portMAX_DELAY);
+  
+  if( this->use_manifest_ ){
+    // The manifest is bound to the image by its first line, and every sector matched its hash
+    this->md5_computed_ = this->manifest_image_md5_;
+    return FLASHER_OK;
+  }
+  
+  char md5_receive_str[33];
+  this->md5_receive_.calculate();
+  this->md5_receive_.get_hex(md5_receive_str);
+  md5_receive_str[32] = '\0';
+  this->md5_computed_ = md5_receive_str;
+  return FLASHER_OK;
+}
 
+FlasherError XMOSFlasher::write_image_(){
+  if( this->use_manifest_ ){
+    this->scan_unchanged_sectors_();
+  }
+  this->scan_done_ = true;
+  
+  // Sectors known to be flashed get their erase issued before waiting for their data, so the flash erases while the
+  // reader downloads
+  this->erase_pos_ = 0;
+  int erase_next = this->next_sector_to_erase_(-1);
+  if( erase_next >= 0 && !this->erase_sectors_from_(erase_next) ){
+    return WRITE_TO_FLASH_ERROR;
+  }
+  
+  while( true ){
+    uint8_t index;
+    const uint32_t wait_start = micros();
+    if( !this->receive_block_(this->filled_blocks_, &index) ){
+      return FLASHER_OK;  // aborted by the reader, which set the error
+    }
+    if( index == END_OF_IMAGE ){
+      break;
+    }
+    const uint32_t starved_us = micros() - wait_start;
+    
+    ImageBlock &block = this->blocks_[index];
+    
+    if( this->skip_unchanged_sectors_ && !this->use_manifest_ ){
+      const uint32_t compare_start = micros();
+      const bool unchanged = this->sector_matches_flash_(block.data, block.sector, block.length);
+      const uint32_t compare_us = micros() - compare_start;
+      {
+        LockGuard lock(this->counters_lock_);
+        this->counters_.compare_us += compare_us;
+        this->counters_.starved_us += starved_us;
+        if( unchanged ){
+          this->counters_.sectors_skipped++;
+        }
+      }
+      if( unchanged ){
+        this->bytes_flashed_ += block.length;
+        xQueueSend(this->free_blocks_, &index, portMAX_DELAY);
+        continue;
+      }
+    }
+    
+    if( !this->erase_sectors_from_(block.sector) ){
+      return WRITE_TO_FLASH_ERROR;
+    }
+    
+    const uint32_t erase_start = micros();
+    if( !this->wait_while_flash_busy_(this->erase_timeout_ms_, true) ){
+      ESP_LOGE(TAG, "Erasing sector %u timeout", (unsigned) block.sector);
+      return WRITE_TO_FLASH_ERROR;
+    }
+    const uint32_t erase_wait_us = micros() - erase_start;
+    
+    const uint32_t program_start = micros();
+    if( !this->program_sector_(block) ){
+      return WRITE_TO_FLASH_ERROR;
+    }
+    const uint32_t program_us = micros() - program_start;
+    
+    {
+      LockGuard lock(this->counters_lock_);
+      this->counters_.bytes_programmed += block.length;
+      this->counters_.program_us += program_us;
+      this->counters_.erase_wait_us += erase_wait_us;
+      if( !this->skip_unchanged_sectors_ || this->use_manifest_ ){
+        this->counters_.starved_us += starved_us;
+      }
+    }
+    this->bytes_flashed_ += block.length;
+    const uint32_t sector = block.sector;
+    xQueueSend(this->free_blocks_, &index, portMAX_DELAY);
+    
+    erase_next = this->next_sector_to_erase_(sector);
+    if( erase_next >= 0 && !this->erase_sectors_from_(erase_next) ){
+      return WRITE_TO_FLASH_ERROR;
+    }
+  }
+  
+  return FLASHER_OK;
+}
 
+size_t XMOSFlasher::sector_length_(size_t sector) const {
+  return std::min(FLASH_SECTOR_SIZE, this->total_number_of_bytes_ - sector * FLASH_SECTOR_SIZE);
+}
 
-int XMOSFlasher::flashing_step_(){
+bool XMOSFlasher::erase_sectors_from_(size_t sector){
+  if( sector * FLASH_SECTOR_SIZE < this->erase_pos_ ){
+    return true;  // erased along with an earlier sector
+  }
+  
+  // Coalesce the run of sectors that will all be programmed into as few erases as their alignment allows
+  size_t run_end = sector + 1;
+  if( !this->skip_unchanged_sectors_ || this->use_manifest_ ){
+    while( run_end < this->sector_changed_.size() && this->sector_changed_[run_end] ){
+      run_end++;
+    }
+  }
+  if( !this->start_erase_(sector * FLASH_SECTOR_SIZE, run_end * FLASH_SECTOR_SIZE) ){
+    return false;
+  }
+  LockGuard lock(this->counters_lock_);
+  this->counters_.erases++;
+  return true;
+}
 
-  // read a maximum of chunk_size bytes into buf. (real read size returned)
-  int bytes_read = this->reader_->read_image_block( this->reader_buffer_, FLASH_PAGE_SIZE);  
-  if( bytes_read < 0 ){
-    ESP_LOGE(TAG, "Stream closed");
-    this->error_code = CONNECTION_ERROR;
+int XMOSFlasher::next_sector_to_erase_(int sector) const {
+  if( this->skip_unchanged_sectors_ && !this->use_manifest_ ){
+    // Erasing ahead would destroy the contents the sector's data is compared with
     return -1;
   }
+  for( size_t next = sector + 1; next < this->sector_changed_.size(); next++ ){
+    if( this->sector_changed_[next] ){
+      return next;
+    }
+  }
+  return -1;
+}
+
+bool XMOSFlasher::sector_matches_flash_(const uint8_t *data, uint32_t sector, size_t length){
+  this->read_data_(sector * FLASH_SECTOR_SIZE, this->sector_buffer_, length);
+  return memcmp(data, this->sector_buffer_, length) == 0;
+}
+
+void XMOSFlasher::scan_unchanged_sectors_(){
+  const uint32_t scan_start = micros();
+  uint32_t unchanged_sectors = 0;
+  
+  for( size_t sector = 0; sector < this->sector_changed_.size(); sector++ ){
+    if( this->abort_pipeline_ ){
+      return;
+    }
+    const size_t sector_length = this->sector_length_(sector);
+    this->read_data_(sector * FLASH_SECTOR_SIZE, this->sector_buffer_, sector_length);
+    
+    md5::MD5Digest sector_digest;
+    sector_digest.init();
+    sector_digest.add(this->sector_buffer_, sector_length);
+    sector_digest.calculate();
+    if( sector_digest.equals_bytes(this->sector_hashes_[sector].data()) ){
+      this->sector_changed_[sector] = false;
+      this->bytes_flashed_ += sector_length;
+      unchanged_sectors++;
+    }
+  }
+  
+  ESP_LOGI(TAG, "%" PRIu32 " of %u sectors are unchanged", unchanged_sectors, (unsigned) this->sector_changed_.size());
+  LockGuard lock(this->counters_lock_);
+  this->counters_.sectors_skipped += unchanged_sectors;
+  this->counters_.compare_us += micros() - scan_start;
+}
+
+bool XMOSFlasher::fetch_sector_manifest_(){
+  ESP_LOGI(TAG, "Fetching sector manifest: %s", this->sector_manifest_url_.c_str());
+  this->sector_hashes_.clear();
+  this->manifest_image_md5_.clear();
+  
+  auto container = this->http_request_->get(this->sector_manifest_url_);
+  if( container == nullptr ){
+    return false;
+  }
   
-  this->md5_receive_.add(this->reader_buffer_, bytes_read);
-  this->bytes_remaining_ -= bytes_read;
-  if( bytes_read != FLASH_PAGE_SIZE ){
-    if( this->bytes_remaining_ != 0 ){
-      this->error_code = CONNECTION_ERROR;
-      return -1;
+  this->sector_hashes_.reserve(this->total_sectors_to_erase_);
+  char line[MD5_SIZE];
+  size_t line_length = 0;
+  bool valid = true;
+  uint8_t chunk[128];
+  uint32_t last_data_received = millis();
+  while( valid && container->get_bytes_read() < container->content_length ){
+    int bytes_read = container->read(chunk, sizeof(chunk));
+    if( bytes_read < 0 || (millis() - last_data_received) > READER_STALL_TIMEOUT_MS ){
+      valid = false;
+      break;
+    }
+    if( bytes_read > 0 ){
+      last_data_received = millis();
+    }
+    for( int i = 0; valid && i < bytes_read; i++ ){
+      const char c = chunk[i];
+      if( c == '\n' ){
+        valid = this->add_manifest_line_(line, line_length);
+        line_length = 0;
+      } else if( c != '\r' && line_length == MD5_SIZE ){
+        valid = false;
+      } else if( c != '\r' ){
+        line[line_length++] = c;
+      }
     }
-    // it's the last page to flash
-    // fill it up with zeros
-    memset(this->reader_buffer_ + bytes_read, 0, FLASH_PAGE_SIZE - bytes_read);       
+    App.feed_wdt();
+    yield();
   }
+  container->end();
   
-  int page_pos = this->page_pos_;
-  if( !this->write_page_(page_pos, this->reader_buffer_) ){
+  if( !valid || !this->add_manifest_line_(line, line_length) ){
+    ESP_LOGE(TAG, "Sector manifest is malformed");
+    return false;
+  }
+  if( this->sector_hashes_.size() != this->total_sectors_to_erase_ ){
+    ESP_LOGE(TAG, "Sector manifest lists %u sectors, the image has %u", (unsigned) this->sector_hashes_.size(),
+             (unsigned) this->total_sectors_to_erase_);
+    return false;
+  }
+  if( strncasecmp(this->manifest_image_md5_.c_str(), this->md5_expected_.c_str(), MD5_SIZE) != 0 ){
+    ESP_LOGE(TAG, "Sector manifest is for a different image (MD5 %s)", this->manifest_image_md5_.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool XMOSFlasher::add_manifest_line_(const char *line, size_t length){
+  if( length == 0 ){
+    return true;
+  }
+  if( length != MD5_SIZE ){
+    return false;
+  }
+  if( this->manifest_image_md5_.empty() ){
+    this->manifest_image_md5_.assign(line, MD5_SIZE);
+    return true;
+  }
+  std::array<uint8_t, 16> hash;
+  if( !parse_hex(line, MD5_SIZE, hash.data(), hash.size()) ){
+    return false;
+  }
+  this->sector_hashes_.push_back(hash);
+  return true;
+}
+
+bool XMOSFlasher::program_page_(uint32_t page_pos, const uint8_t *data){
+  if( !this->write_page_(page_pos, data) ){
       ESP_LOGE(TAG, "Error while writing page %d, retrying...", page_pos);
   }
     
   //read back the page that has just been written
+  const uint32_t verify_start = micros();
   this->read_page_(page_pos, this->compare_buffer_ );
+  const bool verified = memcmp(data, this->compare_buffer_, FLASH_PAGE_SIZE) == 0;
+  {
+    LockGuard lock(this->counters_lock_);
+    this->counters_.verify_us += micros() - verify_start;
+    if( !verified ){
+      this->counters_.program_retries++;
+    }
+  }
   
-  if (memcmp(this->reader_buffer_, this->compare_buffer_, FLASH_PAGE_SIZE) != 0){
+  if( !verified ){
     // not equal, give it a second try
-    if( !this->write_page_(page_pos, this->reader_buffer_ )){
+    if( !this->write_page_(page_pos, data )){
       ESP_LOGE(TAG, "Error while writing page %d, giving up...", page_pos);
-      this->error_code = WRITE_TO_FLASH_ERROR;
-      return -1;
+      return false;
     } 
     
     this->read_page_(page_pos, this->compare_buffer_ );
-    if (memcmp(this->reader_buffer_, this->compare_buffer_, FLASH_PAGE_SIZE) != 0){
+    if (memcmp(data, this->compare_buffer_, FLASH_PAGE_SIZE) != 0){
       ESP_LOGE(TAG, "Read page mismatch, page addr: %d", page_pos );
-      this->error_code = WRITE_TO_FLASH_ERROR;
-      return -1;
+      return false;
     }  
   }
+  return true;
+}
 
-  this->page_pos_ += FLASH_PAGE_SIZE;
-  
-  if( this->bytes_remaining_ == 0){
-    std::unique_ptr<char[]> md5_receive_str(new char[33]);
-    this->md5_receive_.calculate();
-    this->md5_receive_.get_hex(md5_receive_str.get());
-    this->md5_computed_ = md5_receive_str.get();
-  
-    if( strncmp(this->md5_computed_.c_str(), this->md5_expected_.c_str(), MD5_SIZE) != 0 ) {
-      ESP_LOGE(TAG, "MD5 computed: %s - Aborting due to MD5 mismatch", this->md5_computed_.c_str());
-      this->error_code = MD5_MISMATCH_ERROR;
-      return -1; 
-    } else {
-      ESP_LOGD(TAG, "MD5 computed: %s - Matches!", this->md5_computed_.c_str());
+bool XMOSFlasher::program_sector_(const ImageBlock &block){
+  const uint32_t sector_addr = block.sector * FLASH_SECTOR_SIZE;
+  if( this->verify_mode_ == VERIFY_PAGE_COMPARE ){
+    for( size_t offset = 0; offset < block.length; offset += FLASH_PAGE_SIZE ){
+      if( !this->program_page_(sector_addr + offset, block.data + offset) ){
+        return false;
+      }
     }
+    return true;
   }
   
-  return this->bytes_remaining_;
+  const size_t padded_length = (block.length + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1);
+  for( uint8_t attempt = 0; ; attempt++ ){
+    bool written = true;
+    for( size_t offset = 0; written && offset < padded_length; offset += FLASH_PAGE_SIZE ){
+      written = this->write_page_(sector_addr + offset, block.data + offset);
+    }
+    
+    const uint32_t verify_start = micros();
+    const bool verified = written && this->read_crc32_(sector_addr, padded_length) == block.crc;
+    {
+      LockGuard lock(this->counters_lock_);
+      this->counters_.verify_us += micros() - verify_start;
+    }
+    if( verified ){
+      return true;
+    }
+    if( attempt > 0 ){
+      ESP_LOGE(TAG, "Sector %u doesn't match after programming it again, giving up...", (unsigned) block.sector);
+      return false;
+    }
+    
+    ESP_LOGW(TAG, "Sector %u doesn't match after programming, erasing and programming it again", (unsigned) block.sector);
+    {
+      LockGuard lock(this->counters_lock_);
+      this->counters_.program_retries++;
+    }
+    // Pages can't be fixed by programming them again if bits were cleared that shouldn't be, so erase the sector first.
+    // Keeps the end of the erases issued so far, which already covers this sector.
+    const uint32_t erase_pos = this->erase_pos_;
+    if( !this->start_erase_(sector_addr, sector_addr + FLASH_SECTOR_SIZE) ||
+        !this->wait_while_flash_busy_(this->erase_timeout_ms_, true) ){
+      ESP_LOGE(TAG, "Erasing sector %u again failed", (unsigned) block.sector);
+      return false;
+    }
+    this->erase_pos_ = erase_pos;
+  }
 }
 
+uint32_t XMOSFlasher::read_crc32_(uint32_t byte_addr, size_t len){
+  uint32_t crc = 0;
+  this->enable();
+  this->send_address_command_(FLASH_CMD_FAST_READ, byte_addr);
+  this->transfer_byte(0x00);
+  for( size_t offset = 0; offset < len; offset += FLASH_READ_CHUNK_SIZE ){
+    const size_t chunk = std::min(len - offset, FLASH_READ_CHUNK_SIZE);
+    this->read_array(this->compare_buffer_, chunk);
+    crc = esp_rom_crc32_le(crc, this->compare_buffer_, chunk);
+  }
+  this->disable();
+  return crc;
+}
 
+FlashingCounters XMOSFlasher::get_flashing_counters() const {
+  LockGuard lock(this->counters_lock_);
+  return this->counters_;
+}
+
+void XMOSFlasher::log_flashing_counters_(){
+  const FlashingCounters counters = this->get_flashing_counters();
+  ESP_LOGD(TAG, "  download: %" PRIu32 " kB/s, md5: %" PRIu32 " kB/s, program: %" PRIu32 " kB/s",
+           FlashingCounters::kbytes_per_second(counters.bytes_downloaded, counters.download_us),
+           FlashingCounters::kbytes_per_second(counters.bytes_downloaded, counters.hash_us),
+           FlashingCounters::kbytes_per_second(counters.bytes_programmed, counters.program_us));
+  ESP_LOGD(TAG, "  waited %" PRIu32 " ms for %" PRIu32 " erases, %" PRIu32 " ms for data, total %" PRIu32 " s",
+           counters.erase_wait_us / 1000, counters.erases, counters.starved_us / 1000,
+           (millis() - this->flashing_start_time_) / 1000);
+  if( this->skip_unchanged_sectors_ || this->use_manifest_ ){
+    ESP_LOGD(TAG, "  skipped %" PRIu32 " unchanged sectors, comparing took %" PRIu32 " ms", counters.sectors_skipped,
+             counters.compare_us / 1000);
+  }
+}
 
 
 }
-}
\ No newline at end of file
+}
@@ -4,9 +4,19 @@
 #include "esphome/components/ota/ota_backend.h"
 #include "esphome/components/spi/spi.h"
 #include "esphome/components/md5/md5.h"
+#include "esphome/core/helpers.h"
 
 #include "esphome/components/memory_flasher/memory_flasher.h"
 #include "esphome/components/satellite1/satellite1.h"
+#include "spi_nor_simulator.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <array>
+#include <atomic>
+#include <vector>
 
 namespace esphome {
 using namespace memory_flasher;
@@ -14,6 +24,42 @@ namespace satellite1 {
 
 
 
+struct FlashingCounters {
+  /* Counters of the pipelined flasher's stages, logged with every progress update.
+   *
+   *  - download_us and hash_us are spent in the reader task, program_us in the writer task.
+   *  - erase_wait_us is how long the writer waited for erases it issued before the sectors' data arrived; erases
+   *    counts them, with runs of sectors coalesced into 32/64 KB block erases.
+   *  - starved_us is how long the writer waited for the reader to fill a block.
+   *  - sectors_skipped counts sectors that already held the image data, compare_us is the time spent finding them.
+   *  - program_retries counts pages (page verification) or sectors (sector verification) programmed a second time
+   *    because reading them back didn't match; verify_us is the time spent reading back.
+   */
+  uint32_t bytes_downloaded{0};
+  uint32_t download_us{0};
+  uint32_t hash_us{0};
+  uint32_t bytes_programmed{0};
+  uint32_t program_us{0};
+  uint32_t erase_wait_us{0};
+  uint32_t starved_us{0};
+  uint32_t erases{0};
+  uint32_t sectors_skipped{0};
+  uint32_t compare_us{0};
+  uint32_t program_retries{0};
+  uint32_t verify_us{0};
+
+  static uint32_t kbytes_per_second(uint32_t bytes, uint32_t us) {
+    return us ? (uint64_t) bytes * 1000 / us : 0;
+  }
+};
+
+
+enum FlashVerifyMode : uint8_t {
+  VERIFY_SECTOR_CRC = 0,  // programs a whole sector, then compares the CRC32 of a single read back pass
+  VERIFY_PAGE_COMPARE,    // reads back and compares every page right after programming it
+};
+
+
 class XMOSFlasher : public MemoryFlasher, public Satellite1SPIService {
 public:
   void loop() override;
@@ -27,50 +73,160 @@ public:
   void flash_embedded_image() override;
   
   bool flash_accessible() override { 
-      this->parent_->set_spi_flash_direct_access_mode(true);
+      this->set_direct_access_mode_(true);
       bool got_id =  this->read_JEDECID_();
-      this->parent_->set_spi_flash_direct_access_mode(false);
+      this->set_direct_access_mode_(false);
       return got_id;
   }
+
+  /// @brief Returns a copy of the counters of the current or last image flash
+  FlashingCounters get_flashing_counters() const;
   
+  void set_verify_mode(FlashVerifyMode verify_mode) { this->verify_mode_ = verify_mode; }
+  
+#ifdef USE_XMOS_FLASH_SIMULATOR
+  /// @brief Flashes the simulated flash instead of the XMOS flash, e.g., for benchmarks without a Satellite1 HAT
+  void set_flash_simulator(SPINorSimulator *simulator) { this->simulator_ = simulator; }
+#endif
+
 
 protected:
+  struct ImageBlock {
+    uint8_t *data{nullptr};
+    size_t length{0};
+    uint32_t sector{0};
+    uint32_t crc{0};  // of the data padded to whole pages, for sector verification
+  };
+  
+  /// @brief Hands the flash's SPI bus to the ESP32 or back to the XMOS
+  void set_direct_access_mode_(bool enable);
+  
+#ifdef USE_XMOS_FLASH_SIMULATOR
+  // The SPI service's calls go to the simulator if one is set
+  uint8_t transfer_byte(uint8_t byte) {
+    return this->simulator_ ? this->simulator_->transfer_byte(byte) : Satellite1SPIService::transfer_byte(byte);
+  }
+  void transfer_array(uint8_t *data, size_t length) {
+    this->simulator_ ? this->simulator_->transfer_array(data, length) : Satellite1SPIService::transfer_array(data, length);
+  }
+  void write_array(const uint8_t *data, size_t length) {
+    this->simulator_ ? this->simulator_->write_array(data, length) : Satellite1SPIService::write_array(data, length);
+  }
+  void read_array(uint8_t *data, size_t length) {
+    this->simulator_ ? this->simulator_->read_array(data, length) : Satellite1SPIService::read_array(data, length);
+  }
+  void enable() { this->simulator_ ? this->simulator_->enable() : Satellite1SPIService::enable(); }
+  void disable() { this->simulator_ ? this->simulator_->disable() : Satellite1SPIService::disable(); }
+  SPINorSimulator *simulator_{nullptr};
+#endif
+  
   bool read_JEDECID_();
   bool enable_writing_();
   bool disable_writing_();
   bool chip_erase_();
-  bool erase_sector_(int sector);
-  bool wait_while_flash_busy_(uint32_t timeout_ms);
+  /// @brief Starts the largest erase that begins at `byte_addr`, is aligned to its size, and ends at or before
+  /// `end_addr`: a 64 KB block, a 32 KB block, or a single 4 KB sector. Returns without waiting for the erase.
+  bool start_erase_(uint32_t byte_addr, uint32_t end_addr);
+  bool wait_while_flash_busy_(uint32_t timeout_ms, bool yield_while_busy = false);
   bool read_page_( uint32_t byte_addr, uint8_t* buffer );
-  bool write_page_( uint32_t byte_addr, uint8_t* buffer );
+  bool write_page_( uint32_t byte_addr, const uint8_t* buffer );
+  /// @brief Programs a page and verifies it by reading it back, retrying once on a mismatch
+  bool program_page_(uint32_t page_pos, const uint8_t *data);
+  /// @brief Programs a block's sector and verifies it as configured. With sector verification, a mismatching sector
+  /// is erased and programmed once more.
+  bool program_sector_(const ImageBlock &block);
+  /// @brief Returns the CRC32 of the flash contents, read in a single fast read
+  uint32_t read_crc32_(uint32_t byte_addr, size_t len);
+  bool read_data_( uint32_t byte_addr, uint8_t* buffer, size_t len );
+  uint8_t read_status_();
+  /// @brief Sends a command followed by a 24 bit address; the caller asserts and releases CS.
+  void send_address_command_(uint8_t cmd, uint32_t byte_addr);
   
   uint8_t manufacturerID_;
   uint8_t memoryTypeID_;
   uint8_t capacityID_;
-  int32_t capacity_;
-  size_t total_number_of_sectors_;
+  uint32_t capacity_{0};
+  size_t total_number_of_sectors_{0};
 
   bool init_flashing_();
   void deinit_flashing_();
-  int flashing_step_();
   int erasing_step_();
   void publish_progress_() override;
+  void log_flashing_counters_();
+
+  /* Images are flashed by two tasks passing sector sized blocks back and forth: the reader task downloads and
+   * hashes a block while the writer task programs the other one, and the writer issues each sector's erase
+   * before waiting for its data.
+   */
+  static void reader_task_(void *params);
+  static void writer_task_(void *params);
+  FlasherError read_image_();
+  FlasherError write_image_();
+  /// @brief Waits for a block index from `queue`; returns false if the pipeline was aborted meanwhile
+  bool receive_block_(QueueHandle_t queue, uint8_t *index);
+  /// @brief Records the first error and makes both pipeline tasks exit
+  void fail_pipeline_(FlasherError error);
+  
+  /* Differential flashing: with skip_unchanged_sectors, the writer reads every sector before erasing it and skips the
+   * sectors that already hold the incoming data. With a sector manifest, the writer hashes the flash contents before
+   * anything is downloaded, so the reader only downloads the sectors that differ.
+   *
+   * The manifest is a text file with one MD5 hex digest per line: first the whole image's, then one for every 4 KB
+   * sector of the image, where the last sector is hashed without padding.
+   */
+  bool fetch_sector_manifest_();
+  bool add_manifest_line_(const char *line, size_t length);
+  void scan_unchanged_sectors_();
+  bool sector_matches_flash_(const uint8_t *data, uint32_t sector, size_t length);
+  /// @brief Returns the next sector after `sector` to erase ahead of its data, or -1 if there is none or it can only
+  /// be decided once the data arrived
+  int next_sector_to_erase_(int sector) const;
+  /// @brief Erases `sector` unless an earlier erase covered it, coalescing it with the following sectors to program
+  bool erase_sectors_from_(size_t sector);
+  size_t sector_length_(size_t sector) const;
+  
+  FlashVerifyMode verify_mode_{VERIFY_SECTOR_CRC};
   
   bool http_flash_{false};
   bool embedded_flash_{false};
-  FlashImageReader* reader_;
+  FlashImageReader* reader_{nullptr};
   md5::MD5Digest md5_receive_;
   
+  HighFrequencyLoopRequester high_freq_;
   uint32_t flashing_start_time_{0};
   uint32_t last_published_{0};
   size_t total_sectors_to_erase_{0};
-  int current_sector_{-1};
+  
+  uint32_t erase_pos_{0};         // end of the last erase issued
+  uint32_t erase_done_pos_{0};    // end of the last erase known to be finished, for full erases
+  uint32_t erase_end_pos_{0};     // end of the full erase
+  uint32_t erase_started_{0};
+  uint32_t erase_timeout_ms_{0};  // of the last erase issued
+  bool erase_in_progress_{false};
   size_t total_number_of_bytes_{0};
-  size_t bytes_remaining_;
-  int page_pos_{0};
   
-  uint8_t* reader_buffer_;
-  uint8_t* compare_buffer_;
+  static const uint8_t NUMBER_OF_BLOCKS = 2;
+  static const uint8_t END_OF_IMAGE = 0xFF;  // sent instead of a block index once the reader is done
+  ImageBlock blocks_[NUMBER_OF_BLOCKS];
+  QueueHandle_t free_blocks_{nullptr};
+  QueueHandle_t filled_blocks_{nullptr};
+  uint8_t* compare_buffer_{nullptr};
+  uint8_t* sector_buffer_{nullptr};
+  
+  bool use_manifest_{false};
+  std::string manifest_image_md5_{};
+  std::vector<std::array<uint8_t, 16>> sector_hashes_;
+  std::vector<bool> sector_changed_;
+  std::atomic<bool> scan_done_{false};
+  
+  std::atomic<bool> reader_task_running_{false};
+  std::atomic<bool> writer_task_running_{false};
+  std::atomic<bool> abort_pipeline_{false};
+  std::atomic<FlasherError> pipeline_error_{FLASHER_OK};
+  std::atomic<size_t> bytes_flashed_{0};
+  
+  FlashingCounters counters_;
+  mutable Mutex counters_lock_;
 
 };
 
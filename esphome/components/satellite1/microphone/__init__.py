@@ -26,6 +26,7 @@ from esphome.components.i2s_audio import (
     register_i2s_reader
 )
 
+AUTO_LOAD = ["audio"]
 CODEOWNERS = ["@gnumpi"]
 DEPENDENCIES = ["i2s_audio"]
 
@@ -33,10 +34,42 @@ CONF_ADC_PIN = "adc_pin"
 CONF_AMPLIFY_SHIFT = "amplify_shift"
 CONF_CHANNEL_0 = "channel_0"
 CONF_CHANNEL_1 = "channel_1"
+CONF_CHANNELS = "channels"
+CONF_DMA_BUFFER_COUNT = "dma_buffer_count"
+CONF_DMA_BUFFER_LENGTH = "dma_buffer_length"
+CONF_LOW_LATENCY = "low_latency"
+CONF_READ_BLOCK_DURATION = "read_block_duration"
+CONF_READ_TIMEOUT = "read_timeout"
+CONF_RING_BUFFER_DURATION = "ring_buffer_duration"
 CONF_PDM = "pdm"
 CONF_SAMPLE_RATE = "sample_rate"
+CONF_SLOT = "slot"
 CONF_USE_APLL = "use_apll"
 
+# The XMOS sends 16 kHz frames of six slots, packed into the 48 kHz stereo I2S stream
+NUMBER_OF_SLOTS = 6
+
+# The legacy I2S driver limits a DMA buffer to 4092 bytes, 511 frames of 32 bit stereo audio
+MAX_DMA_BUFFER_LENGTH = 511
+
+# Capture settings without and with low_latency; the low latency mode reads 2-5 ms blocks
+CAPTURE_DEFAULTS = {
+    False: {
+        CONF_DMA_BUFFER_COUNT: 4,
+        CONF_DMA_BUFFER_LENGTH: 240,
+        CONF_READ_BLOCK_DURATION: "20ms",
+        CONF_READ_TIMEOUT: "15ms",
+        CONF_RING_BUFFER_DURATION: "180ms",
+    },
+    True: {
+        CONF_DMA_BUFFER_COUNT: 8,
+        CONF_DMA_BUFFER_LENGTH: 96,
+        CONF_READ_BLOCK_DURATION: "4ms",
+        CONF_READ_TIMEOUT: "5ms",
+        CONF_RING_BUFFER_DURATION: "180ms",
+    },
+}
+
 
 nabu_microphone_ns = cg.esphome_ns.namespace("nabu_microphone")
 
@@ -75,15 +108,94 @@ CONFIG_SCHEMA = cv.Schema(
         cv.Optional(CONF_USE_APLL, default=False): cv.boolean,
         cv.Optional(CONF_CHANNEL_0): MICROPHONE_CHANNEL_SCHEMA,
         cv.Optional(CONF_CHANNEL_1): MICROPHONE_CHANNEL_SCHEMA,
+        cv.Optional(CONF_CHANNELS): cv.ensure_list(
+            MICROPHONE_CHANNEL_SCHEMA.extend(
+                {
+                    cv.Required(CONF_SLOT): cv.int_range(min=0, max=NUMBER_OF_SLOTS - 1),
+                }
+            )
+        ),
         
         cv.Required(CONF_I2S_DIN_PIN): pins.internal_gpio_input_pin_number,
         cv.Required(CONF_PDM): cv.boolean,
         cv.Optional(CONF_FIXED_SETTINGS, default=True): cv.boolean,
-    
+
+        cv.Optional(CONF_LOW_LATENCY, default=False): cv.boolean,
+        cv.Optional(CONF_DMA_BUFFER_COUNT): cv.int_range(min=2, max=128),
+        cv.Optional(CONF_DMA_BUFFER_LENGTH): cv.int_range(min=8, max=MAX_DMA_BUFFER_LENGTH),
+        cv.Optional(CONF_READ_BLOCK_DURATION): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(min=cv.TimePeriod(milliseconds=2), max=cv.TimePeriod(milliseconds=100)),
+        ),
+        cv.Optional(CONF_READ_TIMEOUT): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(min=cv.TimePeriod(milliseconds=1), max=cv.TimePeriod(milliseconds=1000)),
+        ),
+        cv.Optional(CONF_RING_BUFFER_DURATION): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(min=cv.TimePeriod(milliseconds=10), max=cv.TimePeriod(milliseconds=1000)),
+        ),
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
 
+def _set_capture_defaults(config):
+    defaults = CAPTURE_DEFAULTS[config[CONF_LOW_LATENCY]]
+    for key, value in defaults.items():
+        if key not in config:
+            if key in (CONF_DMA_BUFFER_COUNT, CONF_DMA_BUFFER_LENGTH):
+                config[key] = value
+            else:
+                config[key] = cv.positive_time_period_milliseconds(value)
+    return config
+
+
+def _channel_slots(config):
+    """Returns (slot, channel config) for every configured channel; channel_0 and channel_1 are slots 0 and 1."""
+    slots = []
+    if channel_0_config := config.get(CONF_CHANNEL_0):
+        slots.append((0, channel_0_config))
+    if channel_1_config := config.get(CONF_CHANNEL_1):
+        slots.append((1, channel_1_config))
+    for channel_config in config.get(CONF_CHANNELS, []):
+        slots.append((channel_config[CONF_SLOT], channel_config))
+    return slots
+
+
+def _validate_channel_slots(config):
+    used_slots = set()
+    for slot, _ in _channel_slots(config):
+        if slot in used_slots:
+            raise cv.Invalid(f"Slot {slot} is used by more than one microphone channel.")
+        used_slots.add(slot)
+    return config
+
+
+def _validate_capture_settings(config):
+    read_block_ms = config[CONF_READ_BLOCK_DURATION].total_milliseconds
+    if config[CONF_LOW_LATENCY] and not 2 <= read_block_ms <= 5:
+        raise cv.Invalid(
+            f"{CONF_READ_BLOCK_DURATION} must be between 2 ms and 5 ms with {CONF_LOW_LATENCY} enabled."
+        )
+
+    dma_buffer_ms = config[CONF_DMA_BUFFER_LENGTH] * 1000 / config[CONF_SAMPLE_RATE]
+    if config[CONF_READ_TIMEOUT].total_milliseconds < dma_buffer_ms:
+        raise cv.Invalid(
+            f"{CONF_READ_TIMEOUT} must be at least the duration of one DMA buffer ({dma_buffer_ms:.1f} ms)."
+        )
+
+    if config[CONF_RING_BUFFER_DURATION].total_milliseconds < 2 * read_block_ms:
+        raise cv.Invalid(
+            f"{CONF_RING_BUFFER_DURATION} must hold at least two read blocks ({2 * read_block_ms} ms)."
+        )
+    return config
+
+
+CONFIG_SCHEMA = cv.All(
+    CONFIG_SCHEMA, _set_capture_defaults, _validate_capture_settings, _validate_channel_slots
+)
+
+
 def _supported_satellite1_settings(config):
     if config[CONF_PDM] :
         raise cv.Invalid("PDM is not supported for the Satellite1 microphone integration.")
@@ -104,22 +216,20 @@ async def to_code(config):
 
     await cg.register_parented(var, config[CONF_I2S_AUDIO_ID])
 
-    if channel_0_config := config.get(CONF_CHANNEL_0):
-        channel_0 = cg.new_Pvariable(channel_0_config[CONF_ID])
-        await cg.register_component(channel_0, channel_0_config)
-        await cg.register_parented(channel_0, config[CONF_ID])
-        await microphone.register_microphone(channel_0, channel_0_config)
-        cg.add(var.set_channel_0(channel_0))
-        cg.add(channel_0.set_amplify_shift(channel_0_config[CONF_AMPLIFY_SHIFT]))
-
-    if channel_1_config := config.get(CONF_CHANNEL_1):
-        channel_1 = cg.new_Pvariable(channel_1_config[CONF_ID])
-        await cg.register_component(channel_1, channel_1_config)
-        await cg.register_parented(channel_1, config[CONF_ID])
-        await microphone.register_microphone(channel_1, channel_1_config)
-        cg.add(var.set_channel_1(channel_1))
-        cg.add(channel_1.set_amplify_shift(channel_1_config[CONF_AMPLIFY_SHIFT]))
+    for slot, channel_config in _channel_slots(config):
+        channel = cg.new_Pvariable(channel_config[CONF_ID])
+        await cg.register_component(channel, channel_config)
+        await cg.register_parented(channel, config[CONF_ID])
+        await microphone.register_microphone(channel, channel_config)
+        cg.add(var.set_channel(slot, channel))
+        cg.add(channel.set_amplify_shift(channel_config[CONF_AMPLIFY_SHIFT]))
 
     await register_i2s_reader(var, config)
 
+    cg.add(var.set_dma_buf_count(config[CONF_DMA_BUFFER_COUNT]))
+    cg.add(var.set_dma_buf_len(config[CONF_DMA_BUFFER_LENGTH]))
+    cg.add(var.set_read_block_duration(config[CONF_READ_BLOCK_DURATION]))
+    cg.add(var.set_read_timeout(config[CONF_READ_TIMEOUT]))
+    cg.add(var.set_ring_buffer_duration(config[CONF_RING_BUFFER_DURATION]))
+
     cg.add_define("USE_OTA_STATE_CALLBACK")
@@ -2,40 +2,37 @@
 
 #ifdef USE_ESP32
 
-#include <driver/i2s.h>
+#include "esphome/components/audio/audio_sample_conversion.h"
 
 #include "esphome/core/hal.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
-#include "esphome/core/ring_buffer.h"
 
 #ifdef USE_OTA
 #include "esphome/components/ota/ota_backend.h"
 #endif
 
+#include <algorithm>
+
 namespace esphome {
 namespace nabu_microphone {
 
-static const size_t RING_BUFFER_LENGTH = 60;  // Measured in milliseconds
 static const size_t QUEUE_LENGTH = 10;
 
-static const size_t NUMBER_OF_CHANNELS = 2;
-static const size_t DMA_BUFFER_SIZE = 480; //10 ms chunks
-static const size_t DMA_BUFFERS_COUNT = 4;
-static const size_t FRAMES_IN_ALL_DMA_BUFFERS = DMA_BUFFER_SIZE * DMA_BUFFERS_COUNT;
-static const size_t SAMPLES_IN_ALL_DMA_BUFFERS = FRAMES_IN_ALL_DMA_BUFFERS * NUMBER_OF_CHANNELS;
+// Every XMOS frame of NUMBER_OF_SLOTS slots spans this many stereo frames of the I2S stream
+static const size_t I2S_FRAMES_PER_XMOS_FRAME = NUMBER_OF_SLOTS / 2;
 
-static const size_t TASK_DELAY_MS = 15;
+// The capture ring buffer stores one 16 bit sample for every slot per frame
+static const size_t CAPTURE_FRAME_SIZE = NUMBER_OF_SLOTS * sizeof(int16_t);
 
 // TODO:
-//   - Determine optimal buffer sizes (dma included)
 //   - Determine appropriate timeout durations for FreeRTOS operations
 //   - Test if stopping the microphone behaves properly
 
 // Notes on things taken out/removed:
 //   - Doesn't properly handle 16 bit samples
 //   - Removed the watch_ function and handling any callbacks
-//   - Channels are fixed to left and right for the XMOS chip
+//   - Channels are fixed to the slots of the XMOS output frame
 
 static const char *const TAG = "i2s_audio.microphone";
 
@@ -44,14 +41,39 @@ enum TaskNotificationBits : uint32_t {
   COMMAND_STOP = (1 << 1),   // stops the main task
 };
 
-void NabuMicrophoneChannel::setup() {
-  const size_t ring_buffer_size = RING_BUFFER_LENGTH * this->parent_->get_sample_rate() / 1000 * sizeof(int16_t);
-  this->ring_buffer_ = RingBuffer::create(ring_buffer_size);
-  if (this->ring_buffer_ == nullptr) {
-    ESP_LOGE(TAG, "Could not allocate ring buffer");
-    this->mark_failed();
-    return;
+size_t NabuMicrophoneChannel::read(int16_t *buf, size_t len, TickType_t ticks_to_wait) {
+  audio::SPMCRingBuffer *capture_ring_buffer = this->parent_->get_capture_ring_buffer();
+  if (capture_ring_buffer == nullptr) {
+    return 0;
   }
+
+  this->ring_buffer_high_water_ =
+      std::max(this->ring_buffer_high_water_, capture_ring_buffer->available(&this->reader_));
+
+  const uint8_t slot = this->slot_;
+  const size_t bytes_read = capture_ring_buffer->read(
+      &this->reader_, len / sizeof(int16_t) * CAPTURE_FRAME_SIZE, ticks_to_wait,
+      [buf, slot](const uint8_t *span, size_t bytes, size_t offset) {
+        const int16_t *frames = reinterpret_cast<const int16_t *>(span) + slot;
+        int16_t *samples = buf + offset / CAPTURE_FRAME_SIZE;
+        for (size_t i = 0; i < bytes / CAPTURE_FRAME_SIZE; ++i) {
+          samples[i] = frames[i * NUMBER_OF_SLOTS];
+        }
+      });
+
+  const size_t samples_read = bytes_read / CAPTURE_FRAME_SIZE;
+  if (this->is_muted_) {
+    std::fill_n(buf, samples_read, 0);
+  }
+  return samples_read * sizeof(int16_t);
+}
+
+void NabuMicrophoneChannel::reset() {
+  audio::SPMCRingBuffer *capture_ring_buffer = this->parent_->get_capture_ring_buffer();
+  if (capture_ring_buffer != nullptr) {
+    capture_ring_buffer->reset_reader(&this->reader_);
+  }
+  this->ring_buffer_high_water_ = 0;
 }
 
 void NabuMicrophoneChannel::loop() {
@@ -83,6 +105,15 @@ void NabuMicrophone::setup() {
 
   this->event_queue_ = xQueueCreate(QUEUE_LENGTH, sizeof(TaskEvent));
 
+  const size_t ring_buffer_size =
+      this->ring_buffer_duration_ms_ * (this->sample_rate_ / I2S_FRAMES_PER_XMOS_FRAME) / 1000 * CAPTURE_FRAME_SIZE;
+  this->capture_ring_buffer_ = audio::SPMCRingBuffer::create(ring_buffer_size, CAPTURE_FRAME_SIZE);
+  if (this->capture_ring_buffer_ == nullptr) {
+    ESP_LOGE(TAG, "Could not allocate ring buffer");
+    this->mark_failed();
+    return;
+  }
+
 #ifdef USE_OTA
   ota::get_global_ota_callback()->add_on_state_callback(
       [this](ota::OTAState state, float progress, uint8_t error, ota::OTAComponent *comp) {
@@ -99,21 +130,52 @@ void NabuMicrophone::setup() {
 #endif
 }
 
-void NabuMicrophone::mute() {
-  if (this->channel_0_ != nullptr) {
-    this->channel_0_->set_mute_state(true);
+void NabuMicrophone::dump_config() {
+  this->dump_i2s_settings();
+  ESP_LOGCONFIG(TAG, "  Read block: %" PRIu32 " ms, read timeout: %" PRIu32 " ms", this->read_block_duration_ms_,
+                this->read_timeout_ms_);
+  ESP_LOGCONFIG(TAG, "  Ring buffer: %" PRIu32 " ms", this->ring_buffer_duration_ms_);
+}
+
+CaptureCounters NabuMicrophone::get_capture_counters() const {
+  LockGuard lock(this->capture_counters_lock_);
+  return this->capture_counters_;
+}
+
+void NabuMicrophone::log_capture_counters() {
+  const CaptureCounters counters = this->get_capture_counters();
+  ESP_LOGD(TAG, "Capture: %" PRIu32 " reads, read average %" PRIu32 " us, max %" PRIu32 " us, DMA overflows %" PRIu32,
+           counters.reads, counters.read_us_average(), counters.read_us_max, counters.dma_overflows);
+
+  const uint32_t output_sample_rate = this->sample_rate_ / I2S_FRAMES_PER_XMOS_FRAME;
+  for (NabuMicrophoneChannel *channel : this->channels_) {
+    if (channel != nullptr) {
+      const uint32_t high_water_ms =
+          channel->get_ring_buffer_high_water() / CAPTURE_FRAME_SIZE * 1000 / output_sample_rate;
+      ESP_LOGD(TAG, "  Channel %u: %" PRIu32 " overruns, ring buffer high-water %" PRIu32 " ms", channel->get_slot(),
+               channel->get_overruns(), high_water_ms);
+    }
   }
-  if (this->channel_1_ != nullptr) {
-    this->channel_1_->set_mute_state(true);
+}
+
+void NabuMicrophone::set_channel(uint8_t slot, NabuMicrophoneChannel *microphone) {
+  this->channels_[slot] = microphone;
+  microphone->set_slot(slot);
+}
+
+void NabuMicrophone::mute() {
+  for (NabuMicrophoneChannel *channel : this->channels_) {
+    if (channel != nullptr) {
+      channel->set_mute_state(true);
+    }
   }
 }
 
 void NabuMicrophone::unmute() {
-  if (this->channel_0_ != nullptr) {
-    this->channel_0_->set_mute_state(false);
-  }
-  if (this->channel_1_ != nullptr) {
-    this->channel_1_->set_mute_state(false);
+  for (NabuMicrophoneChannel *channel : this->channels_) {
+    if (channel != nullptr) {
+      channel->set_mute_state(false);
+    }
   }
 }
 
@@ -148,42 +210,37 @@ void NabuMicrophone::read_task_(void *params) {
       event.type = TaskEventType::STARTING;
       xQueueSend(this_microphone->event_queue_, &event, portMAX_DELAY);
 
-      if ((this_microphone->channel_0_ != nullptr) && this_microphone->channel_0_->is_failed()) {
-        event.type = TaskEventType::WARNING;
-        event.err = ESP_ERR_INVALID_STATE;
-        xQueueSend(this_microphone->event_queue_, &event, portMAX_DELAY);
-        continue;
+      bool channel_failed = false;
+      // Slots without a channel are still captured for readers of the capture ring buffer, without amplification
+      std::array<uint8_t, NUMBER_OF_SLOTS> amplify_shifts{};
+      for (NabuMicrophoneChannel *channel : this_microphone->channels_) {
+        if (channel != nullptr) {
+          channel_failed |= channel->is_failed();
+          amplify_shifts[channel->get_slot()] = channel->get_amplify_shift();
+        }
       }
 
-      if ((this_microphone->channel_1_ != nullptr) && this_microphone->channel_1_->is_failed()) {
+      if (channel_failed) {
         event.type = TaskEventType::WARNING;
         event.err = ESP_ERR_INVALID_STATE;
         xQueueSend(this_microphone->event_queue_, &event, portMAX_DELAY);
         continue;
       }
 
+      // Read whole XMOS frames, so every block starts on the first slot
+      const size_t frames_per_read =
+          this_microphone->read_block_duration_ms_ * (this_microphone->sample_rate_ / I2S_FRAMES_PER_XMOS_FRAME) / 1000;
+      const size_t samples_per_read = frames_per_read * NUMBER_OF_SLOTS;
+
       // Note, if we have 16 bit samples incoming, this requires modification
       ExternalRAMAllocator<int32_t> allocator(ExternalRAMAllocator<int32_t>::ALLOW_FAILURE);
-      int32_t *buffer = allocator.allocate(SAMPLES_IN_ALL_DMA_BUFFERS);
-
-      std::vector<int16_t, ExternalRAMAllocator<int16_t>> channel_0_samples;
-      std::vector<int16_t, ExternalRAMAllocator<int16_t>> channel_1_samples;
+      int32_t *buffer = allocator.allocate(samples_per_read);
 
-      size_t channel_0_reserved_samples = 0;
-      size_t channel_1_reserved_samples = 0;
+      // Every slot is converted in one pass and written to the capture ring buffer with one write
+      std::vector<int16_t, ExternalRAMAllocator<int16_t>> capture_frames;
+      capture_frames.reserve(samples_per_read);
 
-      if (this_microphone->channel_0_ != nullptr) {
-        channel_0_reserved_samples = FRAMES_IN_ALL_DMA_BUFFERS;
-        channel_0_samples.reserve(channel_0_reserved_samples);
-      }
-
-      if (this_microphone->channel_1_ != nullptr) {
-        channel_1_reserved_samples = FRAMES_IN_ALL_DMA_BUFFERS;
-        channel_1_samples.reserve(channel_1_reserved_samples);
-      }
-
-      if ((buffer == nullptr) || (channel_0_samples.capacity() < channel_0_reserved_samples) ||
-          (channel_1_samples.capacity() < channel_1_reserved_samples)) {
+      if ((buffer == nullptr) || (capture_frames.capacity() < samples_per_read)) {
         event.type = TaskEventType::WARNING;
         event.err = ESP_ERR_NO_MEM;
         xQueueSend(this_microphone->event_queue_, &event, portMAX_DELAY);
@@ -194,11 +251,18 @@ void NabuMicrophone::read_task_(void *params) {
           event.err = err;
           xQueueSend(this_microphone->event_queue_, &event, portMAX_DELAY);
         } else {
-          // TODO: Is this the ideal spot to reset the ring buffers?
-          if (this_microphone->channel_0_ != nullptr)
-            this_microphone->channel_0_->get_ring_buffer()->reset();
-          if (this_microphone->channel_1_ != nullptr)
-            this_microphone->channel_1_->get_ring_buffer()->reset();
+          // TODO: Is this the ideal spot to reset the ring buffer readers?
+          for (NabuMicrophoneChannel *channel : this_microphone->channels_) {
+            if (channel != nullptr)
+              channel->reset();
+          }
+
+          // In duplex mode the driver may have been installed, and overflowing, before the microphone started
+          const uint32_t dma_overflows_at_start = this_microphone->parent_->get_rx_dma_overflows();
+          {
+            LockGuard lock(this_microphone->capture_counters_lock_);
+            this_microphone->capture_counters_ = CaptureCounters();
+          }
 
           event.type = TaskEventType::STARTED;
           xQueueSend(this_microphone->event_queue_, &event, portMAX_DELAY);
@@ -210,9 +274,19 @@ void NabuMicrophone::read_task_(void *params) {
             }
 
             size_t bytes_read;
-            esp_err_t err =
-                i2s_read(this_microphone->parent_->get_port(), buffer, DMA_BUFFER_SIZE * sizeof(int32_t) * 4,
-                         &bytes_read, pdMS_TO_TICKS(TASK_DELAY_MS));
+            const uint32_t read_start_us = micros();
+            esp_err_t err = this_microphone->read_i2s_data(buffer, samples_per_read * sizeof(int32_t), &bytes_read,
+                                                           pdMS_TO_TICKS(this_microphone->read_timeout_ms_));
+            const uint32_t read_duration_us = micros() - read_start_us;
+            const uint32_t dma_overflows = this_microphone->parent_->get_rx_dma_overflows() - dma_overflows_at_start;
+            {
+              LockGuard lock(this_microphone->capture_counters_lock_);
+              CaptureCounters &counters = this_microphone->capture_counters_;
+              ++counters.reads;
+              counters.read_us_total += read_duration_us;
+              counters.read_us_max = std::max(counters.read_us_max, read_duration_us);
+              counters.dma_overflows = dma_overflows;
+            }
             if (err != ESP_OK) {
               event.type = TaskEventType::WARNING;
               event.err = err;
@@ -222,43 +296,15 @@ void NabuMicrophone::read_task_(void *params) {
             if (bytes_read > 0) {
               // TODO: Handle 16 bits per sample, currently it won't allow that option at codegen stage
 
-              const size_t samples_read = bytes_read / sizeof(int32_t) / 3;
-              const size_t frames_read =
-                  samples_read / NUMBER_OF_CHANNELS;  // Left and right channel samples combine into 1 frame
-
-              uint8_t channel_0_shift = 16;
-              if (this_microphone->channel_0_ != nullptr) {
-                channel_0_shift -= this_microphone->channel_0_->get_amplify_shift();
-              }
-              uint8_t channel_1_shift = 16;
-              if (this_microphone->channel_1_ != nullptr) {
-                channel_1_shift -= this_microphone->channel_1_->get_amplify_shift();
-              }
-
-              for (size_t i = 0; i < frames_read; i++) {
-                int32_t channel_0_sample = 0;
-                if ((this_microphone->channel_0_ != nullptr) && (!this_microphone->channel_0_->get_mute_state())) {
-                  channel_0_sample = buffer[ 3 * NUMBER_OF_CHANNELS * i] >> channel_0_shift;
-                  channel_0_samples[i] = (int16_t) clamp<int32_t>(channel_0_sample, INT16_MIN, INT16_MAX);
-                }
-
-                int32_t channel_1_sample = 0;
-                if ((this_microphone->channel_1_ != nullptr) && (!this_microphone->channel_1_->get_mute_state())) {
-                  channel_1_sample = buffer[3 * NUMBER_OF_CHANNELS * i + 1] >> channel_1_shift;
-                  channel_1_samples[i] = (int16_t) clamp<int32_t>(channel_1_sample, INT16_MIN, INT16_MAX);
-                }
-              }
-
-              size_t bytes_to_write = frames_read * sizeof(int16_t);
-
-              if (this_microphone->channel_0_ != nullptr) {
-                this_microphone->channel_0_->get_ring_buffer()->write((void *) channel_0_samples.data(),
-                                                                      bytes_to_write);
-              }
-              if (this_microphone->channel_1_ != nullptr) {
-                this_microphone->channel_1_->get_ring_buffer()->write((void *) channel_1_samples.data(),
-                                                                      bytes_to_write);
-              }
+              const size_t frames_read = bytes_read / sizeof(int32_t) / NUMBER_OF_SLOTS;
+
+              // Channels are muted when they are read, so every reader of the capture ring buffer sees the unmuted
+              // audio
+              audio::convert_q31_frames_to_q15<NUMBER_OF_SLOTS>(buffer, capture_frames.data(), frames_read,
+                                                                amplify_shifts);
+
+              this_microphone->capture_ring_buffer_->write((void *) capture_frames.data(),
+                                                           frames_read * CAPTURE_FRAME_SIZE);
             }
 
             event.type = TaskEventType::RUNNING;
@@ -268,7 +314,7 @@ void NabuMicrophone::read_task_(void *params) {
           event.type = TaskEventType::STOPPING;
           xQueueSend(this_microphone->event_queue_, &event, portMAX_DELAY);
 
-          allocator.deallocate(buffer, SAMPLES_IN_ALL_DMA_BUFFERS);
+          allocator.deallocate(buffer, samples_per_read);
           
           this_microphone->uninstall_i2s_driver();
           this_microphone->release_i2s_access();
@@ -307,9 +353,16 @@ void NabuMicrophone::stop() {
 }
 
 void NabuMicrophone::loop() {
-  if ((this->channel_0_ != nullptr) && (this->channel_0_->get_requested_stop()) && (this->channel_1_ != nullptr) &&
-      (this->channel_1_->get_requested_stop())) {
-    // Both microphone channels have requested a stop
+  bool has_channels = false;
+  bool all_requested_stop = true;
+  for (NabuMicrophoneChannel *channel : this->channels_) {
+    if (channel != nullptr) {
+      has_channels = true;
+      all_requested_stop &= channel->get_requested_stop();
+    }
+  }
+  if (has_channels && all_requested_stop) {
+    // Every microphone channel has requested a stop
     this->stop();
   }
 
@@ -336,6 +389,7 @@ void NabuMicrophone::loop() {
       case TaskEventType::STOPPING:
         this->state_ = microphone::STATE_STOPPING;
         ESP_LOGD(TAG, "Stopping I2S Audio Microphone");
+        this->log_capture_counters();
         break;
       case TaskEventType::STOPPED:
         this->state_ = microphone::STATE_STOPPED;
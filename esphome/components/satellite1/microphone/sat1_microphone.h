@@ -5,10 +5,13 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 
+#include "esphome/components/audio/audio_spmc_ring_buffer.h"
 #include "esphome/components/i2s_audio/i2s_audio.h"
 #include "esphome/components/microphone/microphone.h"
 #include "esphome/core/component.h"
-#include "esphome/core/ring_buffer.h"
+#include "esphome/core/helpers.h"
+
+#include <array>
 
 namespace esphome {
 namespace nabu_microphone {
@@ -29,12 +32,31 @@ struct TaskEvent {
   esp_err_t err;
 };
 
+// The XMOS sends 16 kHz frames of six 32 bit slots, each carried as three stereo frames of the 48 kHz I2S stream
+static const uint8_t NUMBER_OF_SLOTS = 6;
+
+struct CaptureCounters {
+  /* Counters collected by the microphone task while it captures audio. Together with the channels' ring buffer
+   * high-water marks, they show the trade-off between the read block size, wake word latency, and CPU wakeups.
+   *
+   *  - reads counts the calls to i2s_read, so reads per second is the number of task wakeups per second.
+   *  - read_us_total and read_us_max measure how long i2s_read blocked, including waiting for the DMA to fill.
+   *  - dma_overflows counts the RX DMA buffers the driver dropped because the task didn't read them in time.
+   */
+  uint32_t reads{0};
+  uint64_t read_us_total{0};
+  uint32_t read_us_max{0};
+  uint32_t dma_overflows{0};
+
+  uint32_t read_us_average() const { return (this->reads == 0) ? 0 : this->read_us_total / this->reads; }
+};
+
 class NabuMicrophoneChannel;
 
 class NabuMicrophone : public i2s_audio::I2SReader, public Component {
  public:
   void setup() override;
-  void dump_config() override {this->dump_i2s_settings();}
+  void dump_config() override;
   void start();
   void stop();
 
@@ -43,15 +65,31 @@ class NabuMicrophone : public i2s_audio::I2SReader, public Component {
   void mute();
   void unmute();
 
-  void set_channel_0(NabuMicrophoneChannel *microphone) { this->channel_0_ = microphone; }
-  void set_channel_1(NabuMicrophoneChannel *microphone) { this->channel_1_ = microphone; }
-
-  NabuMicrophoneChannel *get_channel_0() { return this->channel_0_; }
-  NabuMicrophoneChannel *get_channel_1() { return this->channel_1_; }
+  /// @brief Exposes one slot of the XMOS output frame as a microphone channel
+  void set_channel(uint8_t slot, NabuMicrophoneChannel *microphone);
+  NabuMicrophoneChannel *get_channel(uint8_t slot) { return this->channels_[slot]; }
 
   bool is_running() { return this->state_ == microphone::STATE_RUNNING; }
   uint32_t get_sample_rate() { return this->sample_rate_; }
 
+  /// @brief Returns the ring buffer holding the captured frames, with one 16 bit sample per slot. Any number of
+  /// readers can consume it with their own SPMCRingBuffer::Reader.
+  audio::SPMCRingBuffer *get_capture_ring_buffer() { return this->capture_ring_buffer_.get(); }
+
+  void set_read_block_duration(uint32_t read_block_duration_ms) {
+    this->read_block_duration_ms_ = read_block_duration_ms;
+  }
+  void set_read_timeout(uint32_t read_timeout_ms) { this->read_timeout_ms_ = read_timeout_ms; }
+  void set_ring_buffer_duration(uint32_t ring_buffer_duration_ms) {
+    this->ring_buffer_duration_ms_ = ring_buffer_duration_ms;
+  }
+
+  /// @brief Returns a copy of the capture counters. Safe to call while the microphone is running.
+  CaptureCounters get_capture_counters() const;
+
+  /// @brief Logs the capture counters and every channel's overruns and ring buffer high-water mark
+  void log_capture_counters();
+
  protected:
   esp_err_t start_i2s_driver_();
 
@@ -62,14 +100,20 @@ class NabuMicrophone : public i2s_audio::I2SReader, public Component {
   TaskHandle_t read_task_handle_{nullptr};
   QueueHandle_t event_queue_;
 
-  NabuMicrophoneChannel *channel_0_{nullptr};
-  NabuMicrophoneChannel *channel_1_{nullptr};
+  std::array<NabuMicrophoneChannel *, NUMBER_OF_SLOTS> channels_{};
+
+  std::unique_ptr<audio::SPMCRingBuffer> capture_ring_buffer_;
+
+  uint32_t read_block_duration_ms_{20};
+  uint32_t read_timeout_ms_{15};
+  uint32_t ring_buffer_duration_ms_{180};
+
+  CaptureCounters capture_counters_;
+  mutable Mutex capture_counters_lock_;
 };
 
 class NabuMicrophoneChannel : public microphone::Microphone, public Component {
  public:
-  void setup() override;
-
   void start() override {
     this->parent_->start();
     this->is_muted_ = false;
@@ -91,20 +135,27 @@ class NabuMicrophoneChannel : public microphone::Microphone, public Component {
   // void set_requested_stop() { this->requested_stop_ = true; }
   bool get_requested_stop() { return this->requested_stop_; }
 
-  size_t read(int16_t *buf, size_t len, TickType_t ticks_to_wait = 0) override {
-    return this->ring_buffer_->read((void *) buf, len, ticks_to_wait);
-  };
-  size_t read(int16_t *buf, size_t len) override { return this->ring_buffer_->read((void *) buf, len); };
-  void reset() override { this->ring_buffer_->reset(); }
+  size_t read(int16_t *buf, size_t len, TickType_t ticks_to_wait = 0) override;
+  size_t read(int16_t *buf, size_t len) override { return this->read(buf, len, 0); };
+  void reset() override;
+
+  /// @brief Returns how often this channel fell so far behind that captured audio was overwritten before it was read
+  uint32_t get_overruns() const { return this->reader_.overruns; }
+
+  /// @brief Returns the most unread audio this channel had in the capture ring buffer, in bytes
+  size_t get_ring_buffer_high_water() const { return this->ring_buffer_high_water_; }
 
-  RingBuffer *get_ring_buffer() { return this->ring_buffer_.get(); }
+  void set_slot(uint8_t slot) { this->slot_ = slot; }
+  uint8_t get_slot() const { return this->slot_; }
 
   void set_amplify_shift(uint8_t amplify_shift) { this->amplify_shift_ = amplify_shift; }
   uint8_t get_amplify_shift() { return this->amplify_shift_; }
 
  protected:
   NabuMicrophone *parent_;
-  std::unique_ptr<RingBuffer> ring_buffer_;
+  audio::SPMCRingBuffer::Reader reader_;
+  uint8_t slot_{0};
+  size_t ring_buffer_high_water_{0};
 
   uint8_t amplify_shift_;
   bool is_muted_;
@@ -14,26 +14,52 @@ void Satellite1GPIOPin::digital_write(bool value){
   this->parent_->transfer( DC_RESOURCE::GPIO_PORT_OUT_A, GPIO_SERVICER_CMD_SET_PIN, payload, 2);
 }
 
-bool Satellite1GPIOPin::digital_read(){
-  DC_STATUS_REGISTER::register_id port_register;
+DC_STATUS_REGISTER::register_id Satellite1GPIOPin::port_register_() const {
   switch (this->port_){
     case XMOSPort::INPUT_A:
-      port_register = DC_STATUS_REGISTER::GPIO_PORT_IN_A;
-      break;
+      return DC_STATUS_REGISTER::GPIO_PORT_IN_A;
     case XMOSPort::INPUT_B:
-      port_register = DC_STATUS_REGISTER::GPIO_PORT_IN_B;
-      break;
+      return DC_STATUS_REGISTER::GPIO_PORT_IN_B;
     case XMOSPort::OUTPUT_A:
-      port_register = DC_STATUS_REGISTER::GPIO_PORT_OUT_A;
-      break;
+      return DC_STATUS_REGISTER::GPIO_PORT_OUT_A;
     default:
-      ESP_LOGE(TAG, "Invalid port set.");
-      return 0;
-      break;
+      return DC_STATUS_REGISTER::REGISTER_LEN;
+  }
+}
+
+bool Satellite1GPIOPin::digital_read(){
+  DC_STATUS_REGISTER::register_id port_register = this->port_register_();
+  if ( port_register == DC_STATUS_REGISTER::REGISTER_LEN ){
+    ESP_LOGE(TAG, "Invalid port set.");
+    return 0;
+  }
+  // With the IRQ pin, the service task keeps the cached registers current
+  if ( !this->parent_->has_status_irq() ){
+    this->parent_->request_status_register_update();
   }
-  this->parent_->request_status_register_update();
   uint8_t port_value = this->parent_->get_dc_status( port_register );
-  return !!( port_value & (1 << this->pin_) ) != this->inverted_;
+  return this->state_from_register_(port_value);
+}
+
+void Satellite1GPIOPin::add_on_state_callback(std::function<void(bool)> &&callback){
+  if ( !this->parent_->has_status_irq() ){
+    ESP_LOGW(TAG, "State callbacks require the xmos_irq_pin.");
+  }
+  if ( !this->subscribed_ ){
+    this->subscribed_ = true;
+    this->parent_->add_on_status_change_callback([this](DC_STATUS_REGISTER::register_id reg, uint8_t value){
+      if ( reg != this->port_register_() ){
+        return;
+      }
+      const bool state = this->state_from_register_(value);
+      if ( !this->has_state_ || state != this->last_state_ ){
+        this->has_state_ = true;
+        this->last_state_ = state;
+        this->state_callback_.call(state);
+      }
+    });
+  }
+  this->state_callback_.add(std::move(callback));
 }
 
 }
@@ -30,7 +30,21 @@ public:
     void set_flags(gpio::Flags flags) { this->flags_ = flags; }
     gpio::Flags get_flags() const {return this->flags_; }
 
+    /// @brief Adds a callback for changes of the pin's state. Requires the XMOS IRQ pin; the callback is
+    /// called from the Satellite1 component's loop.
+    void add_on_state_callback(std::function<void(bool)> &&callback);
+
  protected:
+    DC_STATUS_REGISTER::register_id port_register_() const;
+    bool state_from_register_(uint8_t port_value) const {
+      return !!( port_value & (1 << this->pin_) ) != this->inverted_;
+    }
+
+    CallbackManager<void(bool)> state_callback_{};
+    bool subscribed_{false};
+    bool has_state_{false};
+    bool last_state_{false};
+
     XMOSPort port_;
     uint8_t pin_;
     bool inverted_;
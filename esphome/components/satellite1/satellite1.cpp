@@ -1,14 +1,39 @@
 #include "satellite1.h"
 #include "esp_rom_gpio.h"
+#include "esphome/core/hal.h"
 #include "esphome/core/log.h"
 
+#include <esp_heap_caps.h>
+
 namespace esphome {
 namespace satellite1 {
 
 static const char *TAG = "Satellite1";
 
+// A busy device controller ignores commands. Retry a few times after short busy waits, before yielding a full tick.
+static const uint8_t CONTROL_TRANSFER_ATTEMPTS = 7;
+static const uint8_t CONTROL_FAST_RETRIES = 3;
+static const uint32_t CONTROL_RETRY_DELAY_US = 100;
+
+static const uint32_t SERVICE_TASK_STACK_SIZE = 3072;
+static const UBaseType_t SERVICE_TASK_PRIORITY = 3;
+
+enum ServiceTaskNotificationBits : uint32_t {
+  TRANSFER_QUEUED = (1 << 0),  // a transfer was added to the queue
+  STATUS_CHANGED = (1 << 1),   // the XMOS signaled a status register change, or just connected
+};
+
 
 void Satellite1::setup(){
+    // Word aligned internal memory, so the SPI driver transfers it with DMA directly instead of through a bounce buffer
+    this->transfer_buffer_ = (uint8_t *) heap_caps_aligned_calloc(4, 1, CONTROL_TRANSFER_BUFFER_SIZE,
+                                                                 MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if( this->transfer_buffer_ == nullptr ){
+      ESP_LOGE(TAG, "Failed to allocate the transfer buffer");
+      this->mark_failed();
+      return;
+    }
+
     this->spi_setup();
     this->enable();
     this->transfer_byte(0);
@@ -20,19 +45,40 @@ void Satellite1::setup(){
     
     memset( this->xmos_fw_version, 0, 5);
     this->dfu_get_fw_version_();  
+
+    xTaskCreate(Satellite1::service_task_, "sat1_spi_service", SERVICE_TASK_STACK_SIZE, (void *) this,
+                SERVICE_TASK_PRIORITY, &this->service_task_handle_);
+    if( this->service_task_handle_ == nullptr ){
+      ESP_LOGE(TAG, "Failed to create the SPI service task");
+      this->mark_failed();
+      return;
+    }
+
+    if( this->xmos_irq_pin_ ){
+      this->xmos_irq_pin_->setup();
+      this->xmos_irq_pin_->attach_interrupt(Satellite1::xmos_irq_isr_, this, gpio::INTERRUPT_RISING_EDGE);
+    }
 }   
 
 
 void Satellite1::dump_config(){
   esph_log_config(TAG, "Satellite1 config:");
+  esph_log_config(TAG, "    SPI data rate: %" PRIu32 " Hz", (uint32_t) this->data_rate_);
   if( this->xmos_rst_pin_ ){
     this->xmos_rst_pin_->dump_summary();
   } else {
     esph_log_config(TAG, "    xmos_rst_pin not set up properly.");
   }
+  if( this->xmos_irq_pin_ ){
+    esph_log_config(TAG, "    xmos_irq_pin: %s", this->xmos_irq_pin_->dump_summary().c_str());
+  }
 }
 
 void Satellite1::loop(){
+  if( this->status_change_pending_.exchange(false) ){
+    this->dispatch_status_changes_();
+  }
+
   switch(this->state){
     case SAT_DETACHED_STATE:
       if( this->connection_attempts <= MAX_CONNECTION_ATTEMPTS && (millis() - this->last_attempt_timestamp_) > 1000 )
@@ -43,6 +89,10 @@ void Satellite1::loop(){
             this->state = SAT_XMOS_CONNECTED_STATE;
             this->connection_attempts = 0;
             this->state_callback_.call();
+            if( this->has_status_irq() ){
+              // Changes before the connection weren't signaled, so fetch the current state once
+              this->notify_service_task_(ServiceTaskNotificationBits::STATUS_CHANGED);
+            }
         }
         this->last_attempt_timestamp_ = millis();  
         this->connection_attempts++;
@@ -88,78 +138,198 @@ std::string Satellite1::status_string(){
 
 
 bool Satellite1::request_status_register_update(){
-  bool ret = this->transfer( 0, 0, NULL, 0 );
-  uint8_t *arr = this->dc_status_register_;
-  return ret;
+  return this->transfer( 0, 0, NULL, 0 );
+}
+
+
+bool Satellite1::transfer_frame_(size_t len, const std::function<void()> &prepare){
+  uint8_t *buf = this->transfer_buffer_;
+  for( uint8_t attempt = 0; attempt < CONTROL_TRANSFER_ATTEMPTS; attempt++ ){
+    if( attempt > CONTROL_FAST_RETRIES ){
+      vTaskDelay(1);
+    } else if( attempt > 0 ){
+      delayMicroseconds( CONTROL_RETRY_DELAY_US << (attempt - 1) );
+    }
+    prepare();
+    this->enable();
+    this->transfer_array(buf, len);
+    this->disable();
+    if( buf[0] != CONTROL_COMMAND_IGNORED_IN_DEVICE ){
+      return true;
+    }
+  }
+  return false;
 }
 
 
 bool Satellite1::transfer( uint8_t resource_id, uint8_t command, uint8_t* payload, uint8_t payload_len){
+  if( this->transfer_buffer_ == nullptr ){
+    return false;
+  }
+
+  LockGuard lock(this->transfer_lock_);
+  // Read under the lock, so the flasher can't take over the bus while this transfer drives it
   if( this->spi_flash_direct_access_enabled_ ){
     return false;
   }
-  
-  uint8_t send_recv_buf[256+3] = {0};
-  int status_report_dummies = std::max<int>( 0, DC_STATUS_REGISTER::REGISTER_LEN - payload_len - 1);
-  
-  int attempts = 3; 
-  do {
-    send_recv_buf[0] = resource_id;
-    send_recv_buf[1] = command;
-    send_recv_buf[2] = payload_len + !!(command & CONTROL_CMD_READ_BIT) ;
-    memcpy( &send_recv_buf[3], payload, payload_len );
-    this->enable();
-    this->transfer_array(&send_recv_buf[0], payload_len + 3 + status_report_dummies);
-    this->disable();
-    vTaskDelay(1);
-  } while( send_recv_buf[0] == CONTROL_COMMAND_IGNORED_IN_DEVICE && attempts-- > 0 );
-  
-    
-  if( send_recv_buf[0] == CONTROL_COMMAND_IGNORED_IN_DEVICE ) {
+  uint8_t *buf = this->transfer_buffer_;
+  const size_t status_report_dummies = std::max<int>( 0, DC_STATUS_REGISTER::REGISTER_LEN - payload_len - 1);
+  const size_t command_len = payload_len + 3 + status_report_dummies;
+
+  bool accepted = this->transfer_frame_( command_len, [=](){
+    buf[0] = resource_id;
+    buf[1] = command;
+    buf[2] = payload_len + !!(command & CONTROL_CMD_READ_BIT);
+    if( payload_len ){
+      memcpy( &buf[3], payload, payload_len );
+    }
+    memset( &buf[3 + payload_len], 0, status_report_dummies );
+  });
+  if( !accepted ) {
     return false;
   }
 
   // XMOS not responding at all
-  if( (send_recv_buf[0] + send_recv_buf[1] + send_recv_buf[2]) == 0 ) {
+  if( (buf[0] + buf[1] + buf[2]) == 0 ) {
     return false;
   }
 
   // Got status register report
-  if( send_recv_buf[0] == DC_RESOURCE::CNTRL_ID && send_recv_buf[1] != DC_RET_STATUS::PAYLOAD_AVAILABLE ){
-    memcpy( this->dc_status_register_, &send_recv_buf[2], DC_STATUS_REGISTER::REGISTER_LEN );
-    uint8_t *arr = this->dc_status_register_;
+  if( buf[0] == DC_RESOURCE::CNTRL_ID && buf[1] != DC_RET_STATUS::PAYLOAD_AVAILABLE ){
+    memcpy( this->dc_status_register_, &buf[2], DC_STATUS_REGISTER::REGISTER_LEN );
   }
-  
+
   if( command & CONTROL_CMD_READ_BIT ){
-    attempts = 3; 
-    do {
-        memset( send_recv_buf, 0, payload_len + 3);
-        this->enable();
-        this->transfer_array(&send_recv_buf[0], payload_len + 3);
-        this->disable();
-        vTaskDelay(1);
-    } while( send_recv_buf[0] == CONTROL_COMMAND_IGNORED_IN_DEVICE && attempts-- > 0 );
-  
-    if( send_recv_buf[0] == CONTROL_COMMAND_IGNORED_IN_DEVICE ) {
+    // The response is clocked out in a second transaction, once the device controller processed the command
+    accepted = this->transfer_frame_( payload_len + 3, [=](){
+      memset( buf, 0, payload_len + 3 );
+    });
+    if( !accepted ) {
       return false;
     }
 
-    memcpy( payload, &send_recv_buf[1], payload_len );
+    memcpy( payload, &buf[1], payload_len );
   }
-  
+
+  return true;
+}
+
+
+bool Satellite1::queue_transfer(uint8_t resource_id, uint8_t command, const uint8_t* payload, uint8_t payload_len,
+                                TransferCallback &&callback, bool replace_pending){
+  LockGuard lock(this->transfer_queue_lock_);
+  if( replace_pending ){
+    for( auto &queued : this->transfer_queue_ ){
+      if( queued.resource_id == resource_id && queued.command == command ){
+        queued.payload.assign(payload, payload + payload_len);
+        queued.callback = std::move(callback);
+        return true;
+      }
+    }
+  }
+  if( this->transfer_queue_.size() >= MAX_QUEUED_TRANSFERS ){
+    return false;
+  }
+  this->transfer_queue_.push_back(
+      QueuedTransfer{resource_id, command, std::vector<uint8_t>(payload, payload + payload_len), std::move(callback)});
+  this->notify_service_task_(ServiceTaskNotificationBits::TRANSFER_QUEUED);
   return true;
 }
 
 
+void Satellite1::process_transfer_queue_(){
+  while( true ){
+    QueuedTransfer queued;
+    {
+      LockGuard lock(this->transfer_queue_lock_);
+      if( this->transfer_queue_.empty() ){
+        return;
+      }
+      queued = std::move(this->transfer_queue_.front());
+      this->transfer_queue_.pop_front();
+    }
+
+    const uint8_t payload_len = queued.payload.size();
+    const bool success = this->transfer(queued.resource_id, queued.command, queued.payload.data(), payload_len);
+    if( queued.callback != nullptr ){
+      queued.callback(success, queued.payload.data(), payload_len);
+    }
+  }
+}
+
+
+void Satellite1::notify_service_task_(uint32_t bits){
+  if( this->service_task_handle_ != nullptr ){
+    xTaskNotify(this->service_task_handle_, bits, eSetBits);
+  }
+}
+
+
+void IRAM_ATTR Satellite1::xmos_irq_isr_(Satellite1 *arg){
+  BaseType_t higher_priority_task_woken = pdFALSE;
+  xTaskNotifyFromISR(arg->service_task_handle_, ServiceTaskNotificationBits::STATUS_CHANGED, eSetBits,
+                     &higher_priority_task_woken);
+  portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+
+void Satellite1::service_task_(void *params){
+  Satellite1 *this_satellite = (Satellite1 *) params;
+  while( true ){
+    uint32_t notification_bits = 0;
+    xTaskNotifyWait(0, ULONG_MAX, &notification_bits, portMAX_DELAY);
+
+    if( notification_bits & ServiceTaskNotificationBits::STATUS_CHANGED ){
+      this_satellite->fetch_status_registers_();
+    }
+    if( notification_bits & ServiceTaskNotificationBits::TRANSFER_QUEUED ){
+      this_satellite->process_transfer_queue_();
+    }
+  }
+}
+
+
+void Satellite1::fetch_status_registers_(){
+  if( this->state != SAT_XMOS_CONNECTED_STATE || !this->request_status_register_update() ){
+    return;
+  }
+  // The callbacks are called from the component's loop, not from the service task
+  this->status_change_pending_ = true;
+}
+
+
+void Satellite1::dispatch_status_changes_(){
+  uint8_t status_register[DC_STATUS_REGISTER::REGISTER_LEN];
+  {
+    LockGuard lock(this->transfer_lock_);
+    memcpy( status_register, this->dc_status_register_, DC_STATUS_REGISTER::REGISTER_LEN );
+  }
+  // Compared against the last dispatched values, since any transfer may update the cached registers.
+  // The first dispatch reports every register, so subscribers learn the initial state.
+  for( uint8_t reg = 0; reg < DC_STATUS_REGISTER::REGISTER_LEN; reg++ ){
+    const uint8_t value = status_register[reg];
+    if( !this->status_dispatched_ || value != this->dispatched_status_register_[reg] ){
+      this->dispatched_status_register_[reg] = value;
+      this->status_change_callback_.call((DC_STATUS_REGISTER::register_id) reg, value);
+    }
+  }
+  this->status_dispatched_ = true;
+}
+
+
 void Satellite1::set_spi_flash_direct_access_mode(bool enable){
-  this->xmos_rst_pin_->digital_write(enable);
-  if( enable ){
-    this->state = SAT_FLASH_CONNECTED_STATE;
-  } else if ( this->spi_flash_direct_access_enabled_ ){
-    this->state = SAT_DETACHED_STATE;
-    this->connection_attempts = 0;
-  }
-  this->spi_flash_direct_access_enabled_ = enable;
+  {
+    // Waits for a transfer in flight on the service task, and keeps new ones off the bus until the mode switched
+    LockGuard lock(this->transfer_lock_);
+    this->xmos_rst_pin_->digital_write(enable);
+    if( enable ){
+      this->state = SAT_FLASH_CONNECTED_STATE;
+    } else if ( this->spi_flash_direct_access_enabled_ ){
+      this->state = SAT_DETACHED_STATE;
+      this->connection_attempts = 0;
+    }
+    this->spi_flash_direct_access_enabled_ = enable;
+  }
   this->state_callback_.call();
 }
 
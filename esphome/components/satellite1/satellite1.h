@@ -3,6 +3,15 @@
 #include "esphome/components/spi/spi.h"
 #include "esphome/core/component.h"
 #include "esphome/core/gpio.h"
+#include "esphome/core/helpers.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
 
 namespace esphome {
 namespace satellite1 {
@@ -22,6 +31,10 @@ static const uint8_t DFU_CONTROLLER_SERVICER_RESID = 240;
 
 static const uint8_t MAX_CONNECTION_ATTEMPTS = 3;
 
+// Header (resource id, command, length) followed by at most 255 payload bytes
+static const size_t CONTROL_TRANSFER_BUFFER_SIZE = 3 + 256;
+static const size_t MAX_QUEUED_TRANSFERS = 16;
+
 namespace DC_RESOURCE {
 enum dc_resource_enum {
     CNTRL_ID   = 1,
@@ -66,9 +79,19 @@ enum Satellite1State : uint8_t {
 };
 
 
+/// @brief Called once a queued transfer completed. For read commands, `payload` holds the device's response.
+using TransferCallback = std::function<void(bool success, const uint8_t *payload, uint8_t payload_len)>;
+
+struct QueuedTransfer {
+  uint8_t resource_id;
+  uint8_t command;
+  std::vector<uint8_t> payload;
+  TransferCallback callback;
+};
+
 class Satellite1 : public Component,
                    public spi::SPIDevice <spi::BIT_ORDER_MSB_FIRST, spi::CLOCK_POLARITY_LOW,
-                                          spi::CLOCK_PHASE_LEADING, spi::DATA_RATE_1KHZ> {
+                                          spi::CLOCK_PHASE_LEADING, spi::DATA_RATE_8MHZ> {
  public:
   Satellite1State state{SAT_DETACHED_STATE};
   uint8_t xmos_fw_version[5];
@@ -119,6 +142,28 @@ class Satellite1 : public Component,
    */
   bool transfer(uint8_t resource_id, uint8_t command, uint8_t* payload, uint8_t payload_len);
 
+  /**
+   * @brief Queues a transfer to the XMOS device controller and returns immediately.
+   *
+   * Queued transfers are executed back to back on the `sat1_spi_service` task, and `callback` is
+   * called on that task once the transfer completed, so it must be thread-safe and must not block
+   * for long. Defer anything that touches other components to their loop. With `replace_pending`,
+   * the transfer replaces a pending one with the same resource and command, so e.g. only the
+   * latest LED ring frame is sent if the device controller can't keep up.
+   *
+   * @param resource_id  Identifier for the target resource within the XMOS device controller.
+   * @param command      Command specifying the operation, as for `transfer`.
+   * @param payload      Data to send; copied, so it may be reused right away. For read commands,
+   *                     the response is passed to `callback` instead.
+   * @param payload_len  Length of the payload in bytes.
+   * @param callback     Optional function called on the service task with the transfer's result.
+   * @param replace_pending Whether to replace a pending transfer with the same resource and command.
+   *
+   * @return             `false` if the queue is full, `true` otherwise.
+   */
+  bool queue_transfer(uint8_t resource_id, uint8_t command, const uint8_t* payload, uint8_t payload_len,
+                      TransferCallback &&callback = nullptr, bool replace_pending = false);
+
   
   /**
    * @brief Requests an update to the XMOS device controller's status registers.
@@ -150,12 +195,25 @@ class Satellite1 : public Component,
    */
   uint8_t get_dc_status(DC_STATUS_REGISTER::register_id reg){
     assert(reg < DC_STATUS_REGISTER::REGISTER_LEN); 
+    // The service task updates the cached registers on every transfer
+    LockGuard lock(this->transfer_lock_);
     return this->dc_status_register_[reg]; 
   }
 
   void set_spi_flash_direct_access_mode(bool enable);
   
   void set_xmos_rst_pin(GPIOPin* xmos_rst_pin){this->xmos_rst_pin_ = xmos_rst_pin;}
+  void set_xmos_irq_pin(InternalGPIOPin* xmos_irq_pin){this->xmos_irq_pin_ = xmos_irq_pin;}
+
+  /// @brief Whether the XMOS signals status register changes through its IRQ pin. If so, the cached
+  /// status registers are kept up to date without polling `request_status_register_update`.
+  bool has_status_irq() const { return this->xmos_irq_pin_ != nullptr; }
+
+  /// @brief Adds a callback for status register changes signaled by the XMOS IRQ pin. It is called
+  /// from the component's loop, once for every register that changed.
+  void add_on_status_change_callback(std::function<void(DC_STATUS_REGISTER::register_id, uint8_t)> &&callback) {
+    this->status_change_callback_.add(std::move(callback));
+  }
   
   void add_on_state_callback(std::function<void()> &&callback) {
     this->state_callback_.add(std::move(callback));
@@ -167,14 +225,45 @@ class Satellite1 : public Component,
 protected:
   bool dfu_get_fw_version_();
   bool check_for_xmos_();
+
+  /// @brief Sends `len` bytes of the transfer buffer, filled by `prepare`, until the device stops
+  /// ignoring it. Retries with short busy waits first, so only a busy device costs a full tick.
+  bool transfer_frame_(size_t len, const std::function<void()> &prepare);
+  void process_transfer_queue_();
+
+  /// @brief Runs queued transfers and fetches the status registers after an XMOS IRQ, so neither
+  /// depends on the loop cadence
+  static void service_task_(void *params);
+  static void xmos_irq_isr_(Satellite1 *arg);
+  void notify_service_task_(uint32_t bits);
+
+  /// @brief Fetches the status registers on the service task and flags them for dispatch in the loop
+  void fetch_status_registers_();
+  /// @brief Dispatches every register that changed since the last dispatch
+  void dispatch_status_changes_();
+
   CallbackManager<void()> state_callback_{};
 
   uint32_t last_attempt_timestamp_{0};
 
   uint8_t dc_status_register_[DC_STATUS_REGISTER::REGISTER_LEN];
-  bool spi_flash_direct_access_enabled_{false};
+  bool spi_flash_direct_access_enabled_{false};  // Guarded by transfer_lock_
   
   GPIOPin* xmos_rst_pin_{nullptr};
+
+  // Kept in the component instead of on the caller's stack, so it is allocated once in DMA capable memory in setup
+  uint8_t *transfer_buffer_{nullptr};
+  Mutex transfer_lock_;
+
+  std::deque<QueuedTransfer> transfer_queue_;
+  Mutex transfer_queue_lock_;
+
+  InternalGPIOPin* xmos_irq_pin_{nullptr};
+  TaskHandle_t service_task_handle_{nullptr};
+  uint8_t dispatched_status_register_[DC_STATUS_REGISTER::REGISTER_LEN]{};
+  bool status_dispatched_{false};
+  std::atomic<bool> status_change_pending_{false};
+  CallbackManager<void(DC_STATUS_REGISTER::register_id, uint8_t)> status_change_callback_{};
 };
 
 
@@ -185,6 +274,9 @@ public:
 
 protected:
    uint8_t transfer_byte(uint8_t byte ) {return this->parent_->transfer_byte(byte);}
+   void transfer_array(uint8_t* data, size_t length) {this->parent_->transfer_array(data, length);}
+   void write_array(const uint8_t* data, size_t length) {this->parent_->write_array(data, length);}
+   void read_array(uint8_t* data, size_t length) {this->parent_->read_array(data, length);}
    void enable() {this->parent_->enable();}
    void disable(){this->parent_->disable();}
    uint8_t servicer_id_;
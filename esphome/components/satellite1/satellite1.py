@@ -31,6 +31,7 @@ XMOSNoResponseStateTrigger = namespace.class_(
 
 CONF_SATELLITE1 = "satellite1"
 CONF_XMOS_RST_PIN = "xmos_rst_pin"
+CONF_XMOS_IRQ_PIN = "xmos_irq_pin"
 CONF_ON_XMOS_NO_RESPONSE = "on_xmos_no_response"
 CONF_ON_XMOS_CONNECTED = "on_xmos_connected"
 CONF_ON_FLASH_CONNECTED = "on_flash_connected"
@@ -39,6 +40,8 @@ SAT1_CONFIG_SCHEMA = (
      cv.Schema({
         cv.GenerateID(): cv.declare_id(Satellite1),
         cv.Optional(CONF_XMOS_RST_PIN, default="GPIO12"): pins.gpio_output_pin_schema,
+        # Signals status register changes; set inverted: true if the XMOS pulls it low
+        cv.Optional(CONF_XMOS_IRQ_PIN): pins.internal_gpio_input_pin_schema,
 
         cv.Optional(CONF_ON_XMOS_CONNECTED): automation.validate_automation({
                 cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(XMOSConnectedStateTrigger),
@@ -50,7 +53,7 @@ SAT1_CONFIG_SCHEMA = (
                 cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(XMOSNoResponseStateTrigger),
         }),
 
-    }).extend(spi_device_schema(True, "1Hz"))
+    }).extend(spi_device_schema(True, "8MHz"))
 )
 
 
@@ -61,6 +64,10 @@ async def register_satellite1(config) :
     
     rst_pin = await cg.gpio_pin_expression(config[CONF_XMOS_RST_PIN])
     cg.add(var.set_xmos_rst_pin(rst_pin))
+
+    if CONF_XMOS_IRQ_PIN in config:
+        irq_pin = await cg.gpio_pin_expression(config[CONF_XMOS_IRQ_PIN])
+        cg.add(var.set_xmos_irq_pin(irq_pin))
     
     for conf in config.get(CONF_ON_XMOS_CONNECTED, []):
          trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var )
@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+"""
+Writes the sector hash manifest for an XMOS flash image, to publish next to the image for
+`memory_flasher.write_image`'s `sector_manifest_url`.
+
+The first line is the MD5 of the whole image, followed by the MD5 of every 4 KB sector of
+the image. The last sector is hashed without padding.
+
+usage: make_sector_manifest.py IMAGE [MANIFEST]
+"""
+
+import hashlib
+import sys
+from pathlib import Path
+
+SECTOR_SIZE = 4096
+
+
+def make_manifest(image: bytes) -> str:
+    lines = [hashlib.md5(image).hexdigest()]
+    for offset in range(0, len(image), SECTOR_SIZE):
+        lines.append(hashlib.md5(image[offset : offset + SECTOR_SIZE]).hexdigest())
+    return "\n".join(lines) + "\n"
+
+
+def main() -> int:
+    if len(sys.argv) not in (2, 3):
+        print(__doc__.strip(), file=sys.stderr)
+        return 1
+    image_path = Path(sys.argv[1])
+    manifest_path = Path(sys.argv[2]) if len(sys.argv) == 3 else image_path.with_suffix(".sectors")
+    manifest_path.write_text(make_manifest(image_path.read_bytes()))
+    print(f"Wrote {manifest_path}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,57 @@
+import re
+import sys
+
+"""
+Collect the counters the audio decoder and resampler log when they are torn down, e.g.:
+
+  [D][audio_decoder:029]: FLAC @ 44100 Hz: 220500 frames, 1843200 frames/s, 8.00 bytes copied per frame, peak system heap drop 23512 bytes
+  [D][audio_resampler:029]: 44100 Hz -> 48000 Hz: 240000 frames, 612345 frames/s, 12.00 bytes copied per frame, peak system heap drop 9216 bytes
+
+Usage:
+  esphome logs tests/audio_pipeline/benchmark_pipeline.yaml | tee benchmark.log
+  python tests/audio_pipeline/parse_benchmark_log.py benchmark.log
+"""
+DECODER_RE = re.compile(
+    r"\[audio_decoder:\d+\]: (?P<stage>\w+ @ \d+ Hz): (?P<frames>\d+) frames, (?P<fps>\d+) frames/s, "
+    r"(?P<copied>[\d.]+) bytes copied per frame, peak system heap drop (?P<heap>\d+) bytes"
+)
+RESAMPLER_RE = re.compile(
+    r"\[audio_resampler:\d+\]: (?P<stage>\d+ Hz -> \d+ Hz): (?P<frames>\d+) frames, (?P<fps>\d+) frames/s, "
+    r"(?P<copied>[\d.]+) bytes copied per frame, peak system heap drop (?P<heap>\d+) bytes"
+)
+
+
+def parse(lines):
+    results = []
+    for line in lines:
+        for component, regex in (("decoder", DECODER_RE), ("resampler", RESAMPLER_RE)):
+            match = regex.search(line)
+            if match:
+                results.append((component, match))
+    return results
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1], "r", errors="replace") as f:
+            results = parse(f)
+    else:
+        results = parse(sys.stdin)
+
+    if not results:
+        print("No benchmark results found, is the logger level at least DEBUG?")
+        return 1
+
+    header = f"{'stage':<10} {'stream':<24} {'frames':>10} {'frames/s':>12} {'copied B/frame':>15} {'heap drop':>10}"
+    print(header)
+    print("-" * len(header))
+    for component, match in results:
+        print(
+            f"{component:<10} {match['stage']:<24} {int(match['frames']):>10} {int(match['fps']):>12} "
+            f"{float(match['copied']):>15.2f} {int(match['heap']):>10}"
+        )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,24 @@
+#!/bin/bash
+
+GIT_ROOT=$(git rev-parse --show-toplevel)
+TESTDATA_DIR=${GIT_ROOT}/testdata/audio_pipeline
+
+DURATION_S=5
+SAMPLE_RATES="16000 44100 48000"
+
+if ! command -v ffmpeg &> /dev/null; then
+  echo "ffmpeg is required to generate the benchmark files"
+  exit 1
+fi
+
+if [ ! -d "${TESTDATA_DIR}" ]; then
+  mkdir -p ${TESTDATA_DIR}
+fi
+
+# A stereo sine sweep keeps the codecs busy across the whole spectrum
+for rate in ${SAMPLE_RATES}; do
+  source="aevalsrc=sin(2*PI*(100+t*400)*t)|sin(2*PI*(200+t*400)*t):s=${rate}:d=${DURATION_S}"
+  ffmpeg -y -loglevel error -f lavfi -i "${source}" -ac 2 -c:a pcm_s16le ${TESTDATA_DIR}/sweep_${rate}.wav
+  ffmpeg -y -loglevel error -f lavfi -i "${source}" -ac 2 -c:a flac -sample_fmt s16 ${TESTDATA_DIR}/sweep_${rate}.flac
+  ffmpeg -y -loglevel error -f lavfi -i "${source}" -ac 2 -c:a libmp3lame -b:a 128k ${TESTDATA_DIR}/sweep_${rate}.mp3
+done
@@ -0,0 +1,50 @@
+import argparse
+import socket
+import struct
+import time
+
+"""
+Stand-in time server for the audio_sync component.
+
+Answers timestamp requests on a UDP port with the time of this machine in microseconds since the Unix epoch.
+Run it on a machine synchronized via NTP, so start times computed by Home Assistant match its timebase.
+
+Packet (little endian): magic "S1TS", sequence, client send time, server receive time, server send time.
+"""
+PACKET = struct.Struct("<IIqqq")
+MAGIC = 0x53315453
+PORT = 5140
+
+
+def now_us() -> int:
+    return time.time_ns() // 1000
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--port", type=int, default=PORT)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", args.port))
+    print(f"Listening on udp port {args.port}")
+
+    clients = {}
+    while True:
+        data, addr = sock.recvfrom(PACKET.size)
+        receive_us = now_us()
+        if len(data) != PACKET.size:
+            continue
+        magic, sequence, client_send_us, _, _ = PACKET.unpack(data)
+        if magic != MAGIC:
+            continue
+
+        sock.sendto(PACKET.pack(magic, sequence, client_send_us, receive_us, now_us()), addr)
+
+        if addr[0] not in clients:
+            print(f"{addr[0]} connected")
+        clients[addr[0]] = sequence
+
+
+if __name__ == "__main__":
+    main()
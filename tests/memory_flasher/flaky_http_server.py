@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+HTTP stand-in for testing resumable image downloads of the memory flasher.
+
+Serves the files of a directory, supports single `Range: bytes=<start>-` requests
+and drops the connection after a random number of bytes of every image response,
+so a download only finishes if the client resumes where it was interrupted.
+Files ending in .md5 or .sectors are always sent completely.
+
+usage: flaky_http_server.py [-h] [--port PORT] [--min-bytes N] [--max-bytes N]
+                            [--stall-rate RATE] [--no-range] [--reliable] [DIRECTORY]
+"""
+
+import argparse
+import http.server
+import random
+import re
+import time
+from functools import partial
+from pathlib import Path
+
+COMPLETE_SUFFIXES = (".md5", ".sectors")
+STALL_SECONDS = 30
+
+
+class FlakyRequestHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def __init__(self, *args, directory: Path, options, **kwargs):
+        self.directory = directory
+        self.options = options
+        super().__init__(*args, **kwargs)
+
+    def do_GET(self):
+        path = (self.directory / self.path.lstrip("/").split("?")[0]).resolve()
+        if self.directory not in path.parents or not path.is_file():
+            self.send_error(404)
+            return
+        data = path.read_bytes()
+
+        start = 0
+        range_header = self.headers.get("Range")
+        match = re.match(r"^bytes=(\d+)-$", range_header or "")
+        if match and not self.options.no_range:
+            start = int(match[1])
+            if start >= len(data):
+                self.send_error(416)
+                return
+            self.send_response(206)
+            self.send_header("Content-Range", f"bytes {start}-{len(data) - 1}/{len(data)}")
+        else:
+            self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(data) - start))
+        self.end_headers()
+
+        body = data[start:]
+        if path.suffix in COMPLETE_SUFFIXES or self.options.reliable:
+            self.wfile.write(body)
+            return
+
+        cut = random.randint(self.options.min_bytes, self.options.max_bytes)
+        if cut >= len(body):
+            self.wfile.write(body)
+            self.log_message("sent %d bytes from %d, complete", len(body), start)
+            return
+        self.wfile.write(body[:cut])
+        self.wfile.flush()
+        if random.random() < self.options.stall_rate:
+            # Keeps the connection open without sending anything, so the client has to notice the stall
+            self.log_message("sent %d bytes from %d, stalling", cut, start)
+            time.sleep(STALL_SECONDS)
+        else:
+            self.log_message("sent %d bytes from %d, dropping", cut, start)
+        self.close_connection = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("directory", nargs="?", default=".", type=Path)
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--min-bytes", type=int, default=64 * 1024, help="fewest bytes sent before a drop")
+    parser.add_argument("--max-bytes", type=int, default=512 * 1024, help="most bytes sent before a drop")
+    parser.add_argument("--stall-rate", type=float, default=0.2, help="share of the drops that stall instead")
+    parser.add_argument("--no-range", action="store_true", help="ignore range requests, like some servers do")
+    parser.add_argument("--reliable", action="store_true", help="never drop connections, e.g. for benchmarks")
+    options = parser.parse_args()
+
+    handler = partial(FlakyRequestHandler, directory=options.directory.resolve(), options=options)
+    server = http.server.ThreadingHTTPServer(("", options.port), handler)
+    print(f"Serving {options.directory.resolve()} on port {options.port}")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
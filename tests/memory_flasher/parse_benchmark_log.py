@@ -0,0 +1,71 @@
+import re
+import sys
+
+"""
+Collect the results the XMOS flasher and the simulated flash log after every flash, e.g.:
+
+  [I][xmos_flasher:097]: Flashed 4194304 bytes in 41250 ms (101 kB/s), 0 sector program retries, verifying took 4410 ms
+  [D][spi_nor_simulator:046]:   98344 transactions, 4213 kB over SPI, 4314 ms bus time
+  [D][spi_nor_simulator:048]:   16384 page programs, 64 erases, 81022 status reads
+  [D][spi_nor_simulator:050]:   0 rejected commands, 0 injected faults
+
+Usage:
+  esphome logs tests/memory_flasher/flash_benchmark.yaml | tee benchmark.log
+  python tests/memory_flasher/parse_benchmark_log.py benchmark.log
+"""
+FLASHED_RE = re.compile(
+    r"\[xmos_flasher:\d+\]: Flashed (?P<bytes>\d+) bytes in (?P<ms>\d+) ms \((?P<kbps>\d+) kB/s\), "
+    r"(?P<retries>\d+) (?P<verify>\w+) program retries, verifying took (?P<verify_ms>\d+) ms"
+)
+SPI_RE = re.compile(
+    r"\[spi_nor_simulator:\d+\]:\s+(?P<transactions>\d+) transactions, (?P<spi_kb>\d+) kB over SPI, "
+    r"(?P<bus_ms>\d+) ms bus time"
+)
+FAULTS_RE = re.compile(
+    r"\[spi_nor_simulator:\d+\]:\s+(?P<rejected>\d+) rejected commands, (?P<faults>\d+) injected faults"
+)
+RESULT_RE = re.compile(r"XMOS flash benchmark (?P<result>passed|failed)")
+
+
+def parse(lines):
+    results = []
+    current = {}
+    for line in lines:
+        for regex in (FLASHED_RE, SPI_RE, FAULTS_RE, RESULT_RE):
+            match = regex.search(line)
+            if match:
+                current.update(match.groupdict())
+        if "result" in current:
+            results.append(current)
+            current = {}
+    return results
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1], "r", errors="replace") as f:
+            results = parse(f)
+    else:
+        results = parse(sys.stdin)
+
+    if not results:
+        print("No benchmark results found, is the logger level at least DEBUG?")
+        return 1
+
+    header = (
+        f"{'result':<7} {'bytes':>9} {'wall ms':>8} {'kB/s':>6} {'SPI kB':>7} {'bus ms':>7} {'verify':>6} "
+        f"{'verify ms':>9} {'retries':>7} {'rejected':>8} {'faults':>6}"
+    )
+    print(header)
+    print("-" * len(header))
+    for result in results:
+        print(
+            f"{result['result']:<7} {int(result.get('bytes', 0)):>9} {int(result.get('ms', 0)):>8} "
+            f"{int(result.get('kbps', 0)):>6} {int(result.get('spi_kb', 0)):>7} {int(result.get('bus_ms', 0)):>7} "
+            f"{result.get('verify', '-'):>6} {int(result.get('verify_ms', 0)):>9} {int(result.get('retries', 0)):>7} {int(result.get('rejected', 0)):>8} {int(result.get('faults', 0)):>6}"
+        )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,16 @@
+#!/bin/bash
+
+GIT_ROOT=$(git rev-parse --show-toplevel)
+TESTDATA_DIR=${GIT_ROOT}/testdata/memory_flasher
+
+# The simulated flash keeps the written sectors in PSRAM, which limits the image size
+IMAGE_SIZE_KB=${1:-4096}
+
+if [ ! -d "${TESTDATA_DIR}" ]; then
+  mkdir -p ${TESTDATA_DIR}
+fi
+
+# Random data has no erased (0xFF) pages, so every page is programmed
+head -c $((IMAGE_SIZE_KB * 1024)) /dev/urandom > ${TESTDATA_DIR}/bench.bin
+md5sum ${TESTDATA_DIR}/bench.bin | cut -d ' ' -f 1 > ${TESTDATA_DIR}/bench.md5
+echo "00000000000000000000000000000000" > ${TESTDATA_DIR}/bench.bad.md5